@@ -0,0 +1,48 @@
+#pragma once
+#include <limits>
+#include <algorithm>
+#include <glm/glm.hpp>
+
+// Axis aligned bounding box. Default constructed it is empty, growing it by anything gives exactly that thing's bounds.
+struct Aabb {
+	glm::vec3 min{ std::numeric_limits<float>::max() };
+	glm::vec3 max{ std::numeric_limits<float>::lowest() };
+};
+
+inline void grow_aabb(Aabb& aabb, const glm::vec3& point)
+{
+	aabb.min = glm::min(aabb.min, point);
+	aabb.max = glm::max(aabb.max, point);
+}
+
+inline void grow_aabb(Aabb& aabb, const Aabb& other)
+{
+	aabb.min = glm::min(aabb.min, other.min);
+	aabb.max = glm::max(aabb.max, other.max);
+}
+
+inline glm::vec3 get_aabb_centre(const Aabb& aabb)
+{
+	return (aabb.min + aabb.max) * 0.5f;
+}
+
+// Zero for an empty box.
+inline float get_aabb_surface_area(const Aabb& aabb)
+{
+	glm::vec3 size = glm::max(aabb.max - aabb.min, glm::vec3(0.0f));
+	return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+// Bounds of the transformed box, without transforming all 8 corners. Each axis of the result is the sum of each column's smallest and largest contribution.
+inline Aabb transform_aabb(const Aabb& aabb, const glm::mat4& transform)
+{
+	Aabb result{ glm::vec3(transform[3]), glm::vec3(transform[3]) };
+	for (int column = 0; column < 3; ++column) {
+		glm::vec3 a = glm::vec3(transform[column]) * aabb.min[column];
+		glm::vec3 b = glm::vec3(transform[column]) * aabb.max[column];
+		result.min += glm::min(a, b);
+		result.max += glm::max(a, b);
+	}
+
+	return result;
+}
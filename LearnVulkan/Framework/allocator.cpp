@@ -0,0 +1,652 @@
+#include <algorithm>
+#include <optional>
+#include <tuple>
+#include "allocator.h"
+#include "buffer.h"
+#include "error.h"
+#include "memory_stats.h"
+
+static VkDeviceSize align_up(VkDeviceSize value, VkDeviceSize alignment) {
+	return alignment > 1 ? (value + alignment - 1) / alignment * alignment : value;
+}
+
+std::optional<VkDeviceSize> allocate_range(std::vector<MemoryRange>& free_ranges, VkDeviceSize size, VkDeviceSize alignment)
+{
+	// First fit: take the first free range that can hold the allocation once aligned.
+	// The padding in front of the allocation and the space left after it are kept as free ranges.
+	for (std::size_t i = 0; i < free_ranges.size(); ++i) {
+		MemoryRange range = free_ranges[i];
+		VkDeviceSize aligned_offset = align_up(range.offset, alignment);
+		VkDeviceSize padding = aligned_offset - range.offset;
+		if (padding + size > range.size) {
+			continue;
+		}
+
+		free_ranges.erase(free_ranges.begin() + i);
+		VkDeviceSize remaining = range.size - padding - size;
+		if (remaining > 0) {
+			free_ranges.insert(free_ranges.begin() + i, { aligned_offset + size, remaining });
+		}
+		if (padding > 0) {
+			free_ranges.insert(free_ranges.begin() + i, { range.offset, padding });
+		}
+
+		return aligned_offset;
+	}
+
+	return std::nullopt;
+}
+
+void free_range(std::vector<MemoryRange>& free_ranges, VkDeviceSize offset, VkDeviceSize size)
+{
+	auto it = std::lower_bound(free_ranges.begin(), free_ranges.end(), offset, [](const MemoryRange& range, VkDeviceSize value) { return range.offset < value; });
+	it = free_ranges.insert(it, { offset, size });
+
+	// Merge with the following range.
+	auto next = it + 1;
+	if (next != free_ranges.end() && it->offset + it->size == next->offset) {
+		it->size += next->size;
+		free_ranges.erase(next);
+	}
+
+	// Merge with the preceding range.
+	if (it != free_ranges.begin()) {
+		auto previous = it - 1;
+		if (previous->offset + previous->size == it->offset) {
+			previous->size += it->size;
+			free_ranges.erase(it);
+		}
+	}
+}
+
+static std::optional<VkDeviceSize> allocate_from_block(MemoryBlock& block, VkDeviceSize size, VkDeviceSize alignment) {
+	std::optional<VkDeviceSize> offset = allocate_range(block.free_ranges, size, alignment);
+	if (offset) {
+		block.used += size;
+	}
+
+	return offset;
+}
+
+static void free_from_block(MemoryBlock& block, VkDeviceSize offset, VkDeviceSize size) {
+	free_range(block.free_ranges, offset, size);
+	block.used -= size;
+}
+
+static std::optional<uint32_t> create_memory_block(GpuAllocator& allocator, uint32_t memory_type, GpuResourceKind kind, VkDeviceSize size) {
+	MemoryBlock block{};
+	block.size = size;
+	block.memory_type = memory_type;
+	block.kind = kind;
+	block.free_ranges.push_back({ 0, size });
+
+	VkMemoryAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.allocationSize = size;
+	alloc_info.memoryTypeIndex = memory_type;
+
+	MemoryTagScope tag_scope{ MemoryTag::AllocatorBlock };
+	if (allocate_device_memory(allocator.device, alloc_info, block.memory) != VK_SUCCESS) {
+		log_error("Failed to allocate memory block of size ", size, " for memory type ", memory_type);
+		return std::nullopt;
+	}
+
+	// Re-use the slot of a block that was freed, the block index is stored in allocations so existing indices can't be shuffled.
+	for (uint32_t i = 0; i < allocator.blocks.size(); ++i) {
+		if (allocator.blocks[i].memory == VK_NULL_HANDLE) {
+			allocator.blocks[i] = std::move(block);
+			return i;
+		}
+	}
+
+	allocator.blocks.push_back(std::move(block));
+	return static_cast<uint32_t>(allocator.blocks.size() - 1);
+}
+
+GpuAllocator create_gpu_allocator(VkDevice device, VkPhysicalDevice physical_device, VkCommandPool command_pool, VkDeviceSize block_size)
+{
+	GpuAllocator allocator{};
+	allocator.device = device;
+	allocator.physical_device = physical_device;
+	allocator.block_size = block_size;
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &allocator.memory_properties);
+
+	VkCommandBufferAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	alloc_info.commandPool = command_pool;
+	alloc_info.commandBufferCount = 1;
+
+	if (vkAllocateCommandBuffers(device, &alloc_info, &allocator.defragment_command_buffer) != VK_SUCCESS) {
+		log_error("Failed to allocate defragment command buffer.");
+	}
+
+	VkFenceCreateInfo fence_info{};
+	fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	if (vkCreateFence(device, &fence_info, nullptr, &allocator.defragment_fence) != VK_SUCCESS) {
+		log_error("Failed to create defragment fence.");
+	}
+
+	return allocator;
+}
+
+void destroy_gpu_allocator(GpuAllocator& allocator)
+{
+	if (allocator.defragment_in_flight) {
+		vkWaitForFences(allocator.device, 1, &allocator.defragment_fence, VK_TRUE, UINT64_MAX);
+	}
+
+	for (const PendingMove& move : allocator.pending_moves) {
+		vkDestroyBuffer(allocator.device, move.destination_buffer, nullptr);
+		vkDestroyImage(allocator.device, move.destination_image, nullptr);
+	}
+
+	for (const RetiredResource& retired : allocator.retired_resources) {
+		vkDestroyBuffer(allocator.device, retired.buffer, nullptr);
+		vkDestroyImage(allocator.device, retired.image, nullptr);
+	}
+
+	for (const GpuResource& resource : allocator.resources) {
+		if (resource.alive) {
+			vkDestroyBuffer(allocator.device, resource.buffer, nullptr);
+			vkDestroyImage(allocator.device, resource.image, nullptr);
+		}
+	}
+
+	for (const MemoryBlock& block : allocator.blocks) {
+		free_device_memory(allocator.device, block.memory);
+	}
+
+	vkDestroyFence(allocator.device, allocator.defragment_fence, nullptr);
+	allocator = GpuAllocator{};
+}
+
+GpuAllocation allocate_gpu_memory(GpuAllocator& allocator, const VkMemoryRequirements& requirements, VkMemoryPropertyFlags memory_flags, GpuResourceKind kind)
+{
+	std::optional<uint32_t> memory_type = find_memory_type(allocator.physical_device, memory_flags, requirements.memoryTypeBits);
+	if (!memory_type) {
+		return {};
+	}
+
+	for (uint32_t i = 0; i < allocator.blocks.size(); ++i) {
+		MemoryBlock& block = allocator.blocks[i];
+		if (block.memory == VK_NULL_HANDLE || block.memory_type != *memory_type || block.kind != kind) {
+			continue;
+		}
+
+		if (auto offset = allocate_from_block(block, requirements.size, requirements.alignment)) {
+			return { i, *offset, requirements.size };
+		}
+	}
+
+	// Resources bigger than the block size get a block to themselves.
+	std::optional<uint32_t> block_index = create_memory_block(allocator, *memory_type, kind, std::max(allocator.block_size, requirements.size));
+	if (!block_index) {
+		return {};
+	}
+
+	VkDeviceSize offset = allocate_from_block(allocator.blocks[*block_index], requirements.size, requirements.alignment).value();
+	return { *block_index, offset, requirements.size };
+}
+
+void free_gpu_memory(GpuAllocator& allocator, const GpuAllocation& allocation)
+{
+	if (allocation.block >= allocator.blocks.size()) {
+		return;
+	}
+
+	free_from_block(allocator.blocks[allocation.block], allocation.offset, allocation.size);
+}
+
+static GpuResourceHandle add_resource(GpuAllocator& allocator, GpuResource&& resource) {
+	if (!allocator.free_handles.empty()) {
+		GpuResourceHandle handle = allocator.free_handles.back();
+		allocator.free_handles.pop_back();
+		allocator.resources[handle] = std::move(resource);
+		return handle;
+	}
+
+	allocator.resources.push_back(std::move(resource));
+	return static_cast<GpuResourceHandle>(allocator.resources.size() - 1);
+}
+
+GpuResourceHandle create_allocated_buffer(GpuAllocator& allocator, VkBufferUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags, VkDeviceSize size, GpuResourceMovedCallback on_moved)
+{
+	GpuResource resource{};
+	resource.kind = GpuResourceKind::Buffer;
+	resource.on_moved = std::move(on_moved);
+
+	// Mapped host memory can't be moved from under the CPU, so only device memory is considered for defragmentation.
+	resource.movable = (memory_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0;
+
+	// The defragmenter copies buffers with the transfer queue operations.
+	resource.buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	resource.buffer_info.size = size;
+	resource.buffer_info.usage = usage_flags | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+	resource.buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(allocator.device, &resource.buffer_info, nullptr, &resource.buffer) != VK_SUCCESS) {
+		log_error("Failed to create allocated buffer");
+		return INVALID_GPU_RESOURCE;
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(allocator.device, resource.buffer, &requirements);
+	resource.allocation = allocate_gpu_memory(allocator, requirements, memory_flags, GpuResourceKind::Buffer);
+	if (resource.allocation.block == UINT32_MAX) {
+		vkDestroyBuffer(allocator.device, resource.buffer, nullptr);
+		return INVALID_GPU_RESOURCE;
+	}
+
+	vkBindBufferMemory(allocator.device, resource.buffer, get_allocation_memory(allocator, resource.allocation), resource.allocation.offset);
+	resource.alive = true;
+	return add_resource(allocator, std::move(resource));
+}
+
+GpuResourceHandle create_allocated_image(GpuAllocator& allocator, VkImageUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags, VkFormat format, VkImageAspectFlags aspect, uint32_t width, uint32_t height, GpuResourceMovedCallback on_moved)
+{
+	GpuResource resource{};
+	resource.kind = GpuResourceKind::Image;
+	resource.on_moved = std::move(on_moved);
+	resource.movable = (memory_flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0;
+	resource.image_aspect = aspect;
+
+	VkImageCreateInfo& image_info = resource.image_info;
+	image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+	image_info.imageType = VK_IMAGE_TYPE_2D;
+	image_info.extent = { width, height, 1 };
+	image_info.mipLevels = 1;
+	image_info.arrayLayers = 1;
+	image_info.format = format;
+	image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+	image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	image_info.usage = usage_flags | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+	image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+
+	if (vkCreateImage(allocator.device, &image_info, nullptr, &resource.image) != VK_SUCCESS) {
+		log_error("Failed to create allocated image");
+		return INVALID_GPU_RESOURCE;
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetImageMemoryRequirements(allocator.device, resource.image, &requirements);
+	resource.allocation = allocate_gpu_memory(allocator, requirements, memory_flags, GpuResourceKind::Image);
+	if (resource.allocation.block == UINT32_MAX) {
+		vkDestroyImage(allocator.device, resource.image, nullptr);
+		return INVALID_GPU_RESOURCE;
+	}
+
+	vkBindImageMemory(allocator.device, resource.image, get_allocation_memory(allocator, resource.allocation), resource.allocation.offset);
+	resource.alive = true;
+	return add_resource(allocator, std::move(resource));
+}
+
+void destroy_allocated_resource(GpuAllocator& allocator, GpuResourceHandle handle)
+{
+	if (handle >= allocator.resources.size() || !allocator.resources[handle].alive) {
+		log_error("Attempted to destroy invalid gpu resource ", handle);
+		return;
+	}
+
+	// If the resource is half way through a move, wait for the copy so the destination can be released with it.
+	auto pending = std::find_if(allocator.pending_moves.begin(), allocator.pending_moves.end(), [handle](const PendingMove& move) { return move.handle == handle; });
+	if (pending != allocator.pending_moves.end()) {
+		vkWaitForFences(allocator.device, 1, &allocator.defragment_fence, VK_TRUE, UINT64_MAX);
+		vkDestroyBuffer(allocator.device, pending->destination_buffer, nullptr);
+		vkDestroyImage(allocator.device, pending->destination_image, nullptr);
+		free_gpu_memory(allocator, pending->destination);
+		allocator.pending_moves.erase(pending);
+	}
+
+	GpuResource& resource = allocator.resources[handle];
+	vkDestroyBuffer(allocator.device, resource.buffer, nullptr);
+	vkDestroyImage(allocator.device, resource.image, nullptr);
+	free_gpu_memory(allocator, resource.allocation);
+	resource = GpuResource{};
+	allocator.free_handles.push_back(handle);
+}
+
+void set_allocated_resource_moved_callback(GpuAllocator& allocator, GpuResourceHandle handle, GpuResourceMovedCallback on_moved)
+{
+	allocator.resources[handle].on_moved = std::move(on_moved);
+}
+
+void set_allocated_image_layout(GpuAllocator& allocator, GpuResourceHandle handle, VkImageLayout layout)
+{
+	allocator.resources[handle].image_layout = layout;
+}
+
+static std::tuple<VkDeviceSize, VkDeviceSize> get_free_and_largest_free(const MemoryBlock& block) {
+	VkDeviceSize free = 0;
+	VkDeviceSize largest_free = 0;
+	for (const MemoryRange& range : block.free_ranges) {
+		free += range.size;
+		largest_free = std::max(largest_free, range.size);
+	}
+
+	return { free, largest_free };
+}
+
+float get_block_fragmentation(const MemoryBlock& block)
+{
+	auto [free, largest_free] = get_free_and_largest_free(block);
+	return free > 0 ? 1.0f - static_cast<float>(largest_free) / static_cast<float>(free) : 0.0f;
+}
+
+float get_fragmentation(const GpuAllocator& allocator)
+{
+	VkDeviceSize total_free = 0;
+	VkDeviceSize total_unusable = 0;
+	for (const MemoryBlock& block : allocator.blocks) {
+		if (block.memory == VK_NULL_HANDLE) {
+			continue;
+		}
+
+		// Everything outside the largest range is free memory that a resource as big as the free space can't use.
+		auto [free, largest_free] = get_free_and_largest_free(block);
+		total_free += free;
+		total_unusable += free - largest_free;
+	}
+
+	return total_free > 0 ? static_cast<float>(total_unusable) / static_cast<float>(total_free) : 0.0f;
+}
+
+const GpuResource& get_allocated_resource(const GpuAllocator& allocator, GpuResourceHandle handle)
+{
+	return allocator.resources[handle];
+}
+
+void* map_allocated_resource(GpuAllocator& allocator, GpuResourceHandle handle)
+{
+	const GpuResource& resource = allocator.resources[handle];
+	MemoryBlock& block = allocator.blocks[resource.allocation.block];
+	if ((allocator.memory_properties.memoryTypes[block.memory_type].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) == 0) {
+		log_error("Attempted to map gpu resource ", handle, " which isn't host visible");
+		return nullptr;
+	}
+
+	// A memory object can only be mapped once at a time, so the whole block is mapped and shared by every resource in it.
+	if (block.mapped == nullptr) {
+		if (vkMapMemory(allocator.device, block.memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(&block.mapped)) != VK_SUCCESS) {
+			log_error("Failed to map memory block ", resource.allocation.block);
+			return nullptr;
+		}
+	}
+
+	return block.mapped + resource.allocation.offset;
+}
+
+VkDeviceMemory get_allocation_memory(const GpuAllocator& allocator, const GpuAllocation& allocation)
+{
+	return allocator.blocks[allocation.block].memory;
+}
+
+static void release_retired_resources(GpuAllocator& allocator) {
+	for (std::size_t i = 0; i < allocator.retired_resources.size();) {
+		RetiredResource& retired = allocator.retired_resources[i];
+		if (retired.frames_remaining > 0) {
+			--retired.frames_remaining;
+			++i;
+			continue;
+		}
+
+		vkDestroyBuffer(allocator.device, retired.buffer, nullptr);
+		vkDestroyImage(allocator.device, retired.image, nullptr);
+		free_gpu_memory(allocator, retired.allocation);
+		allocator.retired_resources[i] = allocator.retired_resources.back();
+		allocator.retired_resources.pop_back();
+	}
+
+	// Give empty blocks back to the driver, this is what stops long running sessions from slowly growing.
+	for (MemoryBlock& block : allocator.blocks) {
+		if (block.memory != VK_NULL_HANDLE && block.used == 0) {
+			free_device_memory(allocator.device, block.memory);
+			block = MemoryBlock{};
+		}
+	}
+}
+
+static void finish_pending_moves(GpuAllocator& allocator) {
+	for (const PendingMove& move : allocator.pending_moves) {
+		GpuResource& resource = allocator.resources[move.handle];
+
+		// Frames that were recorded before the move can still reference the old copy, so it stays alive until they have retired.
+		allocator.retired_resources.push_back({ resource.allocation, resource.buffer, resource.image, MAX_FRAMES_IN_FLIGHT });
+
+		resource.allocation = move.destination;
+		resource.buffer = move.destination_buffer;
+		resource.image = move.destination_image;
+
+		if (resource.on_moved) {
+			resource.on_moved(resource);
+		}
+	}
+
+	allocator.pending_moves.clear();
+	allocator.defragment_in_flight = false;
+}
+
+// Like allocate_gpu_memory, except it never creates new blocks and only considers blocks that are at least as full as the source block.
+// Moving resources into emptier blocks would only shuffle the fragmentation around.
+static bool is_move_destination(const GpuAllocator& allocator, uint32_t source_block, uint32_t block_index) {
+	const MemoryBlock& source = allocator.blocks[source_block];
+	const MemoryBlock& block = allocator.blocks[block_index];
+	return block_index != source_block && block.memory != VK_NULL_HANDLE && block.memory_type == source.memory_type && block.kind == source.kind && block.used >= source.used;
+}
+
+static std::optional<GpuAllocation> allocate_for_move(GpuAllocator& allocator, uint32_t source_block, const VkMemoryRequirements& requirements) {
+	for (uint32_t i = 0; i < allocator.blocks.size(); ++i) {
+		if (!is_move_destination(allocator, source_block, i)) {
+			continue;
+		}
+
+		if (auto offset = allocate_from_block(allocator.blocks[i], requirements.size, requirements.alignment)) {
+			return GpuAllocation{ i, *offset, requirements.size };
+		}
+	}
+
+	return std::nullopt;
+}
+
+static VkMemoryRequirements get_resource_requirements(const GpuAllocator& allocator, const GpuResource& resource) {
+	VkMemoryRequirements requirements{};
+	if (resource.kind == GpuResourceKind::Buffer) {
+		vkGetBufferMemoryRequirements(allocator.device, resource.buffer, &requirements);
+	}
+	else {
+		vkGetImageMemoryRequirements(allocator.device, resource.image, &requirements);
+	}
+
+	return requirements;
+}
+
+static bool has_free_range_for(const MemoryBlock& block, const VkMemoryRequirements& requirements) {
+	return std::any_of(block.free_ranges.begin(), block.free_ranges.end(), [&](const MemoryRange& range) {
+		return align_up(range.offset, requirements.alignment) - range.offset + requirements.size <= range.size;
+	});
+}
+
+// Whether allocate_for_move would find a place for at least one of the block's movable resources.
+static bool has_resource_to_move(const GpuAllocator& allocator, uint32_t source_block) {
+	for (const GpuResource& resource : allocator.resources) {
+		if (!resource.alive || !resource.movable || resource.allocation.block != source_block) {
+			continue;
+		}
+
+		VkMemoryRequirements requirements = get_resource_requirements(allocator, resource);
+		for (uint32_t i = 0; i < allocator.blocks.size(); ++i) {
+			if (is_move_destination(allocator, source_block, i) && has_free_range_for(allocator.blocks[i], requirements)) {
+				return true;
+			}
+		}
+	}
+
+	return false;
+}
+
+static std::optional<uint32_t> pick_source_block(const GpuAllocator& allocator) {
+
+	// The emptiest block is the cheapest to evacuate, and the one most likely to be freed once it is.
+	// Blocks where nothing can move are skipped, otherwise they would be picked again every step and the other blocks never compacted.
+	std::optional<uint32_t> source;
+	for (uint32_t i = 0; i < allocator.blocks.size(); ++i) {
+		const MemoryBlock& block = allocator.blocks[i];
+		if (block.memory == VK_NULL_HANDLE || block.used == 0 || (source && block.used >= allocator.blocks[*source].used)) {
+			continue;
+		}
+
+		if (has_resource_to_move(allocator, i)) {
+			source = i;
+		}
+	}
+
+	return source;
+}
+
+static void record_image_barrier(VkCommandBuffer command_buffer, VkImage image, VkImageAspectFlags aspect, VkImageLayout old_layout, VkImageLayout new_layout, VkAccessFlags available_memory, VkAccessFlags visible_memory) {
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = old_layout;
+	barrier.newLayout = new_layout;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange = { aspect, 0, 1, 0, 1 };
+	barrier.srcAccessMask = available_memory;
+	barrier.dstAccessMask = visible_memory;
+
+	// The defragmenter doesn't know which stages last used the image, so wait on all of them.
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+static bool record_move(GpuAllocator& allocator, GpuResourceHandle handle, const GpuAllocation& destination, PendingMove& out_move) {
+	GpuResource& resource = allocator.resources[handle];
+	VkCommandBuffer command_buffer = allocator.defragment_command_buffer;
+	VkDeviceMemory memory = get_allocation_memory(allocator, destination);
+	out_move.handle = handle;
+	out_move.destination = destination;
+
+	if (resource.kind == GpuResourceKind::Buffer) {
+		if (vkCreateBuffer(allocator.device, &resource.buffer_info, nullptr, &out_move.destination_buffer) != VK_SUCCESS) {
+			log_error("Failed to create buffer to defragment into");
+			return false;
+		}
+
+		vkBindBufferMemory(allocator.device, out_move.destination_buffer, memory, destination.offset);
+
+		VkBufferCopy copy_region{};
+		copy_region.size = resource.buffer_info.size;
+		vkCmdCopyBuffer(command_buffer, resource.buffer, out_move.destination_buffer, 1, &copy_region);
+		return true;
+	}
+
+	if (vkCreateImage(allocator.device, &resource.image_info, nullptr, &out_move.destination_image) != VK_SUCCESS) {
+		log_error("Failed to create image to defragment into");
+		return false;
+	}
+
+	vkBindImageMemory(allocator.device, out_move.destination_image, memory, destination.offset);
+
+	// An image that has never been written has nothing worth copying.
+	if (resource.image_layout == VK_IMAGE_LAYOUT_UNDEFINED) {
+		return true;
+	}
+
+	record_image_barrier(command_buffer, resource.image, resource.image_aspect, resource.image_layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT);
+	record_image_barrier(command_buffer, out_move.destination_image, resource.image_aspect, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT);
+
+	VkImageCopy copy_region{};
+	copy_region.srcSubresource = { resource.image_aspect, 0, 0, 1 };
+	copy_region.dstSubresource = { resource.image_aspect, 0, 0, 1 };
+	copy_region.extent = resource.image_info.extent;
+	vkCmdCopyImage(command_buffer, resource.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, out_move.destination_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy_region);
+
+	// Put both images back in the layout the owner expects. The old image is still used by frames in flight until it retires.
+	record_image_barrier(command_buffer, out_move.destination_image, resource.image_aspect, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, resource.image_layout, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT);
+	record_image_barrier(command_buffer, resource.image, resource.image_aspect, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, resource.image_layout, 0, VK_ACCESS_MEMORY_READ_BIT);
+	return true;
+}
+
+void defragment_step(GpuAllocator& allocator, VkQueue queue, const DefragmentBudget& budget)
+{
+	auto start_time = std::chrono::steady_clock::now();
+
+	if (allocator.defragment_in_flight) {
+		// Never block on the copies, just try again next frame.
+		if (vkGetFenceStatus(allocator.device, allocator.defragment_fence) != VK_SUCCESS) {
+			release_retired_resources(allocator);
+			return;
+		}
+
+		finish_pending_moves(allocator);
+	}
+
+	release_retired_resources(allocator);
+
+	std::optional<uint32_t> source_block = pick_source_block(allocator);
+	if (!source_block) {
+		return;
+	}
+
+	// The command buffer is only begun once there is something to copy, most steps find nothing to move.
+	bool recording = false;
+	VkDeviceSize bytes_moved = 0;
+	for (GpuResourceHandle handle = 0; handle < allocator.resources.size(); ++handle) {
+		const GpuResource& resource = allocator.resources[handle];
+		if (!resource.alive || !resource.movable || resource.allocation.block != *source_block) {
+			continue;
+		}
+
+		// The first move of a step is always allowed, so a resource larger than the whole budget still gets moved eventually.
+		if (bytes_moved > 0 && (bytes_moved + resource.allocation.size > budget.max_bytes_per_step || std::chrono::steady_clock::now() - start_time > budget.max_cpu_time_per_step)) {
+			break;
+		}
+
+		VkMemoryRequirements requirements = get_resource_requirements(allocator, resource);
+		std::optional<GpuAllocation> destination = allocate_for_move(allocator, *source_block, requirements);
+		if (!destination) {
+			continue;
+		}
+
+		if (!recording) {
+			VkCommandBufferBeginInfo begin_info{};
+			begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkBeginCommandBuffer(allocator.defragment_command_buffer, &begin_info);
+			recording = true;
+		}
+
+		PendingMove move{};
+		if (!record_move(allocator, handle, *destination, move)) {
+			free_gpu_memory(allocator, *destination);
+			continue;
+		}
+
+		allocator.pending_moves.push_back(move);
+		bytes_moved += resource.allocation.size;
+	}
+
+	if (!recording) {
+		return;
+	}
+
+	vkEndCommandBuffer(allocator.defragment_command_buffer);
+
+	if (allocator.pending_moves.empty()) {
+		return;
+	}
+
+	VkSubmitInfo submit_info{};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &allocator.defragment_command_buffer;
+
+	vkResetFences(allocator.device, 1, &allocator.defragment_fence);
+	if (vkQueueSubmit(queue, 1, &submit_info, allocator.defragment_fence) != VK_SUCCESS) {
+		log_error("Failed to submit defragment copies");
+		return;
+	}
+
+	allocator.defragment_in_flight = true;
+}
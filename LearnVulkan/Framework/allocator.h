@@ -0,0 +1,150 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include <optional>
+#include <chrono>
+#include <functional>
+#include "constants.h"
+
+// Vulkan implementations limit the number of vkAllocateMemory calls (maxMemoryAllocationCount can be as low as 4096), and each allocation is slow.
+// Instead we allocate large blocks of device memory and hand out sub-ranges of them to buffers and images.
+// As resources are streamed in and out the blocks fragment, so the allocator can also incrementally move live resources into fuller blocks and free the empty ones.
+
+static constexpr VkDeviceSize DEFAULT_MEMORY_BLOCK_SIZE = 64ull * 1024ull * 1024ull;
+
+enum class GpuResourceKind : uint8_t {
+	Buffer,
+	Image,
+};
+
+struct MemoryRange {
+	VkDeviceSize offset{ 0 };
+	VkDeviceSize size{ 0 };
+};
+
+struct MemoryBlock {
+	VkDeviceMemory memory{ VK_NULL_HANDLE };
+	VkDeviceSize size{ 0 };
+	VkDeviceSize used{ 0 };
+	uint32_t memory_type{ 0 };
+
+	// Buffers and images are kept in seperate blocks so that bufferImageGranularity never needs to be considered.
+	GpuResourceKind kind{ GpuResourceKind::Buffer };
+
+	// Sorted by offset so that neighbouring ranges can be merged when freed.
+	std::vector<MemoryRange> free_ranges{};
+
+	// Host visible blocks are mapped once, the first time a resource in them is mapped, and stay mapped until the block is freed.
+	uint8_t* mapped{ nullptr };
+};
+
+struct GpuAllocation {
+	uint32_t block{ UINT32_MAX };
+	VkDeviceSize offset{ 0 };
+	VkDeviceSize size{ 0 };
+};
+
+// Handles stay valid when the resource is moved by the defragmenter, only the VkBuffer/VkImage behind them changes.
+using GpuResourceHandle = uint32_t;
+static constexpr GpuResourceHandle INVALID_GPU_RESOURCE = UINT32_MAX;
+
+struct GpuResource;
+
+// Called once a moved resource is ready to be used at its new location. The owner should re-create any views and update any descriptors that reference it.
+using GpuResourceMovedCallback = std::function<void(const GpuResource& resource)>;
+
+struct GpuResource {
+	GpuResourceKind kind{ GpuResourceKind::Buffer };
+	bool alive{ false };
+	bool movable{ true };
+	GpuAllocation allocation{};
+
+	VkBuffer buffer{ VK_NULL_HANDLE };
+	VkBufferCreateInfo buffer_info{};
+
+	VkImage image{ VK_NULL_HANDLE };
+	VkImageCreateInfo image_info{};
+	VkImageAspectFlags image_aspect{ VK_IMAGE_ASPECT_COLOR_BIT };
+
+	// The layout the image is left in between uses, the defragmenter restores this layout after copying.
+	VkImageLayout image_layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+
+	GpuResourceMovedCallback on_moved{};
+};
+
+struct DefragmentBudget {
+	VkDeviceSize max_bytes_per_step{ 8ull * 1024ull * 1024ull };
+	std::chrono::microseconds max_cpu_time_per_step{ 500 };
+};
+
+// A resource that is being copied to a new location by the GPU.
+struct PendingMove {
+	GpuResourceHandle handle{ INVALID_GPU_RESOURCE };
+	GpuAllocation destination{};
+	VkBuffer destination_buffer{ VK_NULL_HANDLE };
+	VkImage destination_image{ VK_NULL_HANDLE };
+};
+
+// A resource that has been moved, but the old copy might still be referenced by frames in flight.
+struct RetiredResource {
+	GpuAllocation allocation{};
+	VkBuffer buffer{ VK_NULL_HANDLE };
+	VkImage image{ VK_NULL_HANDLE };
+	std::size_t frames_remaining{ MAX_FRAMES_IN_FLIGHT };
+};
+
+struct GpuAllocator {
+	VkDevice device{ VK_NULL_HANDLE };
+	VkPhysicalDevice physical_device{ VK_NULL_HANDLE };
+	VkPhysicalDeviceMemoryProperties memory_properties{};
+	VkDeviceSize block_size{ DEFAULT_MEMORY_BLOCK_SIZE };
+	std::vector<MemoryBlock> blocks{};
+
+	std::vector<GpuResource> resources{};
+	std::vector<GpuResourceHandle> free_handles{};
+
+	// Defragmentation state, the copies are submitted with their own command buffer and fence so they never block the frame.
+	VkCommandBuffer defragment_command_buffer{ VK_NULL_HANDLE };
+	VkFence defragment_fence{ VK_NULL_HANDLE };
+	bool defragment_in_flight{ false };
+	std::vector<PendingMove> pending_moves{};
+	std::vector<RetiredResource> retired_resources{};
+};
+
+// Free list helpers, also used to sub-allocate ranges within a single buffer.
+std::optional<VkDeviceSize> allocate_range(std::vector<MemoryRange>& free_ranges, VkDeviceSize size, VkDeviceSize alignment);
+void free_range(std::vector<MemoryRange>& free_ranges, VkDeviceSize offset, VkDeviceSize size);
+
+GpuAllocator create_gpu_allocator(VkDevice device, VkPhysicalDevice physical_device, VkCommandPool command_pool, VkDeviceSize block_size = DEFAULT_MEMORY_BLOCK_SIZE);
+void destroy_gpu_allocator(GpuAllocator& allocator);
+
+GpuAllocation allocate_gpu_memory(GpuAllocator& allocator, const VkMemoryRequirements& requirements, VkMemoryPropertyFlags memory_flags, GpuResourceKind kind);
+void free_gpu_memory(GpuAllocator& allocator, const GpuAllocation& allocation);
+
+GpuResourceHandle create_allocated_buffer(GpuAllocator& allocator, VkBufferUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags, VkDeviceSize size, GpuResourceMovedCallback on_moved = {});
+GpuResourceHandle create_allocated_image(GpuAllocator& allocator, VkImageUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags, VkFormat format, VkImageAspectFlags aspect, uint32_t width, uint32_t height, GpuResourceMovedCallback on_moved = {});
+void destroy_allocated_resource(GpuAllocator& allocator, GpuResourceHandle handle);
+
+// For owners that only exist once the resource does, replaces the callback given when the resource was created.
+void set_allocated_resource_moved_callback(GpuAllocator& allocator, GpuResourceHandle handle, GpuResourceMovedCallback on_moved);
+
+// The image layout must be kept up to date by the owner, so the defragmenter can copy the image and put it back into the same layout.
+void set_allocated_image_layout(GpuAllocator& allocator, GpuResourceHandle handle, VkImageLayout layout);
+
+// 0 when all of the block's free memory is in one range, approaching 1 as it is split into many small ranges.
+float get_block_fragmentation(const MemoryBlock& block);
+
+// The fragmentation of every block weighted by how much free memory it has. A resource never spans blocks, so free memory in two different blocks
+// being apart doesn't count as fragmentation.
+float get_fragmentation(const GpuAllocator& allocator);
+
+const GpuResource& get_allocated_resource(const GpuAllocator& allocator, GpuResourceHandle handle);
+
+// Pointer to the start of a resource created with host visible memory, valid until the resource is destroyed. Host visible resources are never moved.
+void* map_allocated_resource(GpuAllocator& allocator, GpuResourceHandle handle);
+VkDeviceMemory get_allocation_memory(const GpuAllocator& allocator, const GpuAllocation& allocation);
+
+// Does a bounded amount of defragmentation work, should be called once per frame.
+// Finishes moves submitted by previous steps (without waiting on the GPU), releases resources no longer referenced by frames in flight and then submits a new batch of copies.
+void defragment_step(GpuAllocator& allocator, VkQueue queue, const DefragmentBudget& budget);
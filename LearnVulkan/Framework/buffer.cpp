@@ -1,59 +1,113 @@
 #include <optional>
+#include <algorithm>
+#include <vector>
 #include "buffer.h"
 #include "error.h"
+#include "memory_stats.h"
 
 static constexpr VkFormat IMAGE_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
 
-static VkCommandBuffer begin_single_time_commands(VkDevice device, VkCommandPool command_pool) {
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = command_pool;
-    allocInfo.commandBufferCount = 1;
+static std::optional<uint32_t> search_memory_type(const VkPhysicalDeviceMemoryProperties& memory_properties, VkMemoryPropertyFlags required_property_flags, uint32_t type_filter) {
 
-    VkCommandBuffer commandBuffer;
-    vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer);
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    // There's different memory types on the device, each memory type has a set of flags indicating their capabilities. 
+    // Find memory type with the properties needed for the buffer.
+    // TODO: prioritise these memory types in somer way.
+    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
+        if ((type_filter & (1 << i)) && ((memory_properties.memoryTypes[i].propertyFlags & required_property_flags) == required_property_flags)) {
+            return i;
+        }
+    }
 
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-    return commandBuffer;
+    return std::nullopt;
 }
 
+std::optional<uint32_t> find_memory_type(VkPhysicalDevice physical_device, VkMemoryPropertyFlags required_property_flags, uint32_t type_filter) {
 
-static void end_single_time_commands(VkDevice device, VkCommandPool command_pool, VkQueue command_queue, VkCommandBuffer command_buffer) {
-    vkEndCommandBuffer(command_buffer);
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &command_buffer;
+    VkPhysicalDeviceMemoryProperties memory_properties{};
+    vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
 
-    vkQueueSubmit(command_queue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(command_queue);
+    std::optional<uint32_t> memory_type = search_memory_type(memory_properties, required_property_flags, type_filter);
+    if (!memory_type) {
+        log_error("Failed to find suitable memory type for ", required_property_flags);
+    }
 
-    vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
+    return memory_type;
 }
 
+static UploadPath upload_path = UploadPath::Automatic;
+
+void set_upload_path(UploadPath path)
+{
+    upload_path = path;
+}
 
-static std::optional<uint32_t> find_memory_type(VkPhysicalDevice physical_device, VkMemoryPropertyFlags required_property_flags, uint32_t type_filter) {
+UploadPath get_upload_path()
+{
+    return upload_path;
+}
 
+bool has_direct_upload_memory(VkPhysicalDevice physical_device)
+{
     VkPhysicalDeviceMemoryProperties memory_properties{};
     vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
 
-    // There's different memory types on the device, each memory type has a set of flags indicating their capabilities. 
-    // Find memory type with the properties needed for the buffer.
-    // TODO: prioritise these memory types in somer way.
-    for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++) {
-        if ((type_filter & (1 << i)) && ((memory_properties.memoryTypes[i].propertyFlags & required_property_flags) == required_property_flags)) {
-            return i;
+    std::optional<uint32_t> memory_type = search_memory_type(memory_properties, DIRECT_UPLOAD_MEMORY_FLAGS, UINT32_MAX);
+    if (!memory_type) {
+        return false;
+    }
+
+    // Most discrete GPUs without resizable BAR still expose a small (usually 256MB) window of device memory to the host. 
+    // That window is too small to hold every resource, so only write directly when the host visible memory is the largest device local heap,
+    // which is the case for unified memory (integrated and software implementations) and for resizable BAR.
+    uint32_t direct_heap = memory_properties.memoryTypes[*memory_type].heapIndex;
+    for (uint32_t i = 0; i < memory_properties.memoryHeapCount; ++i) {
+        const VkMemoryHeap& heap = memory_properties.memoryHeaps[i];
+        if ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && heap.size > memory_properties.memoryHeaps[direct_heap].size) {
+            return false;
         }
     }
 
-    log_error("Failed to find suitable memory type for ", required_property_flags);
-    return std::nullopt;
+    return true;
+}
+
+bool should_upload_buffer_directly(VkPhysicalDevice physical_device)
+{
+    switch (upload_path) {
+    case UploadPath::Staging:
+        return false;
+    case UploadPath::Direct: {
+        VkPhysicalDeviceMemoryProperties memory_properties{};
+        vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties);
+        return search_memory_type(memory_properties, DIRECT_UPLOAD_MEMORY_FLAGS, UINT32_MAX).has_value();
+    }
+    default:
+        return has_direct_upload_memory(physical_device);
+    }
+}
+
+bool should_upload_image_directly(VkPhysicalDevice physical_device, VkFormat format)
+{
+    if (upload_path == UploadPath::Staging) {
+        return false;
+    }
+
+    // Host writes need a linear image, the layout of optimal tiling is implementation defined.
+    VkFormatProperties format_properties{};
+    vkGetPhysicalDeviceFormatProperties(physical_device, format, &format_properties);
+    if ((format_properties.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) == 0) {
+        return false;
+    }
+
+    if (upload_path == UploadPath::Direct) {
+        return should_upload_buffer_directly(physical_device);
+    }
+
+    // Sampling a linear image is noticeably slower than an optimal one on discrete GPUs, even with resizable BAR.
+    // With unified memory the texture cache behaves the same either way so the copy isn't worth it.
+    VkPhysicalDeviceProperties properties{};
+    vkGetPhysicalDeviceProperties(physical_device, &properties);
+    bool unified_memory = properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU || properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+    return unified_memory && has_direct_upload_memory(physical_device);
 }
 
 std::tuple<VkBuffer, VkDeviceMemory> create_buffer(VkDevice device, VkPhysicalDevice physical_device, VkBufferUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags, std::span<const uint8_t> data)
@@ -83,7 +137,7 @@ std::tuple<VkBuffer, VkDeviceMemory> create_buffer(VkDevice device, VkPhysicalDe
     allocInfo.allocationSize = memory_requirements.size;
     allocInfo.memoryTypeIndex = find_memory_type(physical_device, memory_flags, memory_requirements.memoryTypeBits).value_or(UINT32_MAX);
 
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &device_memory) != VK_SUCCESS) {
+    if (allocate_device_memory(device, allocInfo, device_memory) != VK_SUCCESS) {
         log_error("Failed to allocate buffer content");
         return { buffer, VK_NULL_HANDLE };
     }
@@ -129,7 +183,7 @@ std::tuple<VkBuffer, VkDeviceMemory> create_buffer(VkDevice device, VkPhysicalDe
     allocInfo.allocationSize = memory_requirements.size;
     allocInfo.memoryTypeIndex = find_memory_type(physical_device, memory_flags, memory_requirements.memoryTypeBits).value_or(UINT32_MAX);
 
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &device_memory) != VK_SUCCESS) {
+    if (allocate_device_memory(device, allocInfo, device_memory) != VK_SUCCESS) {
         log_error("Failed to allocate buffer content");
         return { buffer, VK_NULL_HANDLE };
     }
@@ -141,74 +195,77 @@ std::tuple<VkBuffer, VkDeviceMemory> create_buffer(VkDevice device, VkPhysicalDe
     return { buffer,device_memory };
 }
 
-static void submit_buffer_copy_command(VkDevice device, VkCommandPool command_pool, VkQueue command_queue, VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize amount)
+std::tuple<VkBuffer, VkDeviceMemory> create_staging_buffer(VkDevice device, VkPhysicalDevice physical_device, std::span<const uint8_t> data)
 {
-    VkCommandBufferAllocateInfo alloc_info{};
-    alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    alloc_info.commandPool = command_pool;
-    alloc_info.commandBufferCount = 1;
-
-    VkCommandBuffer command_buffer = VK_NULL_HANDLE;
-    vkAllocateCommandBuffers(device, &alloc_info, &command_buffer);
-
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(command_buffer, &beginInfo);
+    MemoryTagScope tag_scope{ MemoryTag::Staging };
+    return create_buffer(device, physical_device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, data);
+}
 
+void record_buffer_copy(VkCommandBuffer command_buffer, VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize amount, VkDeviceSize dst_offset, VkDeviceSize src_offset)
+{
     VkBufferCopy copy_region{};
-    copy_region.srcOffset = 0; // Optional
-    copy_region.dstOffset = 0; // Optional
+    copy_region.srcOffset = src_offset; // Optional
+    copy_region.dstOffset = dst_offset; // Optional
     copy_region.size = amount;
     vkCmdCopyBuffer(command_buffer, src_buffer, dst_buffer, 1, &copy_region);
-    vkEndCommandBuffer(command_buffer);
-
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &command_buffer;
-
-    vkQueueSubmit(command_queue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(command_queue);
-    vkFreeCommandBuffers(device, command_pool, 1, &command_buffer);
-}
 
-
-
-static void submit_image_transition_command(VkDevice device, VkCommandPool command_pool, VkQueue command_queue, VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout, VkAccessFlags available_memory, VkAccessFlags visible_memory, VkPipelineStageFlags dependent_stages, VkPipelineStageFlags output_stages) {
-    VkCommandBuffer command_buffer = begin_single_time_commands(device, command_pool);
-
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-
-    // Transfering layout (data format)
-    barrier.oldLayout = old_layout;
-    barrier.newLayout = new_layout;
-
-    // Transfering queue family index.
+    // The upload isn't waited on, so later submissions need the transfer writes to be made visible before they read the buffer.
+    VkBufferMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
     barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.buffer = dst_buffer;
+    barrier.offset = dst_offset;
+    barrier.size = amount;
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
 
-    barrier.image = image;
-
-    // Region of image
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
+void submit_staged_buffer_copy(TransientCommandPool& transient_pool, VkBuffer staging_buffer, VkDeviceMemory staging_memory, VkBuffer dst_buffer, VkDeviceSize amount, VkDeviceSize dst_offset)
+{
+    TransientCommandBuffer& transient_commands = begin_transient_commands(transient_pool);
+    record_buffer_copy(transient_commands.command_buffer, staging_buffer, dst_buffer, amount, dst_offset);
 
-    // The src mask specifies the memory that needs to be made available for the later commands to use.
-    // This memory can only be made available from the specific stages specified in the src stages flags.
-    // This is essentially specifying the data that we need to be moved at certain points to the L2 cache.
-    barrier.srcAccessMask = available_memory;
+    // The staging buffer is released when the command buffer is recycled, rather than waiting for the copy here.
+    release_after_completion(transient_commands, staging_buffer, staging_memory);
+    submit_transient_commands(transient_pool, transient_commands);
+}
 
-    // The dst mask specifies the memory that needs to be made visible from the available memory for later commands to use.
-    // It's possible to make memory available but not visible. 
-    // This is essentially specifying the data that we need in the L1 cache for direct reads/writes.
-    barrier.dstAccessMask = visible_memory;
+void record_image_transitions(VkCommandBuffer command_buffer, std::span<const ImageTransition> transitions, VkPipelineStageFlags dependent_stages, VkPipelineStageFlags output_stages) {
+    std::vector<VkImageMemoryBarrier> barriers(transitions.size());
+    for (std::size_t i = 0; i < transitions.size(); ++i) {
+        const ImageTransition& transition = transitions[i];
+        VkImageMemoryBarrier& barrier = barriers[i];
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+
+        // Transfering layout (data format)
+        barrier.oldLayout = transition.old_layout;
+        barrier.newLayout = transition.new_layout;
+
+        // Transfering queue family index.
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+
+        barrier.image = transition.image;
+
+        // Region of image
+        barrier.subresourceRange.aspectMask = transition.aspect;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+
+        // The src mask specifies the memory that needs to be made available for the later commands to use.
+        // This memory can only be made available from the specific stages specified in the src stages flags.
+        // This is essentially specifying the data that we need to be moved at certain points to the L2 cache.
+        barrier.srcAccessMask = transition.available_memory;
+
+        // The dst mask specifies the memory that needs to be made visible from the available memory for later commands to use.
+        // It's possible to make memory available but not visible. 
+        // This is essentially specifying the data that we need in the L1 cache for direct reads/writes.
+        barrier.dstAccessMask = transition.visible_memory;
+    }
 
     // ^ The problem that these flags solve is keeping data coherent across GPU caches. Once execution of previous stages has completed, there can still be information in the L1 cache
     // which needs to be moved back to the L2 cache to be redistributed for other work. These flags also come in READ and WRITE forms, to inform the Vulkan API of the types of operations performed
@@ -220,6 +277,7 @@ static void submit_image_transition_command(VkDevice device, VkCommandPool comma
     // The dst mask specifies the furthest stages the later commands can go before having to wait for the previous commands to reach a certain stage, 
     // The src mask specifies the certain stages that the dst mask must wait on before the commands can continue. 
     // This is essentially informing later commands to wait on certain stages until earlier commands reach certain stages and necessary data arrives. 
+    // All of the transitions are given to a single barrier, rather than one barrier per image, so the GPU only has to drain once.
     vkCmdPipelineBarrier(
         command_buffer,
         dependent_stages,
@@ -227,16 +285,11 @@ static void submit_image_transition_command(VkDevice device, VkCommandPool comma
         0, /*0 or VK_DEPENDECY_BY_REGION_BIT*/
         0, nullptr,
         0, nullptr,
-        1, &barrier
+        static_cast<uint32_t>(barriers.size()), barriers.data()
     );
-
-    end_single_time_commands(device, command_pool, command_queue, command_buffer);
 }
 
-
-static void submit_buffer_to_image_command(VkDevice device, VkCommandPool command_pool, VkQueue command_queue, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
-    VkCommandBuffer command_buffer = begin_single_time_commands(device, command_pool);
-
+static void record_buffer_to_image_copy(VkCommandBuffer command_buffer, VkBuffer buffer, VkImage image, uint32_t width, uint32_t height) {
     // The region of the image to copy:
 
     VkBufferImageCopy region{};
@@ -267,23 +320,25 @@ static void submit_buffer_to_image_command(VkDevice device, VkCommandPool comman
         1,
         &region
     );
-
-    end_single_time_commands(device, command_pool, command_queue, command_buffer);
 }
 
-std::tuple<VkBuffer, VkDeviceMemory> create_gpu_buffer(VkDevice device, VkPhysicalDevice physical_device, VkCommandPool command_pool, VkQueue command_queue, VkBufferUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags, std::span<const uint8_t> data)
+std::tuple<VkBuffer, VkDeviceMemory> create_gpu_buffer(VkDevice device, VkPhysicalDevice physical_device, TransientCommandPool& transient_pool, VkBufferUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags, std::span<const uint8_t> data)
 {
-    auto [staging_buffer, staging_buffer_memory] = create_buffer(device, physical_device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, data);
+    // When device local memory can be mapped there's no need for the staging buffer or the copy submission, write the data straight into place.
+    if (should_upload_buffer_directly(physical_device)) {
+        return create_buffer(device, physical_device, usage_flags, DIRECT_UPLOAD_MEMORY_FLAGS | memory_flags, data);
+    }
+
+    auto [staging_buffer, staging_buffer_memory] = create_staging_buffer(device, physical_device, data);
     auto [gpu_buffer, gpu_buffer_memory] = create_buffer(device, physical_device, VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage_flags, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | memory_flags, data.size());
-    submit_buffer_copy_command(device, command_pool, command_queue, staging_buffer, gpu_buffer, data.size());
-    vkFreeMemory(device, staging_buffer_memory, nullptr);
-    vkDestroyBuffer(device, staging_buffer, nullptr);
+    submit_staged_buffer_copy(transient_pool, staging_buffer, staging_buffer_memory, gpu_buffer, data.size());
     return { gpu_buffer, gpu_buffer_memory };
 }
 
 FrameUniformBuffers create_frame_uniform_buffers(VkDevice device, VkPhysicalDevice physical_device)
 {
     FrameUniformBuffers frame_uniform_buffers{};
+    MemoryTagScope tag_scope{ MemoryTag::Uniform };
 
     for (UniformBuffer& uniform_buffer : frame_uniform_buffers) {
         auto [buffer, buffer_memory] = create_buffer(device, physical_device, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, sizeof(UniformBufferContent));
@@ -314,8 +369,8 @@ std::tuple<VkImage, VkDeviceMemory> create_image(VkDevice device, VkPhysicalDevi
     image_info.tiling = tiling;
 
     // The initial layout specifies if it is okay to discard the texels before entering the first transition.
-    // In this case, we will be transitioning the image straight to the GPU before initialising the texels so there's no need to preseve them on the first transition.
-    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    // The texels are written by the host before the first transition, so they must be preserved.
+    image_info.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
     image_info.usage = usage_flags;
 
     // Sharing mode is needed if we want to share the resource across multiple queue families.
@@ -338,16 +393,24 @@ std::tuple<VkImage, VkDeviceMemory> create_image(VkDevice device, VkPhysicalDevi
     allocInfo.allocationSize = requirements.size;
     allocInfo.memoryTypeIndex = find_memory_type(physical_device, memory_flags, requirements.memoryTypeBits).value_or(UINT32_MAX);
 
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &image_memory) != VK_SUCCESS) {
+    if (allocate_device_memory(device, allocInfo, image_memory) != VK_SUCCESS) {
         log_error("Failed to create image memory");
         return { image, VK_NULL_HANDLE };
     }
 
     vkBindImageMemory(device, image, image_memory, 0);
 
+    // Rows of a linear image can be padded by the implementation, so copy one row at a time using the row pitch it reports.
+    VkImageSubresource subresource{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0 };
+    VkSubresourceLayout layout{};
+    vkGetImageSubresourceLayout(device, image, &subresource, &layout);
+
+    std::size_t row_size = data.size() / height;
     uint8_t* mapped_memory = VK_NULL_HANDLE;
     vkMapMemory(device, image_memory, 0, requirements.size, 0, (void**)&mapped_memory);
-    std::copy(data.begin(), data.end(), mapped_memory);
+    for (uint32_t row = 0; row < height; ++row) {
+        std::copy_n(data.begin() + row * row_size, row_size, mapped_memory + layout.offset + row * layout.rowPitch);
+    }
     vkUnmapMemory(device, image_memory);
 
     return { image, image_memory };
@@ -396,7 +459,7 @@ std::tuple<VkImage, VkDeviceMemory> create_image(VkDevice device, VkPhysicalDevi
     allocInfo.allocationSize = requirements.size;
     allocInfo.memoryTypeIndex = find_memory_type(physical_device, memory_flags, requirements.memoryTypeBits).value_or(UINT32_MAX);
 
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &image_memory) != VK_SUCCESS) {
+    if (allocate_device_memory(device, allocInfo, image_memory) != VK_SUCCESS) {
         log_error("Failed to create image memory");
         return { image, VK_NULL_HANDLE };
     }
@@ -405,18 +468,40 @@ std::tuple<VkImage, VkDeviceMemory> create_image(VkDevice device, VkPhysicalDevi
     return { image, image_memory };
 }
 
-std::tuple<VkImage, VkDeviceMemory> create_gpu_image(VkDevice device, VkPhysicalDevice physical_device, VkCommandPool command_pool, VkQueue command_queue,  VkFormat format, VkImageTiling tiling, uint32_t width, uint32_t height, std::span<const uint8_t> data)
+std::tuple<VkImage, VkDeviceMemory> create_gpu_image(VkDevice device, VkPhysicalDevice physical_device, TransientCommandPool& transient_pool, VkFormat format, VkImageTiling tiling, uint32_t width, uint32_t height, std::span<const uint8_t> data)
 {
-    auto [buffer, buffer_memory] = create_buffer(device, physical_device, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, data);
+    if (should_upload_image_directly(physical_device, format)) {
+        auto [image, image_memory] = create_image(device, physical_device, VK_IMAGE_USAGE_SAMPLED_BIT, DIRECT_UPLOAD_MEMORY_FLAGS, format, VK_IMAGE_TILING_LINEAR, width, height, data);
+
+        // The host writes only need to be made visible to the shader, there is no copy.
+        TransientCommandBuffer& transient_commands = begin_transient_commands(transient_pool);
+        ImageTransition to_shader_read{ image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_PREINITIALIZED, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_HOST_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT };
+        record_image_transitions(transient_commands.command_buffer, { &to_shader_read, 1 }, VK_PIPELINE_STAGE_HOST_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        submit_transient_commands(transient_pool, transient_commands);
+        return { image, image_memory };
+    }
+
     auto [image, image_memory] = create_image(device, physical_device, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, format, tiling, width, height);
+    submit_staged_image_copy(device, physical_device, transient_pool, image, width, height, data);
+    return { image, image_memory };
+}
 
-    submit_image_transition_command(device, command_pool, command_queue, image, format, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
-    submit_buffer_to_image_command(device, command_pool, command_queue, buffer, image, width, height);
-    submit_image_transition_command(device, command_pool, command_queue, image, format, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
-    vkFreeMemory(device, buffer_memory, nullptr);
-    vkDestroyBuffer(device, buffer, nullptr);
+void submit_staged_image_copy(VkDevice device, VkPhysicalDevice physical_device, TransientCommandPool& transient_pool, VkImage image, uint32_t width, uint32_t height, std::span<const uint8_t> data)
+{
+    auto [buffer, buffer_memory] = create_staging_buffer(device, physical_device, data);
 
-    return { image, image_memory };
+    // The transitions and the copy are recorded into one command buffer and submitted once, instead of a submit and a queue idle per step.
+    TransientCommandBuffer& transient_commands = begin_transient_commands(transient_pool);
+
+    ImageTransition to_transfer_dst{ image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 0, VK_ACCESS_TRANSFER_WRITE_BIT };
+    record_image_transitions(transient_commands.command_buffer, { &to_transfer_dst, 1 }, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+    record_buffer_to_image_copy(transient_commands.command_buffer, buffer, image, width, height);
+
+    ImageTransition to_shader_read{ image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT };
+    record_image_transitions(transient_commands.command_buffer, { &to_shader_read, 1 }, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+    release_after_completion(transient_commands, buffer, buffer_memory);
+    submit_transient_commands(transient_pool, transient_commands);
 }
 
 VkImageView create_image_view(VkDevice device, VkImage image, VkFormat interpret_format, VkImageAspectFlags interpret_aspect)
@@ -3,12 +3,15 @@
 #include <tuple>
 #include <span>
 #include <array>
+#include <optional>
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.h>
 #include "constants.h"
+#include "command.h"
 
+// Only what is shared by every draw in the frame, per-object data is pushed with each draw instead.
 struct UniformBufferContent {
-	glm::mat4 transform;
+	glm::mat4 view_projection;
 };
 struct UniformBuffer {
 	void* mapped_region{ VK_NULL_HANDLE };
@@ -18,6 +21,31 @@ struct UniformBuffer {
 
 using FrameUniformBuffers = std::array<UniformBuffer, MAX_FRAMES_IN_FLIGHT>;
 
+std::optional<uint32_t> find_memory_type(VkPhysicalDevice physical_device, VkMemoryPropertyFlags required_property_flags, uint32_t type_filter);
+
+// How create_gpu_buffer and create_gpu_image get data onto the device.
+// Staging -> write into host memory and copy into device local memory with a transfer command.
+// Direct -> write straight into device local memory that is host visible (unified memory or resizable BAR).
+// Automatic -> direct when the device supports it well, otherwise staging. The other two are there to force a path for benchmarking.
+enum class UploadPath {
+	Automatic,
+	Staging,
+	Direct,
+};
+
+// Device local memory the host can write to.
+static constexpr VkMemoryPropertyFlags DIRECT_UPLOAD_MEMORY_FLAGS = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+void set_upload_path(UploadPath path);
+UploadPath get_upload_path();
+bool has_direct_upload_memory(VkPhysicalDevice physical_device);
+
+// True when buffers should be written straight into DIRECT_UPLOAD_MEMORY_FLAGS memory rather than staged.
+bool should_upload_buffer_directly(VkPhysicalDevice physical_device);
+
+// True when create_gpu_image would write the texels straight into a linear image rather than staging them into an optimal one.
+bool should_upload_image_directly(VkPhysicalDevice physical_device, VkFormat format);
+
 std::tuple<VkBuffer, VkDeviceMemory> create_buffer(VkDevice device, VkPhysicalDevice physical_device, VkBufferUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags, std::span<const uint8_t> data);
 
 template<typename T>
@@ -26,19 +54,46 @@ constexpr std::tuple<VkBuffer, VkDeviceMemory> create_buffer(VkDevice device, Vk
 }
 
 std::tuple<VkBuffer, VkDeviceMemory> create_buffer(VkDevice device, VkPhysicalDevice physical_device, VkBufferUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags, std::size_t size);
-void submit_buffer_copy_command(VkDevice device, VkCommandPool command_pool, VkQueue command_queue, VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize amount);
+
+// Host visible transfer source holding a copy of data, tracked as staging memory whatever the caller's tag is.
+std::tuple<VkBuffer, VkDeviceMemory> create_staging_buffer(VkDevice device, VkPhysicalDevice physical_device, std::span<const uint8_t> data);
+
+template<typename T>
+constexpr std::tuple<VkBuffer, VkDeviceMemory> create_staging_buffer(VkDevice device, VkPhysicalDevice physical_device, std::span<const T> data) {
+	return create_staging_buffer(device, physical_device, { (const uint8_t*)data.data(), data.size() * sizeof(T) });
+}
+
+// Records a copy and a barrier that makes the copied data visible to any later command.
+void record_buffer_copy(VkCommandBuffer command_buffer, VkBuffer src_buffer, VkBuffer dst_buffer, VkDeviceSize amount, VkDeviceSize dst_offset = 0, VkDeviceSize src_offset = 0);
+
+// Copies from a staging buffer without waiting, the staging buffer is destroyed once the copy has completed.
+void submit_staged_buffer_copy(TransientCommandPool& transient_pool, VkBuffer staging_buffer, VkDeviceMemory staging_memory, VkBuffer dst_buffer, VkDeviceSize amount, VkDeviceSize dst_offset = 0);
+
+struct ImageTransition {
+	VkImage image{ VK_NULL_HANDLE };
+	VkImageAspectFlags aspect{ VK_IMAGE_ASPECT_COLOR_BIT };
+	VkImageLayout old_layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+	VkImageLayout new_layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+	VkAccessFlags available_memory{ 0 };
+	VkAccessFlags visible_memory{ 0 };
+};
+
+// Records every transition in a single pipeline barrier.
+void record_image_transitions(VkCommandBuffer command_buffer, std::span<const ImageTransition> transitions, VkPipelineStageFlags dependent_stages, VkPipelineStageFlags output_stages);
 
 
-std::tuple<VkBuffer, VkDeviceMemory> create_gpu_buffer(VkDevice device, VkPhysicalDevice physical_device, VkCommandPool command_pool, VkQueue command_queue, VkBufferUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags, std::span<const uint8_t> data);
+std::tuple<VkBuffer, VkDeviceMemory> create_gpu_buffer(VkDevice device, VkPhysicalDevice physical_device, TransientCommandPool& transient_pool, VkBufferUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags, std::span<const uint8_t> data);
 
 template<typename T>
-constexpr std::tuple<VkBuffer, VkDeviceMemory> create_gpu_buffer(VkDevice device, VkPhysicalDevice physical_device, VkCommandPool command_pool, VkQueue command_queue, VkBufferUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags, std::span<const T> data) {
-	return create_gpu_buffer(device, physical_device, command_pool, command_queue, usage_flags, memory_flags, { (const uint8_t*)data.data(), data.size() * sizeof(T) });
+constexpr std::tuple<VkBuffer, VkDeviceMemory> create_gpu_buffer(VkDevice device, VkPhysicalDevice physical_device, TransientCommandPool& transient_pool, VkBufferUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags, std::span<const T> data) {
+	return create_gpu_buffer(device, physical_device, transient_pool, usage_flags, memory_flags, { (const uint8_t*)data.data(), data.size() * sizeof(T) });
 }
 
 FrameUniformBuffers create_frame_uniform_buffers(VkDevice device, VkPhysicalDevice physical_device);
 std::tuple<VkImage, VkDeviceMemory> create_image(VkDevice device, VkPhysicalDevice physical_device, VkImageUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags, VkFormat format, VkImageTiling tiling, uint32_t width, uint32_t height, std::span<const uint8_t> data);
 std::tuple<VkImage, VkDeviceMemory> create_image(VkDevice device, VkPhysicalDevice physical_device, VkImageUsageFlags usage_flags, VkMemoryPropertyFlags memory_flags, VkFormat format, VkImageTiling tiling, uint32_t width, uint32_t height);
-std::tuple<VkImage, VkDeviceMemory> create_gpu_image(VkDevice device, VkPhysicalDevice physical_device, VkCommandPool command_pool, VkQueue command_queue, VkFormat format, VkImageTiling tiling, uint32_t width, uint32_t height, std::span<const uint8_t> data);
+// Copies data into an image that is in the undefined layout without waiting, and leaves it ready to be sampled by fragment shaders.
+void submit_staged_image_copy(VkDevice device, VkPhysicalDevice physical_device, TransientCommandPool& transient_pool, VkImage image, uint32_t width, uint32_t height, std::span<const uint8_t> data);
+std::tuple<VkImage, VkDeviceMemory> create_gpu_image(VkDevice device, VkPhysicalDevice physical_device, TransientCommandPool& transient_pool, VkFormat format, VkImageTiling tiling, uint32_t width, uint32_t height, std::span<const uint8_t> data);
 
 VkImageView create_image_view(VkDevice device, VkImage image, VkFormat interpret_format, VkImageAspectFlags interpret_aspect);
\ No newline at end of file
@@ -0,0 +1,324 @@
+#include <array>
+#include <algorithm>
+#include "bvh.h"
+#include "cpu_profiler.h"
+
+static constexpr std::size_t SAH_BIN_COUNT = 16;
+
+// Leaves are split while the heuristic says it pays off, but never allowed to get bigger than this.
+static constexpr uint32_t MAX_LEAF_SIZE = 8;
+
+// Cost of visiting a node relative to testing an object's bounds.
+static constexpr float TRAVERSAL_COST = 1.0f;
+
+struct BvhBuildContext {
+	std::span<const Aabb> object_bounds;
+	std::vector<glm::vec3> centres;
+	Bvh& bvh;
+};
+
+struct SahSplit {
+	int axis{ -1 };
+	std::size_t bin{ 0 };
+	float cost{ std::numeric_limits<float>::max() };
+};
+
+static std::size_t get_bin(float centre, float centre_min, float bin_scale) {
+	return std::min(static_cast<std::size_t>((centre - centre_min) * bin_scale), SAH_BIN_COUNT - 1);
+}
+
+static SahSplit find_sah_split(const BvhBuildContext& context, uint32_t first, uint32_t count, const Aabb& centre_bounds) {
+	SahSplit best{};
+
+	for (int axis = 0; axis < 3; ++axis) {
+		float extent = centre_bounds.max[axis] - centre_bounds.min[axis];
+		if (extent <= 0.0f) {
+			continue;
+		}
+
+		std::array<Aabb, SAH_BIN_COUNT> bin_bounds{};
+		std::array<uint32_t, SAH_BIN_COUNT> bin_counts{};
+		float bin_scale = SAH_BIN_COUNT / extent;
+
+		for (uint32_t i = first; i < first + count; ++i) {
+			uint32_t object = context.bvh.object_indices[i];
+			std::size_t bin = get_bin(context.centres[object][axis], centre_bounds.min[axis], bin_scale);
+			grow_aabb(bin_bounds[bin], context.object_bounds[object]);
+			++bin_counts[bin];
+		}
+
+		// Sweeping from each end gives the cost of both sides of every boundary in two passes.
+		std::array<float, SAH_BIN_COUNT - 1> left_costs{};
+		Aabb left_bounds{};
+		uint32_t left_count = 0;
+		for (std::size_t i = 0; i < SAH_BIN_COUNT - 1; ++i) {
+			grow_aabb(left_bounds, bin_bounds[i]);
+			left_count += bin_counts[i];
+			left_costs[i] = get_aabb_surface_area(left_bounds) * left_count;
+		}
+
+		Aabb right_bounds{};
+		uint32_t right_count = 0;
+		for (std::size_t i = SAH_BIN_COUNT - 1; i > 0; --i) {
+			grow_aabb(right_bounds, bin_bounds[i]);
+			right_count += bin_counts[i];
+
+			// Splitting after bin i - 1.
+			float cost = left_costs[i - 1] + get_aabb_surface_area(right_bounds) * right_count;
+			if (right_count < count && right_count > 0 && cost < best.cost) {
+				best.axis = axis;
+				best.bin = i - 1;
+				best.cost = cost;
+			}
+		}
+	}
+
+	return best;
+}
+
+static uint32_t build_node(BvhBuildContext& context, uint32_t first, uint32_t count) {
+	Bvh& bvh = context.bvh;
+	uint32_t node_index = static_cast<uint32_t>(bvh.nodes.size());
+	bvh.nodes.emplace_back();
+
+	Aabb bounds{};
+	Aabb centre_bounds{};
+	for (uint32_t i = first; i < first + count; ++i) {
+		uint32_t object = bvh.object_indices[i];
+		grow_aabb(bounds, context.object_bounds[object]);
+		grow_aabb(centre_bounds, context.centres[object]);
+	}
+
+	bvh.nodes[node_index].bounds_min = bounds.min;
+	bvh.nodes[node_index].bounds_max = bounds.max;
+
+	auto make_leaf = [&]() {
+		bvh.nodes[node_index].right_or_first = first;
+		bvh.nodes[node_index].object_count = count;
+		return node_index;
+	};
+
+	if (count <= 1) {
+		return make_leaf();
+	}
+
+	// Costs are left relative to the node's surface area, which is the same for every split, so the leaf cost is scaled to match.
+	SahSplit split = find_sah_split(context, first, count, centre_bounds);
+	float area = get_aabb_surface_area(bounds);
+	float leaf_cost = area * count;
+	float split_cost = area * TRAVERSAL_COST + split.cost;
+
+	uint32_t middle = first;
+	if (split.axis >= 0 && (split_cost < leaf_cost || count > MAX_LEAF_SIZE)) {
+		float bin_scale = SAH_BIN_COUNT / (centre_bounds.max[split.axis] - centre_bounds.min[split.axis]);
+		auto begin = bvh.object_indices.begin() + first;
+		auto partition = std::partition(begin, begin + count, [&](uint32_t object) {
+			return get_bin(context.centres[object][split.axis], centre_bounds.min[split.axis], bin_scale) <= split.bin;
+		});
+
+		middle = static_cast<uint32_t>(partition - bvh.object_indices.begin());
+	}
+	else if (count > MAX_LEAF_SIZE) {
+		// Every centre is in the same place so there's nothing to choose between, halving still keeps leaves small.
+		middle = first + count / 2;
+	}
+	else {
+		return make_leaf();
+	}
+
+	// The left child is built first so it lands directly after this node.
+	build_node(context, first, middle - first);
+	uint32_t right = build_node(context, middle, first + count - middle);
+	bvh.nodes[node_index].right_or_first = right;
+	bvh.nodes[node_index].object_count = 0;
+	return node_index;
+}
+
+Bvh build_bvh(std::span<const Aabb> object_bounds)
+{
+	PROFILE_FUNCTION();
+
+	Bvh bvh{};
+	if (object_bounds.empty()) {
+		return bvh;
+	}
+
+	bvh.object_indices.resize(object_bounds.size());
+	for (uint32_t i = 0; i < bvh.object_indices.size(); ++i) {
+		bvh.object_indices[i] = i;
+	}
+
+	// A binary tree with leaves of at least one object has fewer than twice as many nodes as objects.
+	bvh.nodes.reserve(object_bounds.size() * 2);
+
+	BvhBuildContext context{ object_bounds, {}, bvh };
+	context.centres.reserve(object_bounds.size());
+	for (const Aabb& bounds : object_bounds) {
+		context.centres.push_back(get_aabb_centre(bounds));
+	}
+
+	build_node(context, 0, static_cast<uint32_t>(object_bounds.size()));
+	return bvh;
+}
+
+void refit_bvh(Bvh& bvh, std::span<const Aabb> object_bounds)
+{
+	PROFILE_FUNCTION();
+
+	// Children always come after their parent, so walking backwards updates every child before its parent.
+	for (std::size_t i = bvh.nodes.size(); i-- > 0;) {
+		BvhNode& node = bvh.nodes[i];
+		Aabb bounds{};
+
+		if (node.object_count > 0) {
+			for (uint32_t j = node.right_or_first; j < node.right_or_first + node.object_count; ++j) {
+				grow_aabb(bounds, object_bounds[bvh.object_indices[j]]);
+			}
+		}
+		else {
+			const BvhNode& left = bvh.nodes[i + 1];
+			const BvhNode& right = bvh.nodes[node.right_or_first];
+			bounds.min = glm::min(left.bounds_min, right.bounds_min);
+			bounds.max = glm::max(left.bounds_max, right.bounds_max);
+		}
+
+		node.bounds_min = bounds.min;
+		node.bounds_max = bounds.max;
+	}
+}
+
+static void append_subtree(const Bvh& bvh, uint32_t node_index, std::vector<uint32_t>& out_visible) {
+	// A subtree's objects are contiguous, from where its leftmost leaf's start to where its rightmost leaf's end.
+	uint32_t first_leaf = node_index;
+	while (bvh.nodes[first_leaf].object_count == 0) {
+		first_leaf = first_leaf + 1;
+	}
+
+	uint32_t last_leaf = node_index;
+	while (bvh.nodes[last_leaf].object_count == 0) {
+		last_leaf = bvh.nodes[last_leaf].right_or_first;
+	}
+
+	auto begin = bvh.object_indices.begin();
+	out_visible.insert(out_visible.end(), begin + bvh.nodes[first_leaf].right_or_first, begin + bvh.nodes[last_leaf].right_or_first + bvh.nodes[last_leaf].object_count);
+}
+
+void cull_bvh(const Bvh& bvh, std::span<const Aabb> object_bounds, const FrustumPlanes& frustum_planes, std::vector<uint32_t>& out_visible)
+{
+	PROFILE_FUNCTION();
+
+	if (bvh.nodes.empty()) {
+		return;
+	}
+
+	std::vector<uint32_t> stack{};
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while (!stack.empty()) {
+		uint32_t node_index = stack.back();
+		stack.pop_back();
+
+		const BvhNode& node = bvh.nodes[node_index];
+		FrustumOverlap overlap = classify_aabb_in_frustum(frustum_planes, Aabb{ node.bounds_min, node.bounds_max });
+		if (overlap == FrustumOverlap::Outside) {
+			continue;
+		}
+
+		if (overlap == FrustumOverlap::Inside) {
+			append_subtree(bvh, node_index, out_visible);
+			continue;
+		}
+
+		if (node.object_count > 0) {
+			for (uint32_t i = node.right_or_first; i < node.right_or_first + node.object_count; ++i) {
+				uint32_t object = bvh.object_indices[i];
+				if (classify_aabb_in_frustum(frustum_planes, object_bounds[object]) != FrustumOverlap::Outside) {
+					out_visible.push_back(object);
+				}
+			}
+
+			continue;
+		}
+
+		stack.push_back(node.right_or_first);
+		stack.push_back(node_index + 1);
+	}
+}
+
+// Distance along the ray to where it enters the box, or nothing if it misses or only hits beyond max_distance.
+static std::optional<float> intersect_ray_aabb(const glm::vec3& bounds_min, const glm::vec3& bounds_max, const glm::vec3& origin, const glm::vec3& inverse_direction, float max_distance) {
+	glm::vec3 t0 = (bounds_min - origin) * inverse_direction;
+	glm::vec3 t1 = (bounds_max - origin) * inverse_direction;
+	glm::vec3 t_near = glm::min(t0, t1);
+	glm::vec3 t_far = glm::max(t0, t1);
+
+	float entry = std::max({ t_near.x, t_near.y, t_near.z, 0.0f });
+	float exit = std::min({ t_far.x, t_far.y, t_far.z, max_distance });
+	if (entry > exit) {
+		return std::nullopt;
+	}
+
+	return entry;
+}
+
+std::optional<BvhHit> raycast_bvh(const Bvh& bvh, std::span<const Aabb> object_bounds, const glm::vec3& origin, const glm::vec3& direction, float max_distance)
+{
+	std::optional<BvhHit> closest_hit{};
+	if (bvh.nodes.empty()) {
+		return closest_hit;
+	}
+
+	// A zero component gives an infinite inverse, which the slab test handles correctly.
+	glm::vec3 inverse_direction = 1.0f / direction;
+
+	std::vector<uint32_t> stack{};
+	stack.reserve(64);
+	stack.push_back(0);
+
+	while (!stack.empty()) {
+		uint32_t node_index = stack.back();
+		stack.pop_back();
+
+		const BvhNode& node = bvh.nodes[node_index];
+
+		// Anything entered beyond the closest hit so far can't contain a closer one.
+		float search_distance = closest_hit ? closest_hit->distance : max_distance;
+		if (!intersect_ray_aabb(node.bounds_min, node.bounds_max, origin, inverse_direction, search_distance)) {
+			continue;
+		}
+
+		if (node.object_count > 0) {
+			for (uint32_t i = node.right_or_first; i < node.right_or_first + node.object_count; ++i) {
+				uint32_t object = bvh.object_indices[i];
+				float closest_distance = closest_hit ? closest_hit->distance : max_distance;
+				std::optional<float> distance = intersect_ray_aabb(object_bounds[object].min, object_bounds[object].max, origin, inverse_direction, closest_distance);
+				if (distance && (!closest_hit || *distance < closest_hit->distance)) {
+					closest_hit = BvhHit{ object, *distance };
+				}
+			}
+
+			continue;
+		}
+
+		// The nearer child is pushed last so it is visited first, which tightens the search distance sooner.
+		uint32_t left = node_index + 1;
+		uint32_t right = node.right_or_first;
+		std::optional<float> left_distance = intersect_ray_aabb(bvh.nodes[left].bounds_min, bvh.nodes[left].bounds_max, origin, inverse_direction, search_distance);
+		std::optional<float> right_distance = intersect_ray_aabb(bvh.nodes[right].bounds_min, bvh.nodes[right].bounds_max, origin, inverse_direction, search_distance);
+
+		if (left_distance && right_distance) {
+			bool left_first = *left_distance <= *right_distance;
+			stack.push_back(left_first ? right : left);
+			stack.push_back(left_first ? left : right);
+		}
+		else if (left_distance) {
+			stack.push_back(left);
+		}
+		else if (right_distance) {
+			stack.push_back(right);
+		}
+	}
+
+	return closest_hit;
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <span>
+#include <optional>
+#include <glm/glm.hpp>
+#include "aabb.h"
+#include "frustum.h"
+
+// A bounding volume hierarchy over object bounds, for culling and ray queries that don't have to visit every object.
+//
+// Nodes are stored flattened in depth first order, so a node's left child always directly follows it and walking down the tree mostly moves forwards through memory.
+// Each node is 32 bytes, two to a cache line. Leaves refer to a contiguous run of object_indices, which the build reorders so every subtree's objects are together.
+
+struct BvhNode {
+	glm::vec3 bounds_min{ 0.0f };
+
+	// The right child for an interior node, the first entry in object_indices for a leaf.
+	uint32_t right_or_first{ 0 };
+
+	glm::vec3 bounds_max{ 0.0f };
+
+	// Zero for an interior node.
+	uint32_t object_count{ 0 };
+};
+
+static_assert(sizeof(BvhNode) == 32);
+
+struct Bvh {
+	std::vector<BvhNode> nodes{};
+	std::vector<uint32_t> object_indices{};
+};
+
+struct BvhHit {
+	uint32_t object_index{ 0 };
+	float distance{ 0.0f };
+};
+
+// Splits are chosen with the surface area heuristic, evaluated at bin boundaries along each axis rather than at every object.
+Bvh build_bvh(std::span<const Aabb> object_bounds);
+
+// Recomputes the node bounds after objects have moved, keeping the structure. Much cheaper than a rebuild, but the tree gets less efficient
+// the further objects move from where they were when it was built.
+void refit_bvh(Bvh& bvh, std::span<const Aabb> object_bounds);
+
+// Appends the index of every object whose bounds are at least partly inside the frustum. Subtrees entirely inside or outside are accepted or rejected without visiting their objects' bounds.
+void cull_bvh(const Bvh& bvh, std::span<const Aabb> object_bounds, const FrustumPlanes& frustum_planes, std::vector<uint32_t>& out_visible);
+
+// The nearest object whose bounds the ray hits. direction doesn't need to be normalised, the distance is in multiples of it.
+std::optional<BvhHit> raycast_bvh(const Bvh& bvh, std::span<const Aabb> object_bounds, const glm::vec3& origin, const glm::vec3& direction, float max_distance = std::numeric_limits<float>::max());
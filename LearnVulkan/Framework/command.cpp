@@ -1,5 +1,6 @@
 #include "command.h"
 #include "error.h"
+#include "memory_stats.h"
 
 VkCommandPool create_command_pool(VkDevice device, std::size_t queue_family_index, bool buffers_individually_resetable, bool buffers_frequently_recorded)
 {
@@ -67,18 +68,173 @@ static SyncObjects create_sync_objects(VkDevice device)
 }
 
 
-FrameExecutions create_frame_executions(VkDevice device, VkCommandPool pool)
+FrameExecutions create_frame_executions(VkDevice device)
 {
 	FrameExecutions frame_executions{};
-	std::array<VkCommandBuffer, MAX_FRAMES_IN_FLIGHT> command_buffers{ VK_NULL_HANDLE };
-	create_command_buffers(device, pool, true, command_buffers);
-
 	for (std::size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-		frame_executions[i].command_buffer = command_buffers[i];
 		frame_executions[i].sync = create_sync_objects(device);
 	}
 
 	return frame_executions;
 }
 
+CommandRecordingCache create_command_recording_cache(VkDevice device, VkCommandPool pool, std::size_t image_count)
+{
+	CommandRecordingCache cache{};
+	cache.device = device;
+	cache.pool = pool;
+	resize_command_recording_cache(cache, image_count);
+	return cache;
+}
+
+void destroy_command_recording_cache(CommandRecordingCache& cache)
+{
+	for (const RecordedCommandBuffer& recorded : cache.buffers) {
+		vkFreeCommandBuffers(cache.device, cache.pool, 1, &recorded.command_buffer);
+	}
+
+	cache = CommandRecordingCache{};
+}
+
+void invalidate_recorded_commands(CommandRecordingCache& cache)
+{
+	++cache.version;
+}
+
+void resize_command_recording_cache(CommandRecordingCache& cache, std::size_t image_count)
+{
+	invalidate_recorded_commands(cache);
+
+	std::size_t buffer_count = image_count * MAX_FRAMES_IN_FLIGHT;
+	if (buffer_count <= cache.buffers.size()) {
+		return;
+	}
 
+	std::vector<VkCommandBuffer> command_buffers(buffer_count - cache.buffers.size(), VK_NULL_HANDLE);
+	create_command_buffers(cache.device, cache.pool, true, command_buffers);
+	for (VkCommandBuffer command_buffer : command_buffers) {
+		cache.buffers.push_back({ command_buffer, UINT64_MAX });
+	}
+}
+
+VkCommandBuffer get_recorded_commands(CommandRecordingCache& cache, std::size_t frame_index, std::size_t image_index, bool& out_needs_recording)
+{
+	RecordedCommandBuffer& recorded = cache.buffers[image_index * MAX_FRAMES_IN_FLIGHT + frame_index];
+	out_needs_recording = recorded.recorded_version != cache.version;
+	recorded.recorded_version = cache.version;
+	return recorded.command_buffer;
+}
+
+
+
+
+TransientCommandPool create_transient_command_pool(VkDevice device, std::size_t queue_family_index, VkQueue queue)
+{
+	TransientCommandPool transient_pool{};
+	transient_pool.device = device;
+	transient_pool.queue = queue;
+
+	// The transient flag hints to the driver that the buffers are short lived, and each buffer is reset individually when recycled.
+	transient_pool.pool = create_command_pool(device, queue_family_index, true, true);
+	return transient_pool;
+}
+
+static void release_completed_resources(VkDevice device, TransientCommandBuffer& transient_commands) {
+	for (VkBuffer buffer : transient_commands.release_buffers) {
+		vkDestroyBuffer(device, buffer, nullptr);
+	}
+
+	for (VkDeviceMemory memory : transient_commands.release_memory) {
+		free_device_memory(device, memory);
+	}
+
+	transient_commands.release_buffers.clear();
+	transient_commands.release_memory.clear();
+	transient_commands.submitted = false;
+}
+
+void destroy_transient_command_pool(TransientCommandPool& transient_pool)
+{
+	for (TransientCommandBuffer& transient_commands : transient_pool.buffers) {
+		if (transient_commands.submitted) {
+			vkWaitForFences(transient_pool.device, 1, &transient_commands.fence, VK_TRUE, UINT64_MAX);
+		}
+
+		release_completed_resources(transient_pool.device, transient_commands);
+		vkDestroyFence(transient_pool.device, transient_commands.fence, nullptr);
+	}
+
+	// Destroying the pool frees all of the command buffers allocated from it.
+	vkDestroyCommandPool(transient_pool.device, transient_pool.pool, nullptr);
+	transient_pool = TransientCommandPool{};
+}
+
+TransientCommandBuffer& begin_transient_commands(TransientCommandPool& transient_pool)
+{
+	TransientCommandBuffer* free_commands = nullptr;
+	for (TransientCommandBuffer& transient_commands : transient_pool.buffers) {
+		if (!transient_commands.submitted) {
+			free_commands = &transient_commands;
+			break;
+		}
+
+		// Polling the fence never blocks, if the GPU is done with the buffer it can be recycled.
+		if (vkGetFenceStatus(transient_pool.device, transient_commands.fence) == VK_SUCCESS) {
+			release_completed_resources(transient_pool.device, transient_commands);
+			free_commands = &transient_commands;
+			break;
+		}
+	}
+
+	if (free_commands == nullptr) {
+		free_commands = &transient_pool.buffers.emplace_back();
+		create_command_buffers(transient_pool.device, transient_pool.pool, true, std::span<VkCommandBuffer>(&free_commands->command_buffer, 1));
+
+		VkFenceCreateInfo fence_info{};
+		fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+		if (vkCreateFence(transient_pool.device, &fence_info, nullptr, &free_commands->fence) != VK_SUCCESS) {
+			log_error("Failed to create transient command fence.");
+		}
+	}
+
+	// Marked as submitted straight away so that nested begins don't hand out the same buffer while it's recording.
+	free_commands->submitted = true;
+	vkResetFences(transient_pool.device, 1, &free_commands->fence);
+
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+	// Begin implicitly resets the buffer since the pool was created with the reset flag.
+	if (vkBeginCommandBuffer(free_commands->command_buffer, &begin_info) != VK_SUCCESS) {
+		log_error("Failed to begin transient command buffer.");
+	}
+
+	return *free_commands;
+}
+
+void release_after_completion(TransientCommandBuffer& transient_commands, VkBuffer buffer, VkDeviceMemory memory)
+{
+	transient_commands.release_buffers.push_back(buffer);
+	transient_commands.release_memory.push_back(memory);
+}
+
+void submit_transient_commands(TransientCommandPool& transient_pool, TransientCommandBuffer& transient_commands, bool wait_until_complete)
+{
+	vkEndCommandBuffer(transient_commands.command_buffer);
+
+	VkSubmitInfo submit_info{};
+	submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submit_info.commandBufferCount = 1;
+	submit_info.pCommandBuffers = &transient_commands.command_buffer;
+
+	if (vkQueueSubmit(transient_pool.queue, 1, &submit_info, transient_commands.fence) != VK_SUCCESS) {
+		log_error("Failed to submit transient commands.");
+	}
+
+	// Only wait when the caller needs to touch the resources afterwards, otherwise later submissions on the same queue are ordered after this one anyway.
+	if (wait_until_complete) {
+		vkWaitForFences(transient_pool.device, 1, &transient_commands.fence, VK_TRUE, UINT64_MAX);
+		release_completed_resources(transient_pool.device, transient_commands);
+	}
+}
\ No newline at end of file
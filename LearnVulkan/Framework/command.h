@@ -3,6 +3,8 @@
 #include <cstddef>
 #include <span>
 #include <array>
+#include <deque>
+#include <vector>
 #include "constants.h"
 
 struct SyncObjects {
@@ -11,8 +13,8 @@ struct SyncObjects {
 	VkFence in_flight_fence{ VK_NULL_HANDLE };
 };
 
+// The frame's commands come from a CommandRecordingCache, so only the synchronisation is per frame.
 struct FrameExecution {
-	VkCommandBuffer command_buffer;
 	SyncObjects sync;
 };
 
@@ -20,4 +22,62 @@ using FrameExecutions = std::array<FrameExecution, MAX_FRAMES_IN_FLIGHT>;
 
 VkCommandPool create_command_pool(VkDevice device, std::size_t queue_family_index, bool buffers_individually_resetable, bool buffers_frequently_recorded = false);
 void create_command_buffers(VkDevice device, VkCommandPool pool, bool is_primary, std::span<VkCommandBuffer> out_command_buffers);
-FrameExecutions create_frame_executions(VkDevice device, VkCommandPool pool);
\ No newline at end of file
+FrameExecutions create_frame_executions(VkDevice device);
+
+// Most frames record exactly the same commands, only the uniform buffer contents change. Rather than re-recording every frame, a command buffer is kept
+// for each frame in flight and swapchain image, and is only re-recorded when something it references has changed since it was recorded.
+// A buffer is only re-recorded after its frame's fence has been waited on, so it is never pending when it is reset.
+struct RecordedCommandBuffer {
+	VkCommandBuffer command_buffer{ VK_NULL_HANDLE };
+	uint64_t recorded_version{ UINT64_MAX };
+};
+
+struct CommandRecordingCache {
+	VkDevice device{ VK_NULL_HANDLE };
+	VkCommandPool pool{ VK_NULL_HANDLE };
+
+	// Bumped whenever pipelines, geometry, descriptor sets or framebuffers used by the recorded commands change.
+	uint64_t version{ 0 };
+
+	// Indexed by image_index * MAX_FRAMES_IN_FLIGHT + frame_index. Only ever grows, buffers for images that no longer exist might still be pending.
+	std::vector<RecordedCommandBuffer> buffers{};
+};
+
+// The pool must allow command buffers to be reset individually.
+CommandRecordingCache create_command_recording_cache(VkDevice device, VkCommandPool pool, std::size_t image_count);
+void destroy_command_recording_cache(CommandRecordingCache& cache);
+
+void invalidate_recorded_commands(CommandRecordingCache& cache);
+
+// Also invalidates every recording, a new swapchain means new framebuffers.
+void resize_command_recording_cache(CommandRecordingCache& cache, std::size_t image_count);
+
+// out_needs_recording is set when the buffer is out of date, the caller must then record it before submitting.
+VkCommandBuffer get_recorded_commands(CommandRecordingCache& cache, std::size_t frame_index, std::size_t image_index, bool& out_needs_recording);
+
+// Command buffers for one-off work like uploads and layout transitions.
+// Rather than allocating and freeing a command buffer per upload, buffers are recycled once their fence has signalled.
+// Staging resources can be handed to a transient command buffer, they are released when it is recycled so uploads never need to stall the CPU.
+struct TransientCommandBuffer {
+	VkCommandBuffer command_buffer{ VK_NULL_HANDLE };
+	VkFence fence{ VK_NULL_HANDLE };
+	bool submitted{ false };
+	std::vector<VkBuffer> release_buffers{};
+	std::vector<VkDeviceMemory> release_memory{};
+};
+
+struct TransientCommandPool {
+	VkDevice device{ VK_NULL_HANDLE };
+	VkCommandPool pool{ VK_NULL_HANDLE };
+	VkQueue queue{ VK_NULL_HANDLE };
+
+	// A deque so references handed out by begin_transient_commands stay valid when the pool grows.
+	std::deque<TransientCommandBuffer> buffers{};
+};
+
+TransientCommandPool create_transient_command_pool(VkDevice device, std::size_t queue_family_index, VkQueue queue);
+void destroy_transient_command_pool(TransientCommandPool& transient_pool);
+
+TransientCommandBuffer& begin_transient_commands(TransientCommandPool& transient_pool);
+void release_after_completion(TransientCommandBuffer& transient_commands, VkBuffer buffer, VkDeviceMemory memory);
+void submit_transient_commands(TransientCommandPool& transient_pool, TransientCommandBuffer& transient_commands, bool wait_until_complete = false);
\ No newline at end of file
@@ -1,2 +1,5 @@
 #pragma once
-static constexpr std::size_t MAX_FRAMES_IN_FLIGHT = 2;
\ No newline at end of file
+
+// Per frame resources are created for the maximum number of frames in flight, so the number actually in use can be changed at runtime.
+static constexpr std::size_t MAX_FRAMES_IN_FLIGHT = 3;
+static constexpr std::size_t DEFAULT_FRAMES_IN_FLIGHT = 2;
\ No newline at end of file
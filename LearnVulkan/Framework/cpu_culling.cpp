@@ -0,0 +1,124 @@
+#include <cfloat>
+#include <algorithm>
+#include <bit>
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#include "cpu_culling.h"
+#include "cpu_profiler.h"
+
+// GCC and Clang only allow AVX intrinsics in functions built for it, MSVC allows them anywhere. Either way they are only called once AVX support has been checked.
+#if defined(__GNUC__) || defined(__clang__)
+#define AVX_FUNCTION __attribute__((target("avx")))
+#else
+#define AVX_FUNCTION
+#endif
+
+// Below this a range isn't worth handing to another thread.
+static constexpr std::size_t MIN_CULL_RANGE_SIZE = 16 * 1024;
+
+void resize_cull_bounds_table(CullBoundsTable& table, std::size_t count)
+{
+	std::size_t padded_count = (count + CULL_BATCH_SIZE - 1) / CULL_BATCH_SIZE * CULL_BATCH_SIZE;
+	table.centre_x.resize(padded_count, 0.0f);
+	table.centre_y.resize(padded_count, 0.0f);
+	table.centre_z.resize(padded_count, 0.0f);
+	table.radius.resize(padded_count, 0.0f);
+	table.count = count;
+
+	// A radius of -FLT_MAX is outside of every plane, so the padding is culled without the loop having to check for the end of the table.
+	std::fill(table.radius.begin() + count, table.radius.end(), -FLT_MAX);
+}
+
+static bool detect_simd_culling_support() {
+#ifdef _MSC_VER
+	int cpu_info[4]{};
+	__cpuid(cpu_info, 1);
+	bool has_avx = (cpu_info[2] & (1 << 28)) != 0;
+	bool has_os_xsave = (cpu_info[2] & (1 << 27)) != 0;
+
+	// The OS must also save the upper halves of the registers on a context switch.
+	return has_avx && has_os_xsave && (_xgetbv(0) & 0x6) == 0x6;
+#elif defined(__GNUC__) || defined(__clang__)
+	return __builtin_cpu_supports("avx");
+#else
+	return false;
+#endif
+}
+
+bool is_simd_culling_supported()
+{
+	static const bool supported = detect_simd_culling_support();
+	return supported;
+}
+
+static void cull_range_scalar(const CullBoundsTable& table, const FrustumPlanes& frustum_planes, std::size_t begin, std::size_t end, std::vector<uint32_t>& out_visible) {
+	for (std::size_t i = begin; i < end; ++i) {
+		if (is_sphere_in_frustum(frustum_planes, glm::vec3(table.centre_x[i], table.centre_y[i], table.centre_z[i]), table.radius[i])) {
+			out_visible.push_back(static_cast<uint32_t>(i));
+		}
+	}
+}
+
+AVX_FUNCTION static void cull_range_simd(const CullBoundsTable& table, const FrustumPlanes& frustum_planes, std::size_t begin, std::size_t end, std::vector<uint32_t>& out_visible) {
+	// Each plane component is broadcast to all 8 lanes once, rather than every batch.
+	__m256 plane_x[6], plane_y[6], plane_z[6], plane_w[6];
+	for (std::size_t p = 0; p < frustum_planes.size(); ++p) {
+		plane_x[p] = _mm256_set1_ps(frustum_planes[p].x);
+		plane_y[p] = _mm256_set1_ps(frustum_planes[p].y);
+		plane_z[p] = _mm256_set1_ps(frustum_planes[p].z);
+		plane_w[p] = _mm256_set1_ps(frustum_planes[p].w);
+	}
+
+	const __m256 zero = _mm256_setzero_ps();
+
+	// The table is padded, so end can be rounded up to a whole batch.
+	end = (end + CULL_BATCH_SIZE - 1) / CULL_BATCH_SIZE * CULL_BATCH_SIZE;
+	for (std::size_t i = begin; i < end; i += CULL_BATCH_SIZE) {
+		__m256 x = _mm256_loadu_ps(table.centre_x.data() + i);
+		__m256 y = _mm256_loadu_ps(table.centre_y.data() + i);
+		__m256 z = _mm256_loadu_ps(table.centre_z.data() + i);
+		__m256 negative_radius = _mm256_sub_ps(zero, _mm256_loadu_ps(table.radius.data() + i));
+
+		// A lane stays set while its sphere is on the inside of every plane tested so far.
+		__m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+		for (std::size_t p = 0; p < frustum_planes.size(); ++p) {
+			__m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(plane_x[p], x), _mm256_mul_ps(plane_y[p], y)), _mm256_add_ps(_mm256_mul_ps(plane_z[p], z), plane_w[p]));
+			inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, negative_radius, _CMP_GE_OQ));
+		}
+
+		// One bit per lane, visited lowest first so the indices stay in order.
+		unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(inside));
+		while (mask != 0) {
+			out_visible.push_back(static_cast<uint32_t>(i + std::countr_zero(mask)));
+			mask &= mask - 1;
+		}
+	}
+}
+
+void cull_bounds(const CullBoundsTable& table, const FrustumPlanes& frustum_planes, JobSystem& job_system, CullResults& results)
+{
+	PROFILE_FUNCTION();
+
+	bool use_simd = is_simd_culling_supported();
+	results.visible_by_range.resize(job_system.get_thread_count());
+
+	// Ranges are aligned to whole batches so no batch is split between two threads.
+	std::size_t range_count = job_system.parallel_for(table.count, MIN_CULL_RANGE_SIZE, CULL_BATCH_SIZE, [&](std::size_t begin, std::size_t end, std::size_t range_index) {
+		std::vector<uint32_t>& visible = results.visible_by_range[range_index];
+		visible.clear();
+
+		if (use_simd) {
+			cull_range_simd(table, frustum_planes, begin, end, visible);
+		}
+		else {
+			cull_range_scalar(table, frustum_planes, begin, end, visible);
+		}
+	});
+
+	results.visible.clear();
+	for (std::size_t i = 0; i < range_count; ++i) {
+		results.visible.insert(results.visible.end(), results.visible_by_range[i].begin(), results.visible_by_range[i].end());
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "frustum.h"
+#include "job_system.h"
+
+// Bounding spheres stored as a structure of arrays, so the culling loop can load the same component of 8 objects with one instruction
+// rather than gathering it from 8 separate structs.
+static constexpr std::size_t CULL_BATCH_SIZE = 8;
+
+struct CullBoundsTable {
+	// Padded to a multiple of CULL_BATCH_SIZE, the padding can never be visible.
+	std::vector<float> centre_x{};
+	std::vector<float> centre_y{};
+	std::vector<float> centre_z{};
+	std::vector<float> radius{};
+	std::size_t count{ 0 };
+};
+
+// Output of cull_bounds. Each range of the table fills its own list so threads never share a write, they are joined into visible afterwards.
+// Kept between frames so the lists don't have to be reallocated.
+struct CullResults {
+	std::vector<std::vector<uint32_t>> visible_by_range{};
+	std::vector<uint32_t> visible{};
+};
+
+void resize_cull_bounds_table(CullBoundsTable& table, std::size_t count);
+
+inline void set_cull_bounds(CullBoundsTable& table, std::size_t index, const glm::vec3& centre, float radius)
+{
+	table.centre_x[index] = centre.x;
+	table.centre_y[index] = centre.y;
+	table.centre_z[index] = centre.z;
+	table.radius[index] = radius;
+}
+
+// AVX is checked for once at runtime, otherwise a scalar loop is used.
+bool is_simd_culling_supported();
+
+// Fills results.visible with the indices of every sphere at least partly inside the frustum, in ascending order.
+void cull_bounds(const CullBoundsTable& table, const FrustumPlanes& frustum_planes, JobSystem& job_system, CullResults& results);
@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "cpu_profiler.h"
+#include "error.h"
+
+static_assert((CPU_PROFILER_EVENTS_PER_THREAD & (CPU_PROFILER_EVENTS_PER_THREAD - 1)) == 0, "The event rings are indexed with a mask.");
+
+std::atomic<bool> cpu_profiler_enabled{ false };
+
+// Written only by the owning thread. next_event is published after the event is written, so the exporter only reads finished events.
+struct ProfilerThread {
+	uint32_t thread_id{ 0 };
+	std::atomic<const char*> name{ nullptr };
+	std::atomic<uint64_t> next_event{ 0 };
+	std::unique_ptr<ProfileEvent[]> events{ std::make_unique<ProfileEvent[]>(CPU_PROFILER_EVENTS_PER_THREAD) };
+};
+
+// Threads are never removed, so the events of threads that have exited are still exported.
+static std::mutex registry_mutex{};
+static std::vector<std::unique_ptr<ProfilerThread>> registered_threads{};
+static ProfilerClock::time_point profiler_start{ ProfilerClock::now() };
+
+static thread_local ProfilerThread* current_thread = nullptr;
+static thread_local const char* pending_thread_name = nullptr;
+
+static ProfilerThread& get_current_thread() {
+	if (current_thread == nullptr) {
+		std::lock_guard lock(registry_mutex);
+		auto thread = std::make_unique<ProfilerThread>();
+		thread->thread_id = static_cast<uint32_t>(registered_threads.size() + 1);
+		thread->name.store(pending_thread_name, std::memory_order_relaxed);
+		current_thread = thread.get();
+		registered_threads.push_back(std::move(thread));
+	}
+
+	return *current_thread;
+}
+
+void enable_cpu_profiler()
+{
+	profiler_start = ProfilerClock::now();
+	cpu_profiler_enabled.store(true, std::memory_order_relaxed);
+}
+
+void set_profiler_thread_name(const char* name)
+{
+	// Threads that never record a zone aren't given a ring just to hold a name.
+	pending_thread_name = name;
+	if (current_thread != nullptr) {
+		current_thread->name.store(name, std::memory_order_relaxed);
+	}
+}
+
+void record_profile_event(const char* name, ProfilerClock::time_point begin, ProfilerClock::time_point end)
+{
+	ProfilerThread& thread = get_current_thread();
+	uint64_t index = thread.next_event.load(std::memory_order_relaxed);
+	thread.events[index & (CPU_PROFILER_EVENTS_PER_THREAD - 1)] = ProfileEvent{ name, begin, end };
+	thread.next_event.store(index + 1, std::memory_order_release);
+}
+
+static double get_trace_microseconds(ProfilerClock::time_point time) {
+	return std::chrono::duration<double, std::micro>(time - profiler_start).count();
+}
+
+bool write_chrome_trace(const char* file_path)
+{
+	std::ofstream file(file_path, std::ios::trunc);
+	if (!file.is_open()) {
+		log_error("Failed to open trace file ", file_path);
+		return false;
+	}
+
+	std::vector<ProfilerThread*> threads{};
+	{
+		std::lock_guard lock(registry_mutex);
+		for (const auto& thread : registered_threads) {
+			threads.push_back(thread.get());
+		}
+	}
+
+	// Complete ("X") events in microseconds, with a metadata event naming each thread.
+	file << std::fixed << std::setprecision(3);
+	file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+	bool first_event = true;
+	std::vector<ProfileEvent> events{};
+	for (ProfilerThread* thread : threads) {
+		const char* thread_name = thread->name.load(std::memory_order_relaxed);
+		if (thread_name != nullptr) {
+			file << (first_event ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->thread_id << ",\"args\":{\"name\":\"" << thread_name << "\"}}";
+			first_event = false;
+		}
+
+		uint64_t end_index = thread->next_event.load(std::memory_order_acquire);
+		uint64_t begin_index = end_index > CPU_PROFILER_EVENTS_PER_THREAD ? end_index - CPU_PROFILER_EVENTS_PER_THREAD : 0;
+		events.clear();
+		for (uint64_t i = begin_index; i < end_index; ++i) {
+			events.push_back(thread->events[i & (CPU_PROFILER_EVENTS_PER_THREAD - 1)]);
+		}
+
+		// The owner keeps recording during the copy. Any event whose slot has been written to since may be torn, so those are dropped.
+		uint64_t written_index = thread->next_event.load(std::memory_order_acquire);
+		uint64_t first_intact = written_index + 1 > CPU_PROFILER_EVENTS_PER_THREAD ? written_index + 1 - CPU_PROFILER_EVENTS_PER_THREAD : 0;
+		std::size_t skipped = static_cast<std::size_t>(std::min<uint64_t>(std::max(first_intact, begin_index) - begin_index, events.size()));
+
+		for (std::size_t i = skipped; i < events.size(); ++i) {
+			const ProfileEvent& event = events[i];
+			file << (first_event ? "" : ",\n") << "{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->thread_id
+				<< ",\"ts\":" << get_trace_microseconds(event.begin) << ",\"dur\":" << std::chrono::duration<double, std::micro>(event.end - event.begin).count() << "}";
+			first_event = false;
+		}
+	}
+
+	file << "\n]}\n";
+	return true;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <chrono>
+
+// Scoped zones timing where CPU time goes, on every thread, exported as a Chrome trace (chrome://tracing or ui.perfetto.dev).
+// Each thread records finished zones into its own ring of events, so recording a zone takes no locks and touches no memory shared with other threads.
+// Only the first zone a thread records takes a lock, to register its ring. Rings keep the newest CPU_PROFILER_EVENTS_PER_THREAD zones.
+//
+// The profiler starts disabled, zones then cost a relaxed load. Defining DISABLE_CPU_PROFILER compiles the zones out entirely.
+
+static constexpr std::size_t CPU_PROFILER_EVENTS_PER_THREAD = 1 << 16;
+
+using ProfilerClock = std::chrono::steady_clock;
+
+struct ProfileEvent {
+	// Zone names must be string literals, only the pointer is kept.
+	const char* name{ nullptr };
+	ProfilerClock::time_point begin{};
+	ProfilerClock::time_point end{};
+};
+
+extern std::atomic<bool> cpu_profiler_enabled;
+
+void enable_cpu_profiler();
+
+// Shown as the thread's name in the trace. The name must be a string literal.
+void set_profiler_thread_name(const char* name);
+
+void record_profile_event(const char* name, ProfilerClock::time_point begin, ProfilerClock::time_point end);
+
+// Can be called while other threads are still recording, zones they overwrite during the export are left out.
+bool write_chrome_trace(const char* file_path);
+
+class ProfileZone {
+public:
+	explicit ProfileZone(const char* name) : name(name) {
+		if (cpu_profiler_enabled.load(std::memory_order_relaxed)) {
+			begin = ProfilerClock::now();
+			active = true;
+		}
+	}
+
+	~ProfileZone() {
+		if (active) {
+			record_profile_event(name, begin, ProfilerClock::now());
+		}
+	}
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+	const char* name{ nullptr };
+	ProfilerClock::time_point begin{};
+	bool active{ false };
+};
+
+#define PROFILE_CONCATENATE_INNER(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_INNER(a, b)
+
+#ifdef DISABLE_CPU_PROFILER
+#define PROFILE_ZONE(name)
+#define PROFILE_FUNCTION()
+#else
+// Times from here to the end of the enclosing scope.
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCATENATE(profile_zone_, __LINE__){ name }
+#define PROFILE_FUNCTION() PROFILE_ZONE(__func__)
+#endif
@@ -0,0 +1,77 @@
+#include "deletion_queue.h"
+#include "error.h"
+#include "memory_stats.h"
+
+DeletionQueue create_deletion_queue(VkDevice device)
+{
+	DeletionQueue deletion_queue{};
+	deletion_queue.device = device;
+	return deletion_queue;
+}
+
+static void destroy_pending(VkDevice device, const PendingDestruction& pending) {
+	switch (pending.type) {
+	case VK_OBJECT_TYPE_UNKNOWN:
+		break;
+	case VK_OBJECT_TYPE_BUFFER:
+		vkDestroyBuffer(device, (VkBuffer)pending.handle, nullptr);
+		break;
+	case VK_OBJECT_TYPE_IMAGE:
+		vkDestroyImage(device, (VkImage)pending.handle, nullptr);
+		break;
+	case VK_OBJECT_TYPE_IMAGE_VIEW:
+		vkDestroyImageView(device, (VkImageView)pending.handle, nullptr);
+		break;
+	case VK_OBJECT_TYPE_SAMPLER:
+		vkDestroySampler(device, (VkSampler)pending.handle, nullptr);
+		break;
+	case VK_OBJECT_TYPE_FRAMEBUFFER:
+		vkDestroyFramebuffer(device, (VkFramebuffer)pending.handle, nullptr);
+		break;
+	case VK_OBJECT_TYPE_PIPELINE:
+		vkDestroyPipeline(device, (VkPipeline)pending.handle, nullptr);
+		break;
+	case VK_OBJECT_TYPE_SWAPCHAIN_KHR:
+		vkDestroySwapchainKHR(device, (VkSwapchainKHR)pending.handle, nullptr);
+		break;
+	default:
+		log_error("Deferred destruction isn't supported for object type ", pending.type);
+		break;
+	}
+
+	// The memory is freed after the handle bound to it.
+	free_device_memory(device, pending.memory);
+}
+
+static void destroy_frame(VkDevice device, std::vector<PendingDestruction>& pending_destructions) {
+	for (const PendingDestruction& pending : pending_destructions) {
+		destroy_pending(device, pending);
+	}
+
+	pending_destructions.clear();
+}
+
+void destroy_deletion_queue(DeletionQueue& deletion_queue)
+{
+	flush_deletion_queue(deletion_queue);
+	deletion_queue = DeletionQueue{};
+}
+
+void flush_deletion_queue(DeletionQueue& deletion_queue)
+{
+	for (std::vector<PendingDestruction>& pending_destructions : deletion_queue.pending_by_frame) {
+		destroy_frame(deletion_queue.device, pending_destructions);
+	}
+}
+
+void begin_deletion_frame(DeletionQueue& deletion_queue, std::size_t frame_index)
+{
+	// Anything queued the last time this frame was recorded can only be referenced by submissions up to and including that frame, which the fence for this frame guarantees have completed.
+	deletion_queue.current_frame = frame_index;
+	destroy_frame(deletion_queue.device, deletion_queue.pending_by_frame[frame_index]);
+}
+
+void defer_destruction(DeletionQueue& deletion_queue, VkObjectType type, uint64_t handle, VkDeviceMemory memory)
+{
+	deletion_queue.pending_by_frame[deletion_queue.current_frame].push_back({ type, handle, memory });
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <utility>
+#include "constants.h"
+
+// A resource can't be destroyed while a frame in flight might still be using it. Rather than idling the device, destruction is queued against the frame being recorded
+// and carried out the next time that frame's fence has been waited on. By then every frame submitted before it has also completed.
+
+struct PendingDestruction {
+	VkObjectType type{ VK_OBJECT_TYPE_UNKNOWN };
+	uint64_t handle{ 0 };
+
+	// Buffers and images with a dedicated allocation free it along with the handle.
+	VkDeviceMemory memory{ VK_NULL_HANDLE };
+};
+
+struct DeletionQueue {
+	VkDevice device{ VK_NULL_HANDLE };
+	std::size_t current_frame{ 0 };
+	std::array<std::vector<PendingDestruction>, MAX_FRAMES_IN_FLIGHT> pending_by_frame{};
+};
+
+DeletionQueue create_deletion_queue(VkDevice device);
+
+// Destroys everything that is still queued, the device must be idle.
+void destroy_deletion_queue(DeletionQueue& deletion_queue);
+
+// Destroys everything that is queued for every frame, all submitted frames must have completed. Used when the number of frames in flight changes.
+void flush_deletion_queue(DeletionQueue& deletion_queue);
+
+// Should be called once the frame's in flight fence has been waited on, before anything is recorded for it.
+void begin_deletion_frame(DeletionQueue& deletion_queue, std::size_t frame_index);
+
+void defer_destruction(DeletionQueue& deletion_queue, VkObjectType type, uint64_t handle, VkDeviceMemory memory = VK_NULL_HANDLE);
+
+// Owns a handle and queues it for destruction when it goes out of scope or is replaced.
+// The object type is given explicitly because non-dispatchable handles are all uint64_t on 32 bit platforms.
+template<typename Handle, VkObjectType Type>
+class DeferredHandle {
+public:
+	DeferredHandle() = default;
+
+	DeferredHandle(DeletionQueue& deletion_queue, Handle handle, VkDeviceMemory memory = VK_NULL_HANDLE)
+		: deletion_queue(&deletion_queue), handle(handle), memory(memory) {}
+
+	DeferredHandle(const DeferredHandle&) = delete;
+	DeferredHandle& operator=(const DeferredHandle&) = delete;
+
+	DeferredHandle(DeferredHandle&& other) noexcept
+		: deletion_queue(other.deletion_queue), handle(std::exchange(other.handle, VK_NULL_HANDLE)), memory(std::exchange(other.memory, VK_NULL_HANDLE)) {}
+
+	DeferredHandle& operator=(DeferredHandle&& other) noexcept {
+		if (this != &other) {
+			reset();
+			deletion_queue = other.deletion_queue;
+			handle = std::exchange(other.handle, VK_NULL_HANDLE);
+			memory = std::exchange(other.memory, VK_NULL_HANDLE);
+		}
+
+		return *this;
+	}
+
+	~DeferredHandle() {
+		reset();
+	}
+
+	Handle get() const { return handle; }
+	VkDeviceMemory get_memory() const { return memory; }
+
+	void reset() {
+		if (handle != VK_NULL_HANDLE || memory != VK_NULL_HANDLE) {
+			defer_destruction(*deletion_queue, Type, (uint64_t)handle, memory);
+		}
+
+		handle = VK_NULL_HANDLE;
+		memory = VK_NULL_HANDLE;
+	}
+
+	// Gives up ownership without destroying anything.
+	Handle release() {
+		memory = VK_NULL_HANDLE;
+		return std::exchange(handle, VK_NULL_HANDLE);
+	}
+
+private:
+	DeletionQueue* deletion_queue{ nullptr };
+	Handle handle{ VK_NULL_HANDLE };
+	VkDeviceMemory memory{ VK_NULL_HANDLE };
+};
+
+using UniqueBuffer = DeferredHandle<VkBuffer, VK_OBJECT_TYPE_BUFFER>;
+using UniqueImage = DeferredHandle<VkImage, VK_OBJECT_TYPE_IMAGE>;
+using UniqueImageView = DeferredHandle<VkImageView, VK_OBJECT_TYPE_IMAGE_VIEW>;
+using UniqueSampler = DeferredHandle<VkSampler, VK_OBJECT_TYPE_SAMPLER>;
+using UniqueFramebuffer = DeferredHandle<VkFramebuffer, VK_OBJECT_TYPE_FRAMEBUFFER>;
+using UniquePipeline = DeferredHandle<VkPipeline, VK_OBJECT_TYPE_PIPELINE>;
+using UniqueSwapchain = DeferredHandle<VkSwapchainKHR, VK_OBJECT_TYPE_SWAPCHAIN_KHR>;
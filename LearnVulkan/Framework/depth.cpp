@@ -2,8 +2,10 @@
 #include <span>
 #include <optional>
 #include "depth.h"
+#include "cpu_profiler.h"
 #include "error.h"
 #include "buffer.h"
+#include "memory_stats.h"
 
 
 static std::optional<VkFormat> find_supported_format(VkPhysicalDevice physical_device,std::span<VkFormat> formats, VkImageTiling tiling, VkFormatFeatureFlags feature_flags) {
@@ -27,16 +29,18 @@ static bool has_stencil_component(VkFormat format) {
 	return format == VK_FORMAT_D32_SFLOAT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
-DepthBuffer create_depth_buffer(VkDevice device, VkPhysicalDevice physical_device, uint32_t width, uint32_t height)
+DepthBuffer create_depth_buffer(VkDevice device, VkPhysicalDevice physical_device, DeletionQueue& deletion_queue, uint32_t width, uint32_t height)
 {
+	PROFILE_FUNCTION();
+
 	DepthBuffer depth_buffer{};
+	MemoryTagScope tag_scope{ MemoryTag::Depth };
 	std::array<VkFormat, 3> formats{ VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT };
 	depth_buffer.format = find_supported_format(physical_device, formats, VK_IMAGE_TILING_OPTIMAL, VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT).value();
 
 	auto [image, memory] = create_image(device, physical_device, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depth_buffer.format, VK_IMAGE_TILING_OPTIMAL, width, height);
-	depth_buffer.image = image;
-	depth_buffer.memory = memory;
-	depth_buffer.view = create_image_view(device, depth_buffer.image, depth_buffer.format, VK_IMAGE_ASPECT_DEPTH_BIT);
+	depth_buffer.image = UniqueImage{ deletion_queue, image, memory };
+	depth_buffer.view = UniqueImageView{ deletion_queue, create_image_view(device, image, depth_buffer.format, VK_IMAGE_ASPECT_DEPTH_BIT) };
 
 	// Note that we don't transition the actual layout of the underlying image here, just the way it is interpreted from the image view. 
 	// The layout of the image can be transitioned to depth-stencil attachment optimal from the render pass. 
@@ -1,11 +1,11 @@
 #pragma once
 #include <vulkan/vulkan.h>
+#include "deletion_queue.h"
 
 struct DepthBuffer {
-	VkImage image;
-	VkDeviceMemory memory;
-	VkImageView view;
+	UniqueImage image;
+	UniqueImageView view;
 	VkFormat format;
 };
 
-DepthBuffer create_depth_buffer(VkDevice device, VkPhysicalDevice physical_device, uint32_t width, uint32_t height);
\ No newline at end of file
+DepthBuffer create_depth_buffer(VkDevice device, VkPhysicalDevice physical_device, DeletionQueue& deletion_queue, uint32_t width, uint32_t height);
\ No newline at end of file
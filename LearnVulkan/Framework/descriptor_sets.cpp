@@ -90,4 +90,21 @@ FrameDescriptorSets create_frame_descriptor_sets(VkDevice device, VkDescriptorPo
 	return frame_descriptor_sets;
 }
 
-
+void write_texture_descriptor(VkDevice device, VkDescriptorSet descriptor_set, VkImageView texture, VkSampler texture_sampler)
+{
+	VkDescriptorImageInfo image_info{};
+	image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	image_info.imageView = texture;
+	image_info.sampler = texture_sampler;
+
+	VkWriteDescriptorSet writer{};
+	writer.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	writer.dstSet = descriptor_set;
+	writer.dstBinding = 1;
+	writer.dstArrayElement = 0;
+	writer.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	writer.descriptorCount = 1;
+	writer.pImageInfo = &image_info;
+
+	vkUpdateDescriptorSets(device, 1, &writer, 0, nullptr);
+}
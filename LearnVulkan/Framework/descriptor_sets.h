@@ -31,4 +31,7 @@ void create_descriptor_sets(VkDevice device, VkDescriptorPool pool, VkDescriptor
 	create_descriptor_sets(device, pool, layouts, out_descriptor_sets);
 }
 
-FrameDescriptorSets create_frame_descriptor_sets(VkDevice device, VkDescriptorPool pool, VkDescriptorSetLayout descriptor_set_layout, const FrameUniformBuffers& uniform_buffers, VkImageView texture, VkSampler texture_sampler);
\ No newline at end of file
+FrameDescriptorSets create_frame_descriptor_sets(VkDevice device, VkDescriptorPool pool, VkDescriptorSetLayout descriptor_set_layout, const FrameUniformBuffers& uniform_buffers, VkImageView texture, VkSampler texture_sampler);
+
+// Points the set at a new texture view. The set must not be in use by any pending command buffer.
+void write_texture_descriptor(VkDevice device, VkDescriptorSet descriptor_set, VkImageView texture, VkSampler texture_sampler);
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <algorithm>
 #include "device.h"
+#include "cpu_profiler.h"
 #include "error.h"
 
 #ifdef NDEBUG
@@ -7,8 +8,10 @@
 extern std::array<const char*, 1> required_validation_layers;
 #endif
 
-VkDevice create_device(VkPhysicalDevice physical_device, const QueueFamilyIndexByFeature& queue_family_index_by_feature, QueueByFeature& out_queue_by_feature)
+VkDevice create_device(VkPhysicalDevice physical_device, const QueueFamilyIndexByFeature& queue_family_index_by_feature, std::span<const char* const> extensions, const VkPhysicalDeviceFeatures& features, QueueByFeature& out_queue_by_feature)
 {
+	PROFILE_FUNCTION();
+
 	std::array<std::size_t, FEATURE_COUNT> unique_indecies = queue_family_index_by_feature;
 	std::sort(unique_indecies.begin(), unique_indecies.end());
 	auto end = std::unique(unique_indecies.begin(), unique_indecies.end());
@@ -36,10 +39,10 @@ VkDevice create_device(VkPhysicalDevice physical_device, const QueueFamilyIndexB
 	device_create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
 	device_create_info.queueCreateInfoCount = queue_family_create_infos.size();
 	device_create_info.pQueueCreateInfos = queue_family_create_infos.data();
-	device_create_info.enabledExtensionCount = static_cast<uint32_t>(required_device_extensions.size());
-	device_create_info.ppEnabledExtensionNames = required_device_extensions.data();
+	device_create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+	device_create_info.ppEnabledExtensionNames = extensions.data();
 	device_create_info.flags = 0;
-	device_create_info.pEnabledFeatures = nullptr;
+	device_create_info.pEnabledFeatures = &features;
 	device_create_info.pNext = nullptr;
 
 
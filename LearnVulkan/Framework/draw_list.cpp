@@ -0,0 +1,103 @@
+#include <array>
+#include <algorithm>
+#include "draw_list.h"
+#include "cpu_profiler.h"
+
+static constexpr uint32_t PASS_BITS = 4;
+static constexpr uint32_t PIPELINE_BITS = 12;
+static constexpr uint32_t MATERIAL_BITS = 16;
+static constexpr uint32_t MESH_BITS = 16;
+static constexpr uint32_t DEPTH_BITS = 16;
+static_assert(PASS_BITS + PIPELINE_BITS + MATERIAL_BITS + MESH_BITS + DEPTH_BITS == 64);
+
+// The keys are sorted a byte at a time, least significant first.
+static constexpr uint32_t RADIX_BITS = 8;
+static constexpr std::size_t RADIX_SIZE = 1 << RADIX_BITS;
+static constexpr std::size_t RADIX_PASS_COUNT = 64 / RADIX_BITS;
+
+static uint64_t get_key_field(uint32_t value, uint32_t bits) {
+	return value & ((uint64_t{ 1 } << bits) - 1);
+}
+
+uint64_t make_draw_sort_key(DrawPass pass, uint32_t pipeline_index, uint32_t material_index, uint32_t mesh_index, float depth)
+{
+	uint32_t depth_bucket = static_cast<uint32_t>(std::clamp(depth, 0.0f, 1.0f) * ((1 << DEPTH_BITS) - 1));
+	uint64_t key = get_key_field(static_cast<uint32_t>(pass), PASS_BITS);
+
+	if (pass == DrawPass::Transparent) {
+		key = (key << DEPTH_BITS) | get_key_field(~depth_bucket, DEPTH_BITS);
+		key = (key << PIPELINE_BITS) | get_key_field(pipeline_index, PIPELINE_BITS);
+		key = (key << MATERIAL_BITS) | get_key_field(material_index, MATERIAL_BITS);
+		key = (key << MESH_BITS) | get_key_field(mesh_index, MESH_BITS);
+		return key;
+	}
+
+	key = (key << PIPELINE_BITS) | get_key_field(pipeline_index, PIPELINE_BITS);
+	key = (key << MATERIAL_BITS) | get_key_field(material_index, MATERIAL_BITS);
+	key = (key << MESH_BITS) | get_key_field(mesh_index, MESH_BITS);
+	key = (key << DEPTH_BITS) | get_key_field(depth_bucket, DEPTH_BITS);
+	return key;
+}
+
+void radix_sort_draw_keys(std::vector<DrawSortEntry>& entries, std::vector<DrawSortEntry>& scratch)
+{
+	// Every byte is counted in a single read of the keys.
+	std::array<std::array<uint32_t, RADIX_SIZE>, RADIX_PASS_COUNT> counts_by_pass{};
+	for (const DrawSortEntry& entry : entries) {
+		for (std::size_t pass = 0; pass < RADIX_PASS_COUNT; ++pass) {
+			++counts_by_pass[pass][(entry.key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)];
+		}
+	}
+
+	scratch.resize(entries.size());
+	for (std::size_t pass = 0; pass < RADIX_PASS_COUNT; ++pass) {
+		const std::array<uint32_t, RADIX_SIZE>& counts = counts_by_pass[pass];
+
+		// Most fields hold the same value in every key, pass and pipeline especially. A byte that is the same everywhere wouldn't move anything.
+		if (std::find(counts.begin(), counts.end(), static_cast<uint32_t>(entries.size())) != counts.end()) {
+			continue;
+		}
+
+		std::array<uint32_t, RADIX_SIZE> offsets{};
+		uint32_t offset = 0;
+		for (std::size_t digit = 0; digit < RADIX_SIZE; ++digit) {
+			offsets[digit] = offset;
+			offset += counts[digit];
+		}
+
+		for (const DrawSortEntry& entry : entries) {
+			scratch[offsets[(entry.key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)]++] = entry;
+		}
+
+		entries.swap(scratch);
+	}
+}
+
+bool sort_draw_list(DrawListSorter& sorter, std::vector<DrawItem>& draws)
+{
+	PROFILE_FUNCTION();
+
+	sorter.entries.resize(draws.size());
+	for (std::size_t i = 0; i < draws.size(); ++i) {
+		sorter.entries[i] = DrawSortEntry{ draws[i].sort_key, static_cast<uint32_t>(i) };
+	}
+
+	radix_sort_draw_keys(sorter.entries, sorter.scratch);
+
+	bool order_changed = false;
+	for (std::size_t i = 0; i < sorter.entries.size() && !order_changed; ++i) {
+		order_changed = sorter.entries[i].draw_index != i;
+	}
+
+	if (!order_changed) {
+		return false;
+	}
+
+	sorter.sorted_draws.clear();
+	for (const DrawSortEntry& entry : sorter.entries) {
+		sorter.sorted_draws.push_back(draws[entry.draw_index]);
+	}
+
+	draws.swap(sorter.sorted_draws);
+	return true;
+}
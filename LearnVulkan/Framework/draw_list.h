@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "mesh_pool.h"
+#include "render_pipeline.h"
+
+// Every draw carries a 64 bit key, and the draw list is sorted by it before recording so draws sharing state end up next to each other and
+// the recording can skip binds that wouldn't change anything. From the most significant bits down the key holds:
+//
+//   pass (4 bits) | pipeline (12 bits) | material (16 bits) | mesh (16 bits) | depth (16 bits)
+//
+// Opaque draws with the same state are ordered front to back, so nearer surfaces fill the depth buffer first and hidden fragments are rejected before shading.
+// Transparent draws have to blend back to front whatever their state, so for them the depth moves up to just below the pass, inverted.
+
+enum class DrawPass : uint8_t {
+	Opaque,
+	Transparent,
+};
+
+struct DrawItem {
+	MeshRange mesh{};
+	ObjectPushConstants object_constants{};
+
+	// Instanced draws take their instances, and how many there are, from the instance buffer.
+	bool instanced{ false };
+
+	// Index into the pipelines the draw list is recorded with. Every pipeline must use the same layout.
+	uint32_t pipeline_index{ 0 };
+
+	uint64_t sort_key{ 0 };
+};
+
+// depth is the distance to the camera divided by the far plane distance, it is clamped to [0, 1]. The ids are truncated to the width of their field.
+uint64_t make_draw_sort_key(DrawPass pass, uint32_t pipeline_index, uint32_t material_index, uint32_t mesh_index, float depth);
+
+struct DrawSortEntry {
+	uint64_t key{ 0 };
+	uint32_t draw_index{ 0 };
+};
+
+// Sorts by key, keeping the order of equal keys. scratch is only used to avoid allocating each time.
+void radix_sort_draw_keys(std::vector<DrawSortEntry>& entries, std::vector<DrawSortEntry>& scratch);
+
+// Kept between frames so sorting doesn't allocate.
+struct DrawListSorter {
+	std::vector<DrawSortEntry> entries{};
+	std::vector<DrawSortEntry> scratch{};
+	std::vector<DrawItem> sorted_draws{};
+};
+
+// Orders the draws by their sort keys. Returns true if the order changed, in which case commands recorded from the list are out of date.
+bool sort_draw_list(DrawListSorter& sorter, std::vector<DrawItem>& draws);
@@ -0,0 +1,172 @@
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <cmath>
+#include <span>
+#include "frame_benchmark.h"
+#include "error.h"
+
+struct SampleSummary {
+	double mean{ 0.0 };
+	double p50{ 0.0 };
+	double p95{ 0.0 };
+	double p99{ 0.0 };
+	double max{ 0.0 };
+	double standard_deviation{ 0.0 };
+};
+
+const char* get_frame_stage_name(FrameStage stage)
+{
+	switch (stage) {
+	case FrameStage::Poll: return "poll";
+	case FrameStage::Update: return "update";
+	case FrameStage::FenceWait: return "fence_wait";
+	case FrameStage::Acquire: return "acquire";
+	case FrameStage::Record: return "record";
+	case FrameStage::Submit: return "submit";
+	case FrameStage::Present: return "present";
+	default: return "unknown";
+	}
+}
+
+FrameBenchmark create_frame_benchmark(uint32_t warmup_frame_count, uint32_t measured_frame_count)
+{
+	FrameBenchmark benchmark{};
+	benchmark.enabled = measured_frame_count > 0;
+	benchmark.warmup_frame_count = warmup_frame_count;
+	benchmark.measured_frame_count = measured_frame_count;
+	for (std::vector<float>& samples : benchmark.samples) {
+		samples.reserve(measured_frame_count);
+	}
+
+	return benchmark;
+}
+
+void begin_benchmark_frame(FrameBenchmark& benchmark)
+{
+	if (!benchmark.enabled) {
+		return;
+	}
+
+	benchmark.frame_start = FrameClock::now();
+	benchmark.last_mark = benchmark.frame_start;
+	benchmark.current_frame.fill(0.0);
+}
+
+void mark_frame_stage(FrameBenchmark& benchmark, FrameStage stage)
+{
+	if (!benchmark.enabled) {
+		return;
+	}
+
+	FrameClock::time_point now = FrameClock::now();
+	benchmark.current_frame[static_cast<std::size_t>(stage)] += std::chrono::duration<double, std::milli>(now - benchmark.last_mark).count();
+	benchmark.last_mark = now;
+}
+
+void end_benchmark_frame(FrameBenchmark& benchmark)
+{
+	if (!benchmark.enabled || is_frame_benchmark_done(benchmark)) {
+		return;
+	}
+
+	if (benchmark.finished_frame_count++ < benchmark.warmup_frame_count) {
+		return;
+	}
+
+	for (std::size_t i = 0; i < FRAME_STAGE_COUNT; ++i) {
+		benchmark.samples[i].push_back(static_cast<float>(benchmark.current_frame[i]));
+	}
+
+	benchmark.samples[FRAME_STAGE_COUNT].push_back(static_cast<float>(std::chrono::duration<double, std::milli>(benchmark.last_mark - benchmark.frame_start).count()));
+}
+
+bool is_frame_benchmark_done(const FrameBenchmark& benchmark)
+{
+	return benchmark.enabled && benchmark.finished_frame_count >= benchmark.warmup_frame_count + benchmark.measured_frame_count;
+}
+
+// Nearest rank, so every percentile is a frame time that actually happened.
+static double get_percentile(std::span<const float> sorted_samples, double percentile) {
+	std::size_t rank = static_cast<std::size_t>(std::ceil(percentile / 100.0 * sorted_samples.size()));
+	return sorted_samples[std::clamp<std::size_t>(rank, 1, sorted_samples.size()) - 1];
+}
+
+static SampleSummary summarise_samples(std::span<const float> samples) {
+	SampleSummary summary{};
+	if (samples.empty()) {
+		return summary;
+	}
+
+	std::vector<float> sorted_samples(samples.begin(), samples.end());
+	std::sort(sorted_samples.begin(), sorted_samples.end());
+
+	double sum = 0.0;
+	for (float sample : sorted_samples) {
+		sum += sample;
+	}
+
+	summary.mean = sum / sorted_samples.size();
+
+	double squared_deviation_sum = 0.0;
+	for (float sample : sorted_samples) {
+		squared_deviation_sum += (sample - summary.mean) * (sample - summary.mean);
+	}
+
+	summary.standard_deviation = std::sqrt(squared_deviation_sum / sorted_samples.size());
+	summary.p50 = get_percentile(sorted_samples, 50.0);
+	summary.p95 = get_percentile(sorted_samples, 95.0);
+	summary.p99 = get_percentile(sorted_samples, 99.0);
+	summary.max = sorted_samples.back();
+	return summary;
+}
+
+static void write_summary(std::ostream& out, const SampleSummary& summary) {
+	out << "{ \"mean\": " << summary.mean
+		<< ", \"p50\": " << summary.p50
+		<< ", \"p95\": " << summary.p95
+		<< ", \"p99\": " << summary.p99
+		<< ", \"max\": " << summary.max
+		<< ", \"standard_deviation\": " << summary.standard_deviation << " }";
+}
+
+std::string get_frame_benchmark_report(const FrameBenchmark& benchmark, const FrameSettings& frame_settings, const char* device_name)
+{
+	std::ostringstream out;
+	out << "{\n";
+	out << "\t\"device\": \"" << device_name << "\",\n";
+	out << "\t\"headless\": " << (frame_settings.headless ? "true" : "false") << ",\n";
+	out << "\t\"width\": " << frame_settings.width << ",\n";
+	out << "\t\"height\": " << frame_settings.height << ",\n";
+	out << "\t\"instances\": " << frame_settings.instance_count << ",\n";
+	out << "\t\"frames_in_flight\": " << frame_settings.frames_in_flight << ",\n";
+	out << "\t\"warmup_frames\": " << benchmark.warmup_frame_count << ",\n";
+	out << "\t\"measured_frames\": " << benchmark.samples[FRAME_STAGE_COUNT].size() << ",\n";
+
+	// All times are in milliseconds.
+	out << "\t\"frame\": ";
+	write_summary(out, summarise_samples(benchmark.samples[FRAME_STAGE_COUNT]));
+	out << ",\n";
+
+	out << "\t\"stages\": {\n";
+	for (std::size_t i = 0; i < FRAME_STAGE_COUNT; ++i) {
+		out << "\t\t\"" << get_frame_stage_name(static_cast<FrameStage>(i)) << "\": ";
+		write_summary(out, summarise_samples(benchmark.samples[i]));
+		out << (i + 1 < FRAME_STAGE_COUNT ? ",\n" : "\n");
+	}
+	out << "\t}\n";
+	out << "}\n";
+	return out.str();
+}
+
+bool write_frame_benchmark_report(const char* file_path, const FrameBenchmark& benchmark, const FrameSettings& frame_settings, const char* device_name)
+{
+	std::ofstream file(file_path, std::ios::trunc);
+	if (!file.is_open()) {
+		log_error("Failed to open frame benchmark report file ", file_path);
+		return false;
+	}
+
+	file << get_frame_benchmark_report(benchmark, frame_settings, device_name);
+	return true;
+}
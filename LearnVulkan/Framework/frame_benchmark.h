@@ -0,0 +1,59 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <string>
+#include "frame_latency.h"
+#include "frame_settings.h"
+
+// Times the CPU side of a fixed number of frames, split into the stages of the frame loop, after a number of warm-up frames that are not recorded.
+// Each stage is the time since the previous mark, so the stages of a frame add up to the whole frame. A stage marked more than once in a frame accumulates.
+// The report is JSON, so runs of different builds can be compared by a script.
+
+enum class FrameStage : uint8_t {
+	Poll, // Frame pacing, polling the window and handling input.
+	Update, // Everything written for the frame on the CPU: snapshots, uniforms, culling and the draw list.
+	FenceWait,
+	Acquire,
+	Record,
+	Submit,
+	Present,
+	Count,
+};
+
+static constexpr std::size_t FRAME_STAGE_COUNT = static_cast<std::size_t>(FrameStage::Count);
+
+const char* get_frame_stage_name(FrameStage stage);
+
+struct FrameBenchmark {
+	bool enabled{ false };
+	uint32_t warmup_frame_count{ 0 };
+	uint32_t measured_frame_count{ 0 };
+
+	// Frames finished so far, warm-up included.
+	uint32_t finished_frame_count{ 0 };
+
+	FrameClock::time_point frame_start{};
+	FrameClock::time_point last_mark{};
+	std::array<double, FRAME_STAGE_COUNT> current_frame{};
+
+	// Milliseconds per measured frame for every stage, followed by the whole frame. Reserved up front so recording a frame never allocates.
+	std::array<std::vector<float>, FRAME_STAGE_COUNT + 1> samples{};
+};
+
+// A benchmark with no measured frames is disabled, and every call on it returns straight away.
+FrameBenchmark create_frame_benchmark(uint32_t warmup_frame_count, uint32_t measured_frame_count);
+
+void begin_benchmark_frame(FrameBenchmark& benchmark);
+
+// Adds the time since the last mark, or the start of the frame, to the stage.
+void mark_frame_stage(FrameBenchmark& benchmark, FrameStage stage);
+
+// A frame that is begun but never ended, because it was abandoned part way, isn't counted.
+void end_benchmark_frame(FrameBenchmark& benchmark);
+
+bool is_frame_benchmark_done(const FrameBenchmark& benchmark);
+
+// Mean, p50, p95, p99, max and standard deviation of each stage and of the whole frame, along with the settings the run used.
+std::string get_frame_benchmark_report(const FrameBenchmark& benchmark, const FrameSettings& frame_settings, const char* device_name);
+bool write_frame_benchmark_report(const char* file_path, const FrameBenchmark& benchmark, const FrameSettings& frame_settings, const char* device_name);
@@ -0,0 +1,84 @@
+#include <thread>
+#include <algorithm>
+#include "frame_latency.h"
+#include "cpu_profiler.h"
+
+// Weight given to the newest sample in the moving averages.
+static constexpr double AVERAGE_WEIGHT = 0.1;
+
+// Only part of the measured error is corrected each frame, so a single hitch doesn't make the delay jump.
+static constexpr double START_DELAY_GAIN = 0.25;
+
+// Upper bound on the start delay when no frame rate target is set.
+static constexpr FrameClock::duration MAX_START_DELAY = std::chrono::milliseconds(50);
+
+FrameLatencyController create_frame_latency_controller(bool enabled, double target_frames_per_second)
+{
+	FrameLatencyController controller{};
+	controller.enabled = enabled;
+
+	if (target_frames_per_second > 0.0) {
+		controller.target_frame_time = std::chrono::duration_cast<FrameClock::duration>(std::chrono::duration<double>(1.0 / target_frames_per_second));
+	}
+
+	controller.frame_start = FrameClock::now();
+	controller.input_sampled = controller.frame_start;
+	controller.input_sampled_by_frame.fill(controller.frame_start);
+	return controller;
+}
+
+void wait_for_frame_start(FrameLatencyController& controller)
+{
+	FrameClock::time_point now = FrameClock::now();
+	FrameClock::time_point start = now;
+
+	// Pacing is measured from when the previous frame was scheduled to start rather than when the sleep returned, so oversleeping doesn't lower the frame rate.
+	if (controller.target_frame_time > FrameClock::duration::zero()) {
+		start = std::max(start, controller.frame_start + controller.target_frame_time);
+	}
+
+	if (controller.enabled) {
+		start = std::max(start, now + controller.start_delay);
+	}
+
+	if (start > now) {
+		std::this_thread::sleep_until(start);
+	}
+
+	controller.frame_start = start;
+}
+
+void record_input_sampled(FrameLatencyController& controller)
+{
+	controller.input_sampled = FrameClock::now();
+}
+
+static double to_milliseconds(FrameClock::duration duration) {
+	return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+void wait_for_frame_fence(FrameLatencyController& controller, VkDevice device, VkFence fence, std::size_t frame_index)
+{
+	PROFILE_FUNCTION();
+
+	FrameClock::time_point wait_start = FrameClock::now();
+	vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+	FrameClock::time_point wait_end = FrameClock::now();
+	FrameClock::duration fence_wait = wait_end - wait_start;
+
+	// The fence belongs to the last frame recorded into this slot, so it completes that frame's latency sample.
+	FrameClock::duration latency = wait_end - controller.input_sampled_by_frame[frame_index];
+	controller.input_sampled_by_frame[frame_index] = controller.input_sampled;
+
+	controller.average_latency += (to_milliseconds(latency) - controller.average_latency) * AVERAGE_WEIGHT;
+	controller.average_fence_wait += (to_milliseconds(fence_wait) - controller.average_fence_wait) * AVERAGE_WEIGHT;
+
+	if (!controller.enabled) {
+		return;
+	}
+
+	// Waiting longer than the margin means the frame could have started later, waiting less means it could have started earlier.
+	auto error = std::chrono::duration_cast<FrameClock::duration>((fence_wait - controller.fence_wait_margin) * START_DELAY_GAIN);
+	FrameClock::duration max_start_delay = controller.target_frame_time > FrameClock::duration::zero() ? controller.target_frame_time : MAX_START_DELAY;
+	controller.start_delay = std::clamp(controller.start_delay + error, FrameClock::duration::zero(), max_start_delay);
+}
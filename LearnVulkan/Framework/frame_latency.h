@@ -0,0 +1,44 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <array>
+#include <chrono>
+#include "constants.h"
+
+// When the GPU is the bottleneck the CPU runs ahead until it blocks on a frame fence. Input sampled before that wait is already stale by the time the frame is drawn.
+// The controller moves that wait in front of the input poll instead: it measures how long the CPU blocked on the fence and delays the start of later frames by
+// about that much, so the CPU reaches the fence just as it signals. It also paces frames to a target rate when one is set.
+//
+// Without a present timing extension the GPU completion time is only known when the CPU actually blocks on the fence, so the latency measured here
+// (input poll to fence signal) is an upper bound for frames whose fence had already signalled.
+
+using FrameClock = std::chrono::steady_clock;
+
+struct FrameLatencyController {
+	bool enabled{ false };
+
+	// Zero leaves the frame rate uncapped.
+	FrameClock::duration target_frame_time{ 0 };
+
+	// How long the CPU is still allowed to block on the fence, a little slack so a slow frame doesn't immediately stall the GPU.
+	FrameClock::duration fence_wait_margin{ std::chrono::microseconds(500) };
+
+	// The amount the start of each frame is delayed by, on top of pacing to the target frame rate.
+	FrameClock::duration start_delay{ 0 };
+
+	FrameClock::time_point frame_start{};
+	FrameClock::time_point input_sampled{};
+	std::array<FrameClock::time_point, MAX_FRAMES_IN_FLIGHT> input_sampled_by_frame{};
+
+	// Exponential moving averages, in milliseconds.
+	double average_latency{ 0.0 };
+	double average_fence_wait{ 0.0 };
+};
+
+FrameLatencyController create_frame_latency_controller(bool enabled, double target_frames_per_second);
+
+// Sleeps until the next frame should start, call right before polling input.
+void wait_for_frame_start(FrameLatencyController& controller);
+void record_input_sampled(FrameLatencyController& controller);
+
+// Waits on the frame's fence, measures the latency of the frame that last used it and adjusts the start delay.
+void wait_for_frame_fence(FrameLatencyController& controller, VkDevice device, VkFence fence, std::size_t frame_index);
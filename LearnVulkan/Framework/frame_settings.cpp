@@ -0,0 +1,215 @@
+#include <charconv>
+#include <cstring>
+#include <algorithm>
+#include <array>
+#include <utility>
+#include "frame_settings.h"
+#include "error.h"
+
+template<typename T>
+static bool try_parse_number(const char* text, T& out_value) {
+	const char* end = text + std::strlen(text);
+	auto [last, error] = std::from_chars(text, end, out_value);
+	return error == std::errc{} && last == end;
+}
+
+static constexpr std::array<std::pair<VkPresentModeKHR, const char*>, 4> present_mode_names{ {
+	{ VK_PRESENT_MODE_FIFO_KHR, "fifo" },
+	{ VK_PRESENT_MODE_FIFO_RELAXED_KHR, "fifo_relaxed" },
+	{ VK_PRESENT_MODE_MAILBOX_KHR, "mailbox" },
+	{ VK_PRESENT_MODE_IMMEDIATE_KHR, "immediate" },
+} };
+
+std::optional<VkPresentModeKHR> parse_present_mode(const char* name)
+{
+	for (const auto& [present_mode, present_mode_name] : present_mode_names) {
+		if (std::strcmp(name, present_mode_name) == 0) {
+			return present_mode;
+		}
+	}
+
+	return std::nullopt;
+}
+
+const char* get_present_mode_name(VkPresentModeKHR present_mode)
+{
+	for (const auto& [mode, name] : present_mode_names) {
+		if (mode == present_mode) {
+			return name;
+		}
+	}
+
+	return "unknown";
+}
+
+static constexpr std::array<std::pair<UploadPath, const char*>, 3> upload_path_names{ {
+	{ UploadPath::Automatic, "automatic" },
+	{ UploadPath::Staging, "staging" },
+	{ UploadPath::Direct, "direct" },
+} };
+
+std::optional<UploadPath> parse_upload_path(const char* name)
+{
+	for (const auto& [upload_path, upload_path_name] : upload_path_names) {
+		if (std::strcmp(name, upload_path_name) == 0) {
+			return upload_path;
+		}
+	}
+
+	return std::nullopt;
+}
+
+std::size_t clamp_frames_in_flight(std::size_t frames_in_flight)
+{
+	return std::clamp<std::size_t>(frames_in_flight, 1, MAX_FRAMES_IN_FLIGHT);
+}
+
+FrameSettings parse_frame_settings(int argc, char** argv)
+{
+	FrameSettings frame_settings{};
+
+	for (int i = 1; i < argc; ++i) {
+		if (std::strcmp(argv[i], "--low-latency") == 0) {
+			frame_settings.reduce_latency = true;
+			continue;
+		}
+
+		if (std::strcmp(argv[i], "--gpu-culling") == 0) {
+			frame_settings.gpu_culling = true;
+			continue;
+		}
+
+		if (std::strcmp(argv[i], "--cpu-culling") == 0) {
+			frame_settings.cpu_culling = true;
+			continue;
+		}
+
+		if (std::strcmp(argv[i], "--bvh-culling") == 0) {
+			frame_settings.bvh_culling = true;
+			continue;
+		}
+
+		if (std::strcmp(argv[i], "--separate-draws") == 0) {
+			frame_settings.separate_draws = true;
+			continue;
+		}
+
+		if (std::strcmp(argv[i], "--job-benchmark") == 0) {
+			frame_settings.job_benchmark = true;
+			continue;
+		}
+
+		if (std::strcmp(argv[i], "--headless") == 0) {
+			frame_settings.headless = true;
+			continue;
+		}
+
+		// The remaining options all take a value.
+		if (i + 1 >= argc) {
+			break;
+		}
+
+		if (std::strcmp(argv[i], "--frames-in-flight") == 0) {
+			std::size_t frames_in_flight = 0;
+			if (try_parse_number(argv[++i], frames_in_flight) && frames_in_flight >= 1 && frames_in_flight <= MAX_FRAMES_IN_FLIGHT) {
+				frame_settings.frames_in_flight = frames_in_flight;
+			}
+			else {
+				log_error("Frames in flight must be between 1 and ", MAX_FRAMES_IN_FLIGHT, ", got ", argv[i]);
+			}
+		}
+		else if (std::strcmp(argv[i], "--swapchain-images") == 0) {
+			if (!try_parse_number(argv[++i], frame_settings.swapchain_image_count)) {
+				log_error("Invalid swapchain image count ", argv[i]);
+				frame_settings.swapchain_image_count = 0;
+			}
+		}
+		else if (std::strcmp(argv[i], "--present-mode") == 0) {
+			std::optional<VkPresentModeKHR> present_mode = parse_present_mode(argv[++i]);
+			if (present_mode) {
+				frame_settings.present_mode = *present_mode;
+			}
+			else {
+				log_error("Unknown present mode ", argv[i]);
+			}
+		}
+		else if (std::strcmp(argv[i], "--target-fps") == 0) {
+			if (!try_parse_number(argv[++i], frame_settings.target_frames_per_second) || frame_settings.target_frames_per_second < 0.0) {
+				log_error("Invalid target frame rate ", argv[i]);
+				frame_settings.target_frames_per_second = 0.0;
+			}
+		}
+		else if (std::strcmp(argv[i], "--instances") == 0) {
+			if (!try_parse_number(argv[++i], frame_settings.instance_count) || frame_settings.instance_count == 0) {
+				log_error("Invalid instance count ", argv[i]);
+				frame_settings.instance_count = 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--tick-rate") == 0) {
+			if (!try_parse_number(argv[++i], frame_settings.tick_rate) || frame_settings.tick_rate <= 0.0) {
+				log_error("Invalid tick rate ", argv[i]);
+				frame_settings.tick_rate = 60.0;
+			}
+		}
+		else if (std::strcmp(argv[i], "--width") == 0) {
+			if (!try_parse_number(argv[++i], frame_settings.width) || frame_settings.width == 0) {
+				log_error("Invalid width ", argv[i]);
+				frame_settings.width = 1200;
+			}
+		}
+		else if (std::strcmp(argv[i], "--height") == 0) {
+			if (!try_parse_number(argv[++i], frame_settings.height) || frame_settings.height == 0) {
+				log_error("Invalid height ", argv[i]);
+				frame_settings.height = 800;
+			}
+		}
+		else if (std::strcmp(argv[i], "--frame-count") == 0) {
+			if (!try_parse_number(argv[++i], frame_settings.frame_count)) {
+				log_error("Invalid frame count ", argv[i]);
+				frame_settings.frame_count = 0;
+			}
+		}
+		else if (std::strcmp(argv[i], "--capture") == 0) {
+			frame_settings.capture_path = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--benchmark") == 0) {
+			if (!try_parse_number(argv[++i], frame_settings.benchmark_frame_count)) {
+				log_error("Invalid benchmark frame count ", argv[i]);
+				frame_settings.benchmark_frame_count = 0;
+			}
+		}
+		else if (std::strcmp(argv[i], "--warmup-frames") == 0) {
+			if (!try_parse_number(argv[++i], frame_settings.benchmark_warmup_frame_count)) {
+				log_error("Invalid warm-up frame count ", argv[i]);
+				frame_settings.benchmark_warmup_frame_count = 100;
+			}
+		}
+		else if (std::strcmp(argv[i], "--benchmark-report") == 0) {
+			frame_settings.benchmark_report_path = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--profile") == 0) {
+			frame_settings.profile_trace_path = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--upload-path") == 0) {
+			std::optional<UploadPath> upload_path = parse_upload_path(argv[++i]);
+			if (upload_path) {
+				frame_settings.upload_path = *upload_path;
+			}
+			else {
+				log_error("Unknown upload path ", argv[i]);
+			}
+		}
+	}
+
+	// A benchmark decides the length of the run itself.
+	if (frame_settings.benchmark_frame_count != 0) {
+		frame_settings.frame_count = frame_settings.benchmark_warmup_frame_count + frame_settings.benchmark_frame_count;
+	}
+
+	// Nothing can close a headless run.
+	if (frame_settings.headless && frame_settings.frame_count == 0) {
+		frame_settings.frame_count = DEFAULT_HEADLESS_FRAME_COUNT;
+	}
+
+	return frame_settings;
+}
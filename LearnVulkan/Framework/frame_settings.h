@@ -0,0 +1,87 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include "constants.h"
+#include "buffer.h"
+
+// One frame in flight gives the lowest latency, the CPU waits for the GPU to finish before starting the next frame.
+// Three keeps the GPU busy at all times, at the cost of input being shown a frame or two later.
+struct FrameSettings {
+	std::size_t frames_in_flight{ DEFAULT_FRAMES_IN_FLIGHT };
+
+	// 0 asks for one more image than the minimum the surface needs.
+	uint32_t swapchain_image_count{ 0 };
+
+	// Falls back to FIFO, the only mode every implementation supports, when the surface doesn't support it.
+	VkPresentModeKHR present_mode{ VK_PRESENT_MODE_MAILBOX_KHR };
+
+	// 0 leaves the frame rate uncapped.
+	double target_frames_per_second{ 0.0 };
+
+	// Delays the start of each frame so that input is sampled as late as possible, see FrameLatencyController.
+	bool reduce_latency{ false };
+
+	// Copies of the model drawn with a single instanced draw.
+	uint32_t instance_count{ 1 };
+
+	// Draws every copy of the model with a draw call of its own instead, with its transform in the push constants. The commands are then recorded
+	// again every frame, split across the job system's threads, see ParallelRecorder. Ignored when culling on the GPU.
+	bool separate_draws{ false };
+
+	// Culls the instances against the frustum in a compute shader and draws the survivors with an indirect count draw, see GpuCulling.
+	bool gpu_culling{ false };
+
+	// Culls the instances against the frustum on the CPU before writing them to the instance buffer, see cull_bounds. Ignored when culling on the GPU.
+	bool cpu_culling{ false };
+
+	// As cpu_culling, but walks a bounding volume hierarchy over the instances instead of testing each one, see cull_bvh.
+	bool bvh_culling{ false };
+
+	// Rate the simulation thread animates the scene at, independent of the frame rate.
+	double tick_rate{ 60.0 };
+
+	// Prints the results of run_job_system_benchmark and exits without opening a window.
+	bool job_benchmark{ false };
+
+	// Renders into offscreen images instead of a window, see OffscreenImages. The swapchain image count sets the number of offscreen images instead,
+	// 0 giving one per frame in flight.
+	bool headless{ false };
+
+	// Size of the window, or of the offscreen images.
+	uint32_t width{ 1200 };
+	uint32_t height{ 800 };
+
+	// Frames to render before exiting and printing the average frame time. 0 runs until the window is closed, headless runs always stop, after DEFAULT_HEADLESS_FRAME_COUNT frames.
+	uint32_t frame_count{ 0 };
+
+	// Headless only, the last frame is written here as a PPM image. Points into the command line arguments.
+	const char* capture_path{ nullptr };
+
+	// Frames timed by the frame benchmark after the warm-up frames, 0 turns it off. The run stops once they are done, see FrameBenchmark.
+	uint32_t benchmark_frame_count{ 0 };
+	uint32_t benchmark_warmup_frame_count{ 100 };
+	const char* benchmark_report_path{ "frame_benchmark.json" };
+
+	// Enables the CPU profiler and writes a Chrome trace of the whole run here on exit, see write_chrome_trace.
+	const char* profile_trace_path{ nullptr };
+
+	// Forces meshes and textures to be staged or written straight into device memory, see UploadPath.
+	UploadPath upload_path{ UploadPath::Automatic };
+};
+
+static constexpr uint32_t DEFAULT_HEADLESS_FRAME_COUNT = 1000;
+
+// Reads --frames-in-flight <count>, --swapchain-images <count>, --present-mode <fifo|fifo_relaxed|mailbox|immediate>, --target-fps <rate>, --instances <count>, --tick-rate <rate>,
+// --width <pixels>, --height <pixels>, --frame-count <count>, --capture <path>, --benchmark <frames>, --warmup-frames <count>, --benchmark-report <path>, --profile <path>,
+// --upload-path <automatic|staging|direct>, --low-latency, --gpu-culling, --cpu-culling, --bvh-culling, --separate-draws, --job-benchmark and --headless.
+// Anything not given keeps its default.
+FrameSettings parse_frame_settings(int argc, char** argv);
+
+std::optional<VkPresentModeKHR> parse_present_mode(const char* name);
+const char* get_present_mode_name(VkPresentModeKHR present_mode);
+
+std::optional<UploadPath> parse_upload_path(const char* name);
+
+std::size_t clamp_frames_in_flight(std::size_t frames_in_flight);
@@ -0,0 +1,57 @@
+#include "frustum.h"
+
+FrustumPlanes extract_frustum_planes(const glm::mat4& view_projection)
+{
+	// glm matrices are column major, so a row is gathered from every column.
+	auto row = [&](int i) { return glm::vec4(view_projection[0][i], view_projection[1][i], view_projection[2][i], view_projection[3][i]); };
+
+	// A clip space position is inside when -w <= x, y, z <= w. Each of those inequalities, written in terms of the rows of the matrix, is a plane.
+	// The near plane assumes the OpenGL depth range glm's projections use by default, which is closer to the camera than where Vulkan clips, so culling stays conservative.
+	FrustumPlanes planes{
+		row(3) + row(0),
+		row(3) - row(0),
+		row(3) + row(1),
+		row(3) - row(1),
+		row(3) + row(2),
+		row(3) - row(2),
+	};
+
+	for (glm::vec4& plane : planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+
+	return planes;
+}
+
+bool is_sphere_in_frustum(const FrustumPlanes& planes, const glm::vec3& centre, float radius)
+{
+	for (const glm::vec4& plane : planes) {
+		if (glm::dot(glm::vec3(plane), centre) + plane.w < -radius) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+FrustumOverlap classify_aabb_in_frustum(const FrustumPlanes& planes, const Aabb& aabb)
+{
+	FrustumOverlap overlap = FrustumOverlap::Inside;
+	for (const glm::vec4& plane : planes) {
+		glm::vec3 normal(plane);
+
+		// The corners furthest along and furthest against the normal. If the first is behind the plane the whole box is, if the second is in front so is the box.
+		glm::vec3 furthest_inside = glm::mix(aabb.min, aabb.max, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+		glm::vec3 furthest_outside = glm::mix(aabb.max, aabb.min, glm::greaterThanEqual(normal, glm::vec3(0.0f)));
+
+		if (glm::dot(normal, furthest_inside) + plane.w < 0.0f) {
+			return FrustumOverlap::Outside;
+		}
+
+		if (glm::dot(normal, furthest_outside) + plane.w < 0.0f) {
+			overlap = FrustumOverlap::Intersecting;
+		}
+	}
+
+	return overlap;
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <array>
+#include <glm/glm.hpp>
+#include "aabb.h"
+
+// Planes are stored as (normal, distance) with the normal pointing into the frustum, so a point p is inside a plane when dot(normal, p) + distance >= 0.
+// Order is left, right, bottom, top, near, far.
+using FrustumPlanes = std::array<glm::vec4, 6>;
+
+// Extracts the planes from the combined view projection matrix, in the space the matrix transforms from. The planes are normalised so distances to them are in world units.
+FrustumPlanes extract_frustum_planes(const glm::mat4& view_projection);
+
+bool is_sphere_in_frustum(const FrustumPlanes& planes, const glm::vec3& centre, float radius);
+
+enum class FrustumOverlap {
+	Outside,
+	Intersecting,
+	Inside,
+};
+
+// Telling Inside apart from Intersecting lets hierarchical culling accept a whole group without testing its members.
+FrustumOverlap classify_aabb_in_frustum(const FrustumPlanes& planes, const Aabb& aabb);
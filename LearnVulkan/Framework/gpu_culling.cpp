@@ -0,0 +1,240 @@
+#include <cstring>
+#include <algorithm>
+#include "gpu_culling.h"
+#include "cpu_profiler.h"
+#include "instance_buffer.h"
+#include "buffer.h"
+#include "shader.h"
+#include "memory_stats.h"
+#include "error.h"
+
+// Must match local_size_x in cull.comp.
+static constexpr uint32_t CULL_WORKGROUP_SIZE = 64;
+
+enum {
+	CULL_BINDING_OBJECTS,
+	CULL_BINDING_DRAW_COMMANDS,
+	CULL_BINDING_DRAW_COUNT,
+	CULL_BINDING_VISIBLE_INSTANCES,
+	CULL_BINDING_COUNT,
+};
+
+static VkDescriptorSetLayout create_cull_descriptor_set_layout(VkDevice device) {
+	std::array<VkDescriptorSetLayoutBinding, CULL_BINDING_COUNT> bindings{};
+	for (uint32_t i = 0; i < CULL_BINDING_COUNT; ++i) {
+		bindings[i].binding = i;
+		bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		bindings[i].descriptorCount = 1;
+		bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+	}
+
+	VkDescriptorSetLayoutCreateInfo layout_info{};
+	layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layout_info.bindingCount = static_cast<uint32_t>(bindings.size());
+	layout_info.pBindings = bindings.data();
+
+	VkDescriptorSetLayout descriptor_set_layout{ VK_NULL_HANDLE };
+	if (vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &descriptor_set_layout) != VK_SUCCESS) {
+		log_error("Failed to create culling descriptor set layout!");
+	}
+
+	return descriptor_set_layout;
+}
+
+static VkDescriptorPool create_cull_descriptor_pool(VkDevice device) {
+	VkDescriptorPoolSize pool_size{};
+	pool_size.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	pool_size.descriptorCount = CULL_BINDING_COUNT * MAX_FRAMES_IN_FLIGHT;
+
+	VkDescriptorPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+	pool_info.poolSizeCount = 1;
+	pool_info.pPoolSizes = &pool_size;
+	pool_info.maxSets = MAX_FRAMES_IN_FLIGHT;
+
+	VkDescriptorPool descriptor_pool{ VK_NULL_HANDLE };
+	if (vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptor_pool) != VK_SUCCESS) {
+		log_error("Failed to create culling descriptor pool!");
+	}
+
+	return descriptor_pool;
+}
+
+static VkPipeline create_cull_pipeline(VkDevice device, VkPipelineLayout pipeline_layout, const char* cull_shader_path) {
+	VkShaderModule shader_module = create_shader_module(device, cull_shader_path);
+
+	VkComputePipelineCreateInfo pipeline_info{};
+	pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+	pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+	pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+	pipeline_info.stage.module = shader_module;
+	pipeline_info.stage.pName = "main";
+	pipeline_info.layout = pipeline_layout;
+
+	VkPipeline pipeline{ VK_NULL_HANDLE };
+	if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline) != VK_SUCCESS) {
+		log_error("Failed to create culling pipeline!");
+	}
+
+	// The module is only needed while the pipeline is being created.
+	vkDestroyShaderModule(device, shader_module, nullptr);
+	return pipeline;
+}
+
+static void write_cull_descriptor_set(VkDevice device, const GpuCullFrame& frame) {
+	std::array<VkDescriptorBufferInfo, CULL_BINDING_COUNT> buffer_infos{};
+	buffer_infos[CULL_BINDING_OBJECTS].buffer = frame.object_buffer;
+	buffer_infos[CULL_BINDING_DRAW_COMMANDS].buffer = frame.draw_command_buffer;
+	buffer_infos[CULL_BINDING_DRAW_COUNT].buffer = frame.draw_count_buffer;
+	buffer_infos[CULL_BINDING_VISIBLE_INSTANCES].buffer = frame.visible_instance_buffer;
+
+	std::array<VkWriteDescriptorSet, CULL_BINDING_COUNT> writes{};
+	for (uint32_t i = 0; i < CULL_BINDING_COUNT; ++i) {
+		buffer_infos[i].offset = 0;
+		buffer_infos[i].range = VK_WHOLE_SIZE;
+
+		writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writes[i].dstSet = frame.descriptor_set;
+		writes[i].dstBinding = i;
+		writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		writes[i].descriptorCount = 1;
+		writes[i].pBufferInfo = &buffer_infos[i];
+	}
+
+	vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+}
+
+GpuCulling create_gpu_culling(VkDevice device, VkPhysicalDevice physical_device, const char* cull_shader_path, uint32_t max_objects)
+{
+	PROFILE_FUNCTION();
+
+	GpuCulling gpu_culling{};
+	gpu_culling.device = device;
+	gpu_culling.max_objects = std::max(max_objects, 1u);
+	gpu_culling.draw_indexed_indirect_count = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+	if (gpu_culling.draw_indexed_indirect_count == nullptr) {
+		log_error("vkCmdDrawIndexedIndirectCountKHR is not available, VK_KHR_draw_indirect_count must be enabled for GPU culling.");
+	}
+
+	gpu_culling.descriptor_set_layout = create_cull_descriptor_set_layout(device);
+	gpu_culling.descriptor_pool = create_cull_descriptor_pool(device);
+
+	VkPipelineLayoutCreateInfo pipeline_layout_info{};
+	pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+	pipeline_layout_info.setLayoutCount = 1;
+	pipeline_layout_info.pSetLayouts = &gpu_culling.descriptor_set_layout;
+
+	if (vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr, &gpu_culling.pipeline_layout) != VK_SUCCESS) {
+		log_error("Failed to create culling pipeline layout!");
+	}
+
+	gpu_culling.pipeline = create_cull_pipeline(device, gpu_culling.pipeline_layout, cull_shader_path);
+
+	std::array<VkDescriptorSet, MAX_FRAMES_IN_FLIGHT> descriptor_sets{};
+	std::array<VkDescriptorSetLayout, MAX_FRAMES_IN_FLIGHT> layouts{};
+	layouts.fill(gpu_culling.descriptor_set_layout);
+
+	VkDescriptorSetAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	alloc_info.descriptorPool = gpu_culling.descriptor_pool;
+	alloc_info.descriptorSetCount = static_cast<uint32_t>(layouts.size());
+	alloc_info.pSetLayouts = layouts.data();
+
+	if (vkAllocateDescriptorSets(device, &alloc_info, descriptor_sets.data()) != VK_SUCCESS) {
+		log_error("Failed to allocate culling descriptor sets!");
+	}
+
+	MemoryTagScope tag_scope{ MemoryTag::Instance };
+	std::size_t object_buffer_size = sizeof(GpuCullHeader) + gpu_culling.max_objects * sizeof(GpuCullObject);
+
+	for (std::size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+		GpuCullFrame& frame = gpu_culling.frames[i];
+		frame.descriptor_set = descriptor_sets[i];
+
+		// Rewritten every frame by the CPU and read once by the compute shader, so it stays in host memory.
+		std::tie(frame.object_buffer, frame.object_memory) = create_buffer(device, physical_device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, object_buffer_size);
+		vkMapMemory(device, frame.object_memory, 0, object_buffer_size, 0, &frame.mapped_objects);
+
+		// Only ever written and read by the GPU.
+		std::tie(frame.draw_command_buffer, frame.draw_command_memory) = create_buffer(device, physical_device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, gpu_culling.max_objects * sizeof(VkDrawIndexedIndirectCommand));
+		std::tie(frame.draw_count_buffer, frame.draw_count_memory) = create_buffer(device, physical_device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, sizeof(uint32_t));
+		std::tie(frame.visible_instance_buffer, frame.visible_instance_memory) = create_buffer(device, physical_device, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, gpu_culling.max_objects * sizeof(InstanceData));
+
+		write_cull_descriptor_set(device, frame);
+	}
+
+	return gpu_culling;
+}
+
+void destroy_gpu_culling(GpuCulling& gpu_culling)
+{
+	VkDevice device = gpu_culling.device;
+	for (GpuCullFrame& frame : gpu_culling.frames) {
+		vkDestroyBuffer(device, frame.object_buffer, nullptr);
+		free_device_memory(device, frame.object_memory);
+		vkDestroyBuffer(device, frame.draw_command_buffer, nullptr);
+		free_device_memory(device, frame.draw_command_memory);
+		vkDestroyBuffer(device, frame.draw_count_buffer, nullptr);
+		free_device_memory(device, frame.draw_count_memory);
+		vkDestroyBuffer(device, frame.visible_instance_buffer, nullptr);
+		free_device_memory(device, frame.visible_instance_memory);
+	}
+
+	vkDestroyPipeline(device, gpu_culling.pipeline, nullptr);
+	vkDestroyPipelineLayout(device, gpu_culling.pipeline_layout, nullptr);
+
+	// Destroying the pool frees the descriptor sets allocated from it.
+	vkDestroyDescriptorPool(device, gpu_culling.descriptor_pool, nullptr);
+	vkDestroyDescriptorSetLayout(device, gpu_culling.descriptor_set_layout, nullptr);
+	gpu_culling = GpuCulling{};
+}
+
+void write_cull_objects(GpuCulling& gpu_culling, std::size_t frame_index, const FrustumPlanes& frustum_planes, std::span<const GpuCullObject> objects)
+{
+	GpuCullFrame& frame = gpu_culling.frames[frame_index];
+
+	GpuCullHeader header{};
+	header.frustum_planes = frustum_planes;
+	header.object_count = static_cast<uint32_t>(std::min<std::size_t>(objects.size(), gpu_culling.max_objects));
+
+	// The frustum lives in the buffer rather than in push constants so the recorded culling commands don't change as the camera moves.
+	uint8_t* mapped_objects = static_cast<uint8_t*>(frame.mapped_objects);
+	std::memcpy(mapped_objects, &header, sizeof(GpuCullHeader));
+	std::memcpy(mapped_objects + sizeof(GpuCullHeader), objects.data(), header.object_count * sizeof(GpuCullObject));
+}
+
+void record_gpu_culling(const GpuCulling& gpu_culling, VkCommandBuffer command_buffer, std::size_t frame_index)
+{
+	const GpuCullFrame& frame = gpu_culling.frames[frame_index];
+
+	// Visible objects are appended by atomically incrementing the count, so it has to start from zero.
+	vkCmdFillBuffer(command_buffer, frame.draw_count_buffer, 0, sizeof(uint32_t), 0);
+
+	VkMemoryBarrier clear_barrier{};
+	clear_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	clear_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	clear_barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clear_barrier, 0, nullptr, 0, nullptr);
+
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpu_culling.pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, gpu_culling.pipeline_layout, 0, 1, &frame.descriptor_set, 0, nullptr);
+
+	// Dispatched for the capacity rather than the number of objects written, which can change without re-recording. Invocations past the count exit straight away.
+	vkCmdDispatch(command_buffer, (gpu_culling.max_objects + CULL_WORKGROUP_SIZE - 1) / CULL_WORKGROUP_SIZE, 1, 1);
+
+	// The draw reads the commands and count as indirect parameters, and the transforms as vertex attributes.
+	VkMemoryBarrier cull_barrier{};
+	cull_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	cull_barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	cull_barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 1, &cull_barrier, 0, nullptr, 0, nullptr);
+}
+
+void draw_culled_objects(const GpuCulling& gpu_culling, VkCommandBuffer command_buffer, std::size_t frame_index)
+{
+	const GpuCullFrame& frame = gpu_culling.frames[frame_index];
+
+	VkDeviceSize instance_offset = 0;
+	vkCmdBindVertexBuffers(command_buffer, INSTANCE_BINDING, 1, &frame.visible_instance_buffer, &instance_offset);
+	gpu_culling.draw_indexed_indirect_count(command_buffer, frame.draw_command_buffer, 0, frame.draw_count_buffer, 0, gpu_culling.max_objects, sizeof(VkDrawIndexedIndirectCommand));
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <array>
+#include <span>
+#include <glm/glm.hpp>
+#include "constants.h"
+#include "frustum.h"
+
+// Culling on the GPU keeps the CPU cost of drawing constant no matter how many objects are in the scene. Each frame the CPU writes the object table, a compute shader
+// tests every object against the frustum and appends a draw command and instance transform for each visible one, and a single vkCmdDrawIndexedIndirectCount
+// draws however many survived. Each visible object is drawn as one instance, whose transform is read through the instance binding like any other instanced draw.
+//
+// Needs VK_KHR_draw_indirect_count, see DeviceDetails::supports_draw_indirect_count.
+
+// Must match the object table in cull.comp, laid out with std430 rules.
+struct GpuCullObject {
+	glm::mat4 model{ 1.0f };
+
+	// Local space centre in xyz, radius in w.
+	glm::vec4 bounding_sphere{ 0.0f };
+
+	uint32_t index_count{ 0 };
+	uint32_t first_index{ 0 };
+	int32_t vertex_offset{ 0 };
+	uint32_t padding{ 0 };
+};
+
+struct GpuCullHeader {
+	FrustumPlanes frustum_planes{};
+	uint32_t object_count{ 0 };
+	uint32_t padding[3]{};
+};
+
+// Everything written or read while culling a frame, so a frame can be culled while the previous one is still being drawn.
+struct GpuCullFrame {
+	// Host visible, the header followed by the object table.
+	VkBuffer object_buffer{ VK_NULL_HANDLE };
+	VkDeviceMemory object_memory{ VK_NULL_HANDLE };
+	void* mapped_objects{ nullptr };
+
+	VkBuffer draw_command_buffer{ VK_NULL_HANDLE };
+	VkDeviceMemory draw_command_memory{ VK_NULL_HANDLE };
+	VkBuffer draw_count_buffer{ VK_NULL_HANDLE };
+	VkDeviceMemory draw_count_memory{ VK_NULL_HANDLE };
+	VkBuffer visible_instance_buffer{ VK_NULL_HANDLE };
+	VkDeviceMemory visible_instance_memory{ VK_NULL_HANDLE };
+
+	VkDescriptorSet descriptor_set{ VK_NULL_HANDLE };
+};
+
+struct GpuCulling {
+	VkDevice device{ VK_NULL_HANDLE };
+	uint32_t max_objects{ 0 };
+
+	VkDescriptorSetLayout descriptor_set_layout{ VK_NULL_HANDLE };
+	VkDescriptorPool descriptor_pool{ VK_NULL_HANDLE };
+	VkPipelineLayout pipeline_layout{ VK_NULL_HANDLE };
+	VkPipeline pipeline{ VK_NULL_HANDLE };
+
+	// An extension command, so it has to be loaded from the device.
+	PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count{ nullptr };
+
+	std::array<GpuCullFrame, MAX_FRAMES_IN_FLIGHT> frames{};
+};
+
+GpuCulling create_gpu_culling(VkDevice device, VkPhysicalDevice physical_device, const char* cull_shader_path, uint32_t max_objects);
+void destroy_gpu_culling(GpuCulling& gpu_culling);
+
+// Objects past max_objects are dropped. The frame's fence must have been waited on.
+void write_cull_objects(GpuCulling& gpu_culling, std::size_t frame_index, const FrustumPlanes& frustum_planes, std::span<const GpuCullObject> objects);
+
+// Must be recorded outside of a render pass, before the draw that consumes its output.
+void record_gpu_culling(const GpuCulling& gpu_culling, VkCommandBuffer command_buffer, std::size_t frame_index);
+
+// Draws every visible object, inside the render pass. The mesh pool must already be bound, the visible transforms are bound to the instance binding here.
+void draw_culled_objects(const GpuCulling& gpu_culling, VkCommandBuffer command_buffer, std::size_t frame_index);
@@ -0,0 +1,146 @@
+#include <algorithm>
+#include "gpu_profiler.h"
+#include "error.h"
+
+GpuProfiler create_gpu_profiler(VkDevice device, VkPhysicalDevice physical_device, std::size_t queue_family_index, std::span<const char* const> region_names)
+{
+	GpuProfiler profiler{};
+	profiler.device = device;
+	for (const char* name : region_names) {
+		profiler.regions.push_back(GpuProfilerRegion{ name });
+	}
+
+	if (region_names.empty()) {
+		return profiler;
+	}
+
+	uint32_t queue_family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> queue_families(queue_family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &queue_family_count, queue_families.data());
+
+	// Zero valid bits means the queue doesn't support timestamps at all.
+	uint32_t valid_bits = queue_family_index < queue_families.size() ? queue_families[queue_family_index].timestampValidBits : 0;
+	if (valid_bits == 0) {
+		log_error("The graphics queue doesn't support timestamps, GPU profiling is disabled.");
+		return profiler;
+	}
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	profiler.timestamp_period = properties.limits.timestampPeriod;
+	profiler.timestamp_mask = valid_bits >= 64 ? UINT64_MAX : (uint64_t{ 1 } << valid_bits) - 1;
+
+	uint32_t query_count = static_cast<uint32_t>(region_names.size() * 2);
+	VkQueryPoolCreateInfo pool_info{};
+	pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	pool_info.queryCount = query_count;
+
+	for (VkQueryPool& query_pool : profiler.query_pools) {
+		if (vkCreateQueryPool(device, &pool_info, nullptr, &query_pool) != VK_SUCCESS) {
+			log_error("Failed to create timestamp query pool");
+			destroy_gpu_profiler(profiler);
+			return profiler;
+		}
+	}
+
+	// A value and an availability word per query.
+	profiler.query_results.resize(static_cast<std::size_t>(query_count) * 2);
+	profiler.enabled = true;
+	return profiler;
+}
+
+void destroy_gpu_profiler(GpuProfiler& profiler)
+{
+	for (VkQueryPool& query_pool : profiler.query_pools) {
+		if (query_pool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(profiler.device, query_pool, nullptr);
+			query_pool = VK_NULL_HANDLE;
+		}
+	}
+
+	profiler.enabled = false;
+}
+
+void record_gpu_profiler_reset(const GpuProfiler& profiler, VkCommandBuffer command_buffer, std::size_t frame_index)
+{
+	if (!profiler.enabled) {
+		return;
+	}
+
+	// Queries have to be reset before they can be written again. Without host query reset (Vulkan 1.2) that has to happen on the device.
+	vkCmdResetQueryPool(command_buffer, profiler.query_pools[frame_index], 0, static_cast<uint32_t>(profiler.regions.size() * 2));
+}
+
+void record_gpu_region_begin(const GpuProfiler& profiler, VkCommandBuffer command_buffer, std::size_t frame_index, uint32_t region)
+{
+	if (!profiler.enabled) {
+		return;
+	}
+
+	// Written once every earlier command has been started.
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler.query_pools[frame_index], region * 2);
+}
+
+void record_gpu_region_end(const GpuProfiler& profiler, VkCommandBuffer command_buffer, std::size_t frame_index, uint32_t region)
+{
+	if (!profiler.enabled) {
+		return;
+	}
+
+	// Written once every earlier command has completed.
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, profiler.query_pools[frame_index], region * 2 + 1);
+}
+
+void mark_gpu_profiler_submitted(GpuProfiler& profiler, std::size_t frame_index)
+{
+	profiler.results_pending[frame_index] = profiler.enabled;
+}
+
+void read_gpu_profiler_results(GpuProfiler& profiler, std::size_t frame_index)
+{
+	if (!profiler.enabled || !profiler.results_pending[frame_index]) {
+		return;
+	}
+
+	profiler.results_pending[frame_index] = false;
+
+	// No wait flag, so this never blocks. The fence has signalled so every timestamp the frame wrote is available, regions that weren't recorded
+	// are reported unavailable and the call returns VK_NOT_READY, which is expected.
+	uint32_t query_count = static_cast<uint32_t>(profiler.regions.size() * 2);
+	VkResult result = vkGetQueryPoolResults(profiler.device, profiler.query_pools[frame_index], 0, query_count, profiler.query_results.size() * sizeof(uint64_t), profiler.query_results.data(),
+		sizeof(uint64_t) * 2, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+	if (result != VK_SUCCESS && result != VK_NOT_READY) {
+		return;
+	}
+
+	for (std::size_t i = 0; i < profiler.regions.size(); ++i) {
+		const uint64_t* begin = &profiler.query_results[i * 4];
+		const uint64_t* end = begin + 2;
+		if (begin[1] == 0 || end[1] == 0) {
+			continue;
+		}
+
+		uint64_t ticks = (end[0] - begin[0]) & profiler.timestamp_mask;
+		GpuProfilerRegion& region = profiler.regions[i];
+		region.history[region.next_sample] = static_cast<float>(ticks * profiler.timestamp_period / 1000000.0);
+		region.next_sample = (region.next_sample + 1) % GPU_PROFILER_HISTORY_LENGTH;
+		region.sample_count = std::min(region.sample_count + 1, GPU_PROFILER_HISTORY_LENGTH);
+	}
+}
+
+double get_gpu_region_average(const GpuProfilerRegion& region)
+{
+	if (region.sample_count == 0) {
+		return 0.0;
+	}
+
+	// Until the ring fills, the samples are the first sample_count entries.
+	double sum = 0.0;
+	for (std::size_t i = 0; i < region.sample_count; ++i) {
+		sum += region.history[i];
+	}
+
+	return sum / region.sample_count;
+}
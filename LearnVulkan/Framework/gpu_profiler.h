@@ -0,0 +1,67 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <span>
+#include <vector>
+#include "constants.h"
+
+// Measures how long regions of a frame take on the GPU with a pair of timestamps around each. Every frame in flight has its own query pool, and results
+// are only read once that frame's fence has signalled, so reading them never stalls the CPU or the GPU. A frame's results arrive one trip around the frames
+// in flight late, which doesn't matter for a rolling history.
+//
+// The resets and timestamps are recorded into the frame's command buffer, so command buffers that are recorded once and submitted many times keep timing.
+
+// Results kept per region for the rolling history.
+static constexpr std::size_t GPU_PROFILER_HISTORY_LENGTH = 128;
+
+struct GpuProfilerRegion {
+	const char* name{ nullptr };
+
+	// Milliseconds, a ring written at next_sample.
+	std::array<float, GPU_PROFILER_HISTORY_LENGTH> history{};
+	std::size_t sample_count{ 0 };
+	std::size_t next_sample{ 0 };
+};
+
+struct GpuProfiler {
+	VkDevice device{ VK_NULL_HANDLE };
+
+	// False when the queue can't write timestamps, every call then does nothing.
+	bool enabled{ false };
+
+	// Nanoseconds per timestamp tick.
+	double timestamp_period{ 1.0 };
+
+	// Timestamps only have this many valid bits, and wrap around past them.
+	uint64_t timestamp_mask{ UINT64_MAX };
+
+	// Two queries per region, the begin timestamp followed by the end.
+	std::array<VkQueryPool, MAX_FRAMES_IN_FLIGHT> query_pools{};
+
+	// Set when a frame is submitted with the pool, and cleared once its results have been read.
+	std::array<bool, MAX_FRAMES_IN_FLIGHT> results_pending{};
+
+	std::vector<GpuProfilerRegion> regions{};
+	std::vector<uint64_t> query_results{};
+};
+
+// Region indices are positions in region_names.
+GpuProfiler create_gpu_profiler(VkDevice device, VkPhysicalDevice physical_device, std::size_t queue_family_index, std::span<const char* const> region_names);
+void destroy_gpu_profiler(GpuProfiler& profiler);
+
+// Must be recorded outside a render pass and before any region of the frame.
+void record_gpu_profiler_reset(const GpuProfiler& profiler, VkCommandBuffer command_buffer, std::size_t frame_index);
+
+// Regions may nest or be left out of a frame, a region without both timestamps is skipped when reading.
+void record_gpu_region_begin(const GpuProfiler& profiler, VkCommandBuffer command_buffer, std::size_t frame_index, uint32_t region);
+void record_gpu_region_end(const GpuProfiler& profiler, VkCommandBuffer command_buffer, std::size_t frame_index, uint32_t region);
+
+void mark_gpu_profiler_submitted(GpuProfiler& profiler, std::size_t frame_index);
+
+// Call once the frame's fence has been waited on. Adds the frame's results to the region histories.
+void read_gpu_profiler_results(GpuProfiler& profiler, std::size_t frame_index);
+
+// Average of the rolling history in milliseconds, zero before the first result.
+double get_gpu_region_average(const GpuProfilerRegion& region);
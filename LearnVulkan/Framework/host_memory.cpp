@@ -0,0 +1,231 @@
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <tuple>
+#include <span>
+#include <bit>
+#include <cstdint>
+#include <algorithm>
+#include "host_memory.h"
+#include "buffer.h"
+#include "error.h"
+#include "memory_stats.h"
+
+std::optional<MappedFile> map_file(const char* file_path)
+{
+	MappedFile mapped_file{};
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		log_error("Failed to open file for mapping ", file_path);
+		return std::nullopt;
+	}
+
+	LARGE_INTEGER file_size{};
+	GetFileSizeEx(file, &file_size);
+	mapped_file.size = static_cast<std::size_t>(file_size.QuadPart);
+
+	// Copy-on-write so the pages are writable from the point of view of the driver, without ever touching the file.
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		log_error("Failed to create file mapping ", file_path);
+		CloseHandle(file);
+		return std::nullopt;
+	}
+
+	mapped_file.data = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	if (mapped_file.data == nullptr) {
+		log_error("Failed to map view of file ", file_path);
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return std::nullopt;
+	}
+
+	mapped_file.file_handle = file;
+	mapped_file.mapping_handle = mapping;
+#else
+	int file_descriptor = open(file_path, O_RDONLY);
+	if (file_descriptor < 0) {
+		log_error("Failed to open file for mapping ", file_path);
+		return std::nullopt;
+	}
+
+	struct stat file_stat {};
+	fstat(file_descriptor, &file_stat);
+	mapped_file.size = static_cast<std::size_t>(file_stat.st_size);
+
+	// Copy-on-write so the pages are writable from the point of view of the driver, without ever touching the file.
+	void* data = mmap(nullptr, mapped_file.size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file_descriptor, 0);
+	if (data == MAP_FAILED) {
+		log_error("Failed to map file ", file_path);
+		close(file_descriptor);
+		return std::nullopt;
+	}
+
+	mapped_file.data = data;
+	mapped_file.file_descriptor = file_descriptor;
+#endif
+
+	return mapped_file;
+}
+
+void unmap_file(MappedFile& mapped_file)
+{
+#ifdef _WIN32
+	UnmapViewOfFile(mapped_file.data);
+	CloseHandle(mapped_file.mapping_handle);
+	CloseHandle(mapped_file.file_handle);
+#else
+	munmap(mapped_file.data, mapped_file.size);
+	close(mapped_file.file_descriptor);
+#endif
+
+	mapped_file = MappedFile{};
+}
+
+std::optional<ImportedBuffer> import_host_buffer(VkDevice device, const DeviceDetails& device_details, VkBufferUsageFlags usage_flags, void* data, std::size_t size)
+{
+	VkDeviceSize alignment = device_details.min_imported_host_pointer_alignment;
+	if (alignment == 0) {
+		return std::nullopt;
+	}
+
+	if (reinterpret_cast<std::uintptr_t>(data) % alignment != 0 || size % alignment != 0) {
+		log_error("Host pointer must be aligned to ", alignment, " to be imported");
+		return std::nullopt;
+	}
+
+	// Extension functions aren't exported by the loader, they have to be looked up from the device.
+	auto get_host_pointer_properties = reinterpret_cast<PFN_vkGetMemoryHostPointerPropertiesEXT>(vkGetDeviceProcAddr(device, "vkGetMemoryHostPointerPropertiesEXT"));
+	if (get_host_pointer_properties == nullptr) {
+		return std::nullopt;
+	}
+
+	ImportedBuffer imported_buffer{};
+	imported_buffer.size = size;
+
+	// The buffer has to declare up front that it will be bound to imported host memory.
+	VkExternalMemoryBufferCreateInfo external_info{};
+	external_info.sType = VK_STRUCTURE_TYPE_EXTERNAL_MEMORY_BUFFER_CREATE_INFO;
+	external_info.handleTypes = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+
+	VkBufferCreateInfo buffer_info{};
+	buffer_info.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	buffer_info.pNext = &external_info;
+	buffer_info.size = size;
+	buffer_info.usage = usage_flags;
+	buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+	if (vkCreateBuffer(device, &buffer_info, nullptr, &imported_buffer.buffer) != VK_SUCCESS) {
+		log_error("Failed to create buffer for imported host memory");
+		return std::nullopt;
+	}
+
+	// The host pointer restricts which memory types can be used, on top of what the buffer requires.
+	VkMemoryHostPointerPropertiesEXT host_pointer_properties{};
+	host_pointer_properties.sType = VK_STRUCTURE_TYPE_MEMORY_HOST_POINTER_PROPERTIES_EXT;
+	if (get_host_pointer_properties(device, VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT, data, &host_pointer_properties) != VK_SUCCESS) {
+		vkDestroyBuffer(device, imported_buffer.buffer, nullptr);
+		return std::nullopt;
+	}
+
+	VkMemoryRequirements requirements;
+	vkGetBufferMemoryRequirements(device, imported_buffer.buffer, &requirements);
+
+	uint32_t type_bits = requirements.memoryTypeBits & host_pointer_properties.memoryTypeBits;
+	if (type_bits == 0) {
+		vkDestroyBuffer(device, imported_buffer.buffer, nullptr);
+		return std::nullopt;
+	}
+
+	VkImportMemoryHostPointerInfoEXT import_info{};
+	import_info.sType = VK_STRUCTURE_TYPE_IMPORT_MEMORY_HOST_POINTER_INFO_EXT;
+	import_info.handleType = VK_EXTERNAL_MEMORY_HANDLE_TYPE_HOST_ALLOCATION_BIT_EXT;
+	import_info.pHostPointer = data;
+
+	VkMemoryAllocateInfo alloc_info{};
+	alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	alloc_info.pNext = &import_info;
+	alloc_info.allocationSize = size;
+	alloc_info.memoryTypeIndex = static_cast<uint32_t>(std::countr_zero(type_bits));
+
+	if (allocate_device_memory(device, alloc_info, imported_buffer.memory) != VK_SUCCESS) {
+		vkDestroyBuffer(device, imported_buffer.buffer, nullptr);
+		return std::nullopt;
+	}
+
+	vkBindBufferMemory(device, imported_buffer.buffer, imported_buffer.memory, 0);
+	return imported_buffer;
+}
+
+void destroy_imported_buffer(VkDevice device, ImportedBuffer& imported_buffer)
+{
+	vkDestroyBuffer(device, imported_buffer.buffer, nullptr);
+	free_device_memory(device, imported_buffer.memory);
+	imported_buffer = ImportedBuffer{};
+}
+
+ImportedFile import_mapped_file(VkDevice device, VkPhysicalDevice physical_device, const DeviceDetails& device_details, const MappedFile& mapped_file)
+{
+	ImportedFile imported_file{};
+
+	// Mappings start on a page (or on Windows an allocation granularity) boundary, which is normally aligned enough, but the end of the file rarely is.
+	// Importing past it would hand the driver pages that don't belong to the file, so the import stops at the last whole multiple of the alignment.
+	std::size_t alignment = static_cast<std::size_t>(device_details.min_imported_host_pointer_alignment);
+	if (alignment != 0 && reinterpret_cast<std::uintptr_t>(mapped_file.data) % alignment == 0 && mapped_file.size >= alignment) {
+		MemoryTagScope tag_scope{ MemoryTag::Staging };
+		std::optional<ImportedBuffer> imported_buffer = import_host_buffer(device, device_details, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, mapped_file.data, mapped_file.size / alignment * alignment);
+		if (imported_buffer) {
+			imported_file.imported = *imported_buffer;
+		}
+	}
+
+	// The rest is read straight out of the mapping into the staging buffer, which is still one less copy than reading the file into memory first.
+	std::size_t imported_size = static_cast<std::size_t>(imported_file.imported.size);
+	if (imported_size < mapped_file.size) {
+		std::span<const uint8_t> tail{ static_cast<const uint8_t*>(mapped_file.data) + imported_size, mapped_file.size - imported_size };
+		std::tie(imported_file.staged_tail_buffer, imported_file.staged_tail_memory) = create_staging_buffer(device, physical_device, tail);
+	}
+
+	return imported_file;
+}
+
+void destroy_imported_file(VkDevice device, ImportedFile& imported_file)
+{
+	if (imported_file.imported.buffer != VK_NULL_HANDLE) {
+		destroy_imported_buffer(device, imported_file.imported);
+	}
+
+	if (imported_file.staged_tail_buffer != VK_NULL_HANDLE) {
+		vkDestroyBuffer(device, imported_file.staged_tail_buffer, nullptr);
+		free_device_memory(device, imported_file.staged_tail_memory);
+	}
+
+	imported_file = ImportedFile{};
+}
+
+void record_imported_file_copy(VkCommandBuffer command_buffer, const ImportedFile& imported_file, VkDeviceSize file_offset, VkBuffer dst_buffer, VkDeviceSize dst_offset, VkDeviceSize size)
+{
+	// A range can straddle the end of the imported prefix, in which case it is copied from both buffers.
+	VkDeviceSize imported_size = imported_file.imported.size;
+	if (file_offset < imported_size && size > 0) {
+		VkDeviceSize amount = std::min(size, imported_size - file_offset);
+		record_buffer_copy(command_buffer, imported_file.imported.buffer, dst_buffer, amount, dst_offset, file_offset);
+		file_offset += amount;
+		dst_offset += amount;
+		size -= amount;
+	}
+
+	if (size > 0) {
+		record_buffer_copy(command_buffer, imported_file.staged_tail_buffer, dst_buffer, size, dst_offset, file_offset - imported_size);
+	}
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <optional>
+#include "physical_device.h"
+
+// VK_EXT_external_memory_host lets the device read host pages directly as VkDeviceMemory.
+// Large read-only blobs (cooked vertex data) can be memory mapped from disk and imported, which removes the memcpy into a staging buffer.
+// The mapping is private and copy-on-write, so the file on disk is never modified.
+
+struct MappedFile {
+	void* data{ nullptr };
+	std::size_t size{ 0 };
+
+#ifdef _WIN32
+	void* file_handle{ nullptr };
+	void* mapping_handle{ nullptr };
+#else
+	int file_descriptor{ -1 };
+#endif
+};
+
+// Maps exactly the size of the file, the pages past the end aren't backed by it and can't be touched.
+std::optional<MappedFile> map_file(const char* file_path);
+void unmap_file(MappedFile& mapped_file);
+
+struct ImportedBuffer {
+	VkBuffer buffer{ VK_NULL_HANDLE };
+	VkDeviceMemory memory{ VK_NULL_HANDLE };
+	VkDeviceSize size{ 0 };
+};
+
+// Wraps host memory in a buffer without copying it. The host memory must stay alive (and mapped) for as long as the buffer is used.
+// data and size must be multiples of DeviceDetails::min_imported_host_pointer_alignment.
+std::optional<ImportedBuffer> import_host_buffer(VkDevice device, const DeviceDetails& device_details, VkBufferUsageFlags usage_flags, void* data, std::size_t size);
+void destroy_imported_buffer(VkDevice device, ImportedBuffer& imported_buffer);
+
+// A mapped file the GPU can copy out of. The largest prefix of the file that is a whole multiple of the import alignment is imported in place,
+// and only the tail after it is copied into a staging buffer. The whole file is staged when the extension is missing, the mapping is misaligned or the import fails.
+struct ImportedFile {
+	ImportedBuffer imported{};
+	VkBuffer staged_tail_buffer{ VK_NULL_HANDLE };
+	VkDeviceMemory staged_tail_memory{ VK_NULL_HANDLE };
+};
+
+ImportedFile import_mapped_file(VkDevice device, VkPhysicalDevice physical_device, const DeviceDetails& device_details, const MappedFile& mapped_file);
+void destroy_imported_file(VkDevice device, ImportedFile& imported_file);
+
+// Copies size bytes of the file, starting at file_offset, into dst_buffer. The file must stay mapped until the copy has completed.
+void record_imported_file_copy(VkCommandBuffer command_buffer, const ImportedFile& imported_file, VkDeviceSize file_offset, VkBuffer dst_buffer, VkDeviceSize dst_offset, VkDeviceSize size);
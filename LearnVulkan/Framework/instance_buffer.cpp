@@ -0,0 +1,80 @@
+#include <cstring>
+#include <algorithm>
+#include "instance_buffer.h"
+#include "cpu_profiler.h"
+#include "buffer.h"
+#include "memory_stats.h"
+#include "error.h"
+
+static VkDeviceSize get_frame_offset(const InstanceRingBuffer& ring_buffer, std::size_t frame_index) {
+	return static_cast<VkDeviceSize>(frame_index * ring_buffer.capacity_per_frame * sizeof(InstanceData));
+}
+
+static VkDeviceSize get_draw_command_offset(const InstanceRingBuffer& ring_buffer, std::size_t frame_index) {
+	return get_frame_offset(ring_buffer, MAX_FRAMES_IN_FLIGHT) + frame_index * sizeof(VkDrawIndexedIndirectCommand);
+}
+
+static VkDeviceSize get_identity_instance_offset(const InstanceRingBuffer& ring_buffer) {
+	return get_draw_command_offset(ring_buffer, MAX_FRAMES_IN_FLIGHT);
+}
+
+InstanceRingBuffer create_instance_ring_buffer(VkDevice device, VkPhysicalDevice physical_device, std::size_t capacity_per_frame)
+{
+	InstanceRingBuffer ring_buffer{};
+	ring_buffer.capacity_per_frame = std::max<std::size_t>(capacity_per_frame, 1);
+	MemoryTagScope tag_scope{ MemoryTag::Instance };
+
+	// Host coherent so writes need no flush, the whole buffer is read once per instance per draw so it isn't worth staging into device local memory.
+	std::size_t size = static_cast<std::size_t>(get_identity_instance_offset(ring_buffer) + sizeof(InstanceData));
+	auto [buffer, buffer_memory] = create_buffer(device, physical_device, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, size);
+	ring_buffer.buffer = buffer;
+	ring_buffer.memory = buffer_memory;
+
+	void* mapped_region = nullptr;
+	if (vkMapMemory(device, ring_buffer.memory, 0, size, 0, &mapped_region) != VK_SUCCESS) {
+		log_error("Failed to map instance buffer.");
+	}
+
+	ring_buffer.mapped_instances = static_cast<InstanceData*>(mapped_region);
+	ring_buffer.mapped_draw_commands = reinterpret_cast<VkDrawIndexedIndirectCommand*>(static_cast<uint8_t*>(mapped_region) + get_draw_command_offset(ring_buffer, 0));
+
+	// Written once, it never changes.
+	InstanceData identity_instance{};
+	std::memcpy(static_cast<uint8_t*>(mapped_region) + get_identity_instance_offset(ring_buffer), &identity_instance, sizeof(InstanceData));
+	return ring_buffer;
+}
+
+void destroy_instance_ring_buffer(VkDevice device, InstanceRingBuffer& ring_buffer)
+{
+	// Freeing the memory also unmaps it.
+	vkDestroyBuffer(device, ring_buffer.buffer, nullptr);
+	free_device_memory(device, ring_buffer.memory);
+	ring_buffer = InstanceRingBuffer{};
+}
+
+uint32_t write_instances(InstanceRingBuffer& ring_buffer, std::size_t frame_index, const MeshRange& mesh_range, std::span<const InstanceData> instances)
+{
+	PROFILE_FUNCTION();
+
+	std::size_t count = std::min(instances.size(), ring_buffer.capacity_per_frame);
+	std::memcpy(ring_buffer.mapped_instances + frame_index * ring_buffer.capacity_per_frame, instances.data(), count * sizeof(InstanceData));
+	ring_buffer.mapped_draw_commands[frame_index] = get_indirect_draw_command(mesh_range, static_cast<uint32_t>(count));
+	return static_cast<uint32_t>(count);
+}
+
+void bind_instance_buffer(VkCommandBuffer command_buffer, const InstanceRingBuffer& ring_buffer, std::size_t frame_index)
+{
+	VkDeviceSize offset = get_frame_offset(ring_buffer, frame_index);
+	vkCmdBindVertexBuffers(command_buffer, INSTANCE_BINDING, 1, &ring_buffer.buffer, &offset);
+}
+
+void bind_identity_instance(VkCommandBuffer command_buffer, const InstanceRingBuffer& ring_buffer)
+{
+	VkDeviceSize offset = get_identity_instance_offset(ring_buffer);
+	vkCmdBindVertexBuffers(command_buffer, INSTANCE_BINDING, 1, &ring_buffer.buffer, &offset);
+}
+
+void draw_instances(VkCommandBuffer command_buffer, const InstanceRingBuffer& ring_buffer, std::size_t frame_index)
+{
+	vkCmdDrawIndexedIndirect(command_buffer, ring_buffer.buffer, get_draw_command_offset(ring_buffer, frame_index), 1, sizeof(VkDrawIndexedIndirectCommand));
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <glm/glm.hpp>
+#include "constants.h"
+#include "mesh_pool.h"
+
+// Per-instance data for drawing many copies of a mesh with a single draw. It is read through a vertex binding that advances once per instance rather than per vertex.
+// Must match the instance attributes in the vertex shader.
+struct InstanceData {
+	glm::mat4 model{ 1.0f };
+};
+
+static constexpr uint32_t INSTANCE_BINDING = 1;
+
+// Instance data is rewritten by the CPU every frame, so each frame in flight gets its own slice of one persistently mapped buffer.
+// A frame's slice is only written once its fence has been waited on, so the GPU is never reading what is being written.
+// The draw reads its instance count from an indirect command that is written along with the instances, so recorded command buffers stay valid when
+// the number of instances changes from frame to frame, as it does when they are culled.
+struct InstanceRingBuffer {
+	VkBuffer buffer{ VK_NULL_HANDLE };
+	VkDeviceMemory memory{ VK_NULL_HANDLE };
+	InstanceData* mapped_instances{ nullptr };
+
+	// One per frame, after the instances of every frame.
+	VkDrawIndexedIndirectCommand* mapped_draw_commands{ nullptr };
+
+	// In instances.
+	std::size_t capacity_per_frame{ 0 };
+};
+
+InstanceRingBuffer create_instance_ring_buffer(VkDevice device, VkPhysicalDevice physical_device, std::size_t capacity_per_frame);
+void destroy_instance_ring_buffer(VkDevice device, InstanceRingBuffer& ring_buffer);
+
+// Copies the instances into the frame's slice and sets up the frame's draw of the mesh, anything past the capacity is dropped. Returns how many were written.
+uint32_t write_instances(InstanceRingBuffer& ring_buffer, std::size_t frame_index, const MeshRange& mesh_range, std::span<const InstanceData> instances);
+
+void bind_instance_buffer(VkCommandBuffer command_buffer, const InstanceRingBuffer& ring_buffer, std::size_t frame_index);
+
+// The pipeline always reads the instance binding, so a mesh drawn once with the transform in its push constants reads a single identity instance,
+// kept after the draw commands.
+void bind_identity_instance(VkCommandBuffer command_buffer, const InstanceRingBuffer& ring_buffer);
+
+// Draws every instance written for the frame. The mesh pool and the frame's instances must be bound.
+void draw_instances(VkCommandBuffer command_buffer, const InstanceRingBuffer& ring_buffer, std::size_t frame_index);
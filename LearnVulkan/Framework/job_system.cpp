@@ -0,0 +1,323 @@
+#include <algorithm>
+#include "job_system.h"
+#include "cpu_profiler.h"
+
+static_assert((JOB_CAPACITY_PER_THREAD & (JOB_CAPACITY_PER_THREAD - 1)) == 0, "The job rings are indexed with a mask.");
+static constexpr int64_t JOB_INDEX_MASK = JOB_CAPACITY_PER_THREAD - 1;
+
+// A worker that finds nothing to do checks this many more times before going to sleep, jobs often come in quick bursts.
+static constexpr std::size_t IDLE_SPIN_COUNT = 64;
+
+// Set on the worker and attached threads, the creating thread is recognised by its id instead so one thread can create several systems.
+static thread_local const JobSystem* current_system = nullptr;
+static thread_local std::size_t current_thread_index = 0;
+
+bool JobDeque::push(Job* job)
+{
+	int64_t b = bottom.load(std::memory_order_relaxed);
+	int64_t t = top.load(std::memory_order_acquire);
+	if (b - t >= static_cast<int64_t>(JOB_CAPACITY_PER_THREAD)) {
+		return false;
+	}
+
+	jobs[b & JOB_INDEX_MASK].store(job, std::memory_order_relaxed);
+
+	// The job must be visible before a thief can see the new bottom.
+	bottom.store(b + 1, std::memory_order_release);
+	return true;
+}
+
+Job* JobDeque::pop()
+{
+	int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+	bottom.store(b, std::memory_order_relaxed);
+
+	// Claiming the bottom job has to be ordered against thieves reading bottom, otherwise both could take the last job.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t t = top.load(std::memory_order_relaxed);
+
+	if (t > b) {
+		bottom.store(b + 1, std::memory_order_relaxed);
+		return nullptr;
+	}
+
+	Job* job = jobs[b & JOB_INDEX_MASK].load(std::memory_order_relaxed);
+	if (t == b) {
+		// The last job, a thief might be taking it at the same time and whoever moves top first wins.
+		if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+			job = nullptr;
+		}
+
+		bottom.store(b + 1, std::memory_order_relaxed);
+	}
+
+	return job;
+}
+
+Job* JobDeque::steal()
+{
+	int64_t t = top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	int64_t b = bottom.load(std::memory_order_acquire);
+	if (t >= b) {
+		return nullptr;
+	}
+
+	Job* job = jobs[t & JOB_INDEX_MASK].load(std::memory_order_relaxed);
+	if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+		return nullptr;
+	}
+
+	return job;
+}
+
+JobSystem::JobSystem(std::size_t worker_count, std::size_t attached_thread_count)
+{
+	if (worker_count == SIZE_MAX) {
+		worker_count = std::max<std::size_t>(std::thread::hardware_concurrency(), 1) - 1;
+	}
+
+	creating_thread = std::this_thread::get_id();
+	first_attached_thread = worker_count + 1;
+	std::size_t thread_count = worker_count + 1 + attached_thread_count;
+	threads.reserve(thread_count);
+	for (std::size_t i = 0; i < thread_count; ++i) {
+		threads.push_back(std::make_unique<ThreadState>());
+		threads[i]->next_victim = i + 1;
+	}
+
+	workers.reserve(worker_count);
+	for (std::size_t i = 0; i < worker_count; ++i) {
+		workers.emplace_back([this, i]() { run_worker(i + 1); });
+	}
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard lock(sleep_mutex);
+		stopping.store(true);
+	}
+
+	work_ready.notify_all();
+
+	// jthread joins on destruction.
+	workers.clear();
+}
+
+bool JobSystem::attach_current_thread()
+{
+	std::size_t thread_index = first_attached_thread + attached_count.fetch_add(1);
+	if (thread_index >= threads.size()) {
+		return false;
+	}
+
+	current_system = this;
+	current_thread_index = thread_index;
+	return true;
+}
+
+JobSystem::ThreadState* JobSystem::get_thread_state()
+{
+	if (current_system == this) {
+		return threads[current_thread_index].get();
+	}
+
+	if (std::this_thread::get_id() == creating_thread) {
+		return threads[0].get();
+	}
+
+	return nullptr;
+}
+
+Job& JobSystem::allocate_job(ThreadState& state)
+{
+	while (true) {
+		// Once the ring has wrapped around, slots still holding unfinished jobs are skipped. One might be a job further up this thread's stack,
+		// which can't finish until the job being created has.
+		for (std::size_t i = 0; i < JOB_CAPACITY_PER_THREAD; ++i) {
+			Job& job = state.jobs[state.next_job++ & JOB_INDEX_MASK];
+			if (job.finished.load(std::memory_order_acquire)) {
+				job.finished.store(false, std::memory_order_relaxed);
+				return job;
+			}
+		}
+
+		// Every slot is in use, so help until one frees up.
+		if (Job* other = find_job(state)) {
+			execute(*other);
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::submit(Job& job)
+{
+	ThreadState* state = get_thread_state();
+
+	// Continuations can be released from any thread that finishes a job, and a full deque can't take any more.
+	if (state == nullptr || !state->deque.push(&job)) {
+		execute(job);
+		return;
+	}
+
+	submit_generation.fetch_add(1);
+	if (sleeping_count.load() > 0) {
+		// Taking the lock makes sure a worker that is about to sleep either sees the new generation or is already waiting for the notification.
+		{
+			std::lock_guard lock(sleep_mutex);
+		}
+
+		work_ready.notify_one();
+	}
+}
+
+void JobSystem::submit_after(JobCounter& dependency, Job& job)
+{
+	{
+		std::lock_guard lock(dependency.mutex);
+		if (dependency.pending.load(std::memory_order_acquire) != 0) {
+			dependency.continuations.push_back(&job);
+			return;
+		}
+	}
+
+	submit(job);
+}
+
+void JobSystem::finish(JobCounter& counter)
+{
+	// Every decrement but the last only touches the count. The last one takes the lock, so anything waiting to run after the counter is released
+	// before the counter can be seen as done, and so wait doesn't return while the lock is still held.
+	uint32_t pending = counter.pending.load(std::memory_order_relaxed);
+	while (pending > 1) {
+		if (counter.pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+			return;
+		}
+	}
+
+	std::vector<Job*> continuations{};
+	{
+		std::lock_guard lock(counter.mutex);
+
+		// More jobs may have been counted against it since.
+		if (counter.pending.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+			continuations.swap(counter.continuations);
+		}
+	}
+
+	for (Job* continuation : continuations) {
+		submit(*continuation);
+	}
+}
+
+void JobSystem::execute(Job& job)
+{
+	JobCounter& counter = *job.counter;
+	job.function(job);
+	job.finished.store(true, std::memory_order_release);
+	finish(counter);
+}
+
+Job* JobSystem::find_job(ThreadState& state)
+{
+	if (Job* job = state.deque.pop()) {
+		return job;
+	}
+
+	for (std::size_t i = 0; i < threads.size(); ++i) {
+		ThreadState& victim = *threads[state.next_victim++ % threads.size()];
+		if (&victim == &state) {
+			continue;
+		}
+
+		if (Job* job = victim.deque.steal()) {
+			return job;
+		}
+	}
+
+	return nullptr;
+}
+
+void JobSystem::run_worker(std::size_t thread_index)
+{
+	current_system = this;
+	current_thread_index = thread_index;
+	set_profiler_thread_name("job worker");
+	ThreadState& state = *threads[thread_index];
+
+	std::size_t idle_count = 0;
+	while (!stopping.load(std::memory_order_relaxed)) {
+		// Read before looking for work, a job submitted after this changes it and keeps the worker awake.
+		uint64_t generation = submit_generation.load();
+
+		if (Job* job = find_job(state)) {
+			execute(*job);
+			idle_count = 0;
+			continue;
+		}
+
+		if (++idle_count < IDLE_SPIN_COUNT) {
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock lock(sleep_mutex);
+		sleeping_count.fetch_add(1);
+		work_ready.wait(lock, [&]() { return stopping.load() || submit_generation.load() != generation; });
+		sleeping_count.fetch_sub(1);
+		idle_count = 0;
+	}
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	ThreadState* state = get_thread_state();
+	while (!counter.is_done()) {
+		Job* job = state != nullptr ? find_job(*state) : nullptr;
+		if (job != nullptr) {
+			execute(*job);
+		}
+		else {
+			std::this_thread::yield();
+		}
+	}
+
+	// The last job to finish may still be releasing the counter's lock.
+	std::lock_guard lock(counter.mutex);
+}
+
+std::size_t JobSystem::parallel_for(std::size_t count, std::size_t min_range_size, std::size_t range_alignment, const RangeFunction& function)
+{
+	if (count == 0) {
+		return 0;
+	}
+
+	range_alignment = std::max<std::size_t>(range_alignment, 1);
+	std::size_t range_count = std::clamp<std::size_t>(count / std::max<std::size_t>(min_range_size, 1), 1, get_thread_count());
+
+	// Rounded up to the alignment, which can leave fewer ranges than threads.
+	std::size_t range_size = (count + range_count - 1) / range_count;
+	range_size = (range_size + range_alignment - 1) / range_alignment * range_alignment;
+	range_count = (count + range_size - 1) / range_size;
+
+	// The calling thread runs the first range itself rather than waiting.
+	JobCounter counter{};
+	for (std::size_t range_index = 1; range_index < range_count; ++range_index) {
+		std::size_t begin = range_index * range_size;
+		std::size_t end = std::min(begin + range_size, count);
+		run(counter, [&function, begin, end, range_index]() {
+			PROFILE_ZONE("parallel_for range");
+			function(begin, end, range_index);
+		});
+	}
+
+	{
+		PROFILE_ZONE("parallel_for range");
+		function(0, std::min(range_size, count), 0);
+	}
+	wait(counter);
+	return range_count;
+}
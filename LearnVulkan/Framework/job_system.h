@@ -0,0 +1,181 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <atomic>
+#include <array>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// Small jobs run by a fixed set of threads. Every thread owns a deque of jobs: it pushes and pops its own jobs at the bottom, last in first out so the data
+// it just touched is still in cache, while threads that run out of work steal from the top of other deques. Jobs are only ever moved by the thread that runs
+// out of work, so a busy system costs nothing in synchronisation beyond the owner's own deque.
+//
+// Completion is tracked with counters: every job run against a counter increments it and decrements it once finished. Waiting on a counter runs other jobs
+// until it reaches zero, so waiting never idles a thread, and jobs can be made to wait for a counter by running them after it.
+//
+// The thread that creates the system takes part as thread 0, but only runs jobs while it waits. Other long lived threads can be given a place the same way
+// with attach_current_thread, jobs run from any other thread run immediately on that thread.
+
+static constexpr std::size_t JOB_CAPACITY_PER_THREAD = 4096;
+
+// Captures up to this size are stored in the job itself, so running a job doesn't allocate.
+static constexpr std::size_t JOB_DATA_SIZE = 64;
+
+class JobCounter;
+
+struct alignas(64) Job {
+	void (*function)(Job& job) { nullptr };
+	JobCounter* counter{ nullptr };
+
+	// Jobs are allocated from a ring per thread, and a slot is only reused once the job in it has finished.
+	std::atomic<bool> finished{ true };
+
+	alignas(std::max_align_t) std::byte data[JOB_DATA_SIZE]{};
+};
+
+// The number of jobs run against it that haven't finished. A counter must not be destroyed while jobs are still run against it or wait for it,
+// waiting on it first makes sure of both.
+class JobCounter {
+public:
+	JobCounter() = default;
+	JobCounter(const JobCounter&) = delete;
+	JobCounter& operator=(const JobCounter&) = delete;
+
+	bool is_done() const { return pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	std::atomic<uint32_t> pending{ 0 };
+
+	// Taken when the count reaches zero and when a job is made to wait for the counter, so a job can't be added after the counter's waiters were released.
+	std::mutex mutex{};
+	std::vector<Job*> continuations{};
+};
+
+// Chase-Lev work stealing deque with a fixed capacity. Only the owning thread may push and pop, any thread may steal.
+class JobDeque {
+public:
+	// Returns false when full.
+	bool push(Job* job);
+	Job* pop();
+	Job* steal();
+
+private:
+	alignas(64) std::atomic<int64_t> top{ 0 };
+	alignas(64) std::atomic<int64_t> bottom{ 0 };
+	std::array<std::atomic<Job*>, JOB_CAPACITY_PER_THREAD> jobs{};
+};
+
+class JobSystem {
+public:
+	using RangeFunction = std::function<void(std::size_t begin, std::size_t end, std::size_t range_index)>;
+
+	// worker_count defaults to one less than the number of hardware threads, the creating thread makes up the difference.
+	// attached_thread_count reserves places for threads that call attach_current_thread.
+	explicit JobSystem(std::size_t worker_count = SIZE_MAX, std::size_t attached_thread_count = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	// Workers plus the creating thread and any attached threads.
+	std::size_t get_thread_count() const { return threads.size(); }
+
+	// Lets the calling thread submit jobs and run them while it waits, like the creating thread. Returns false if every reserved place is taken.
+	// A thread can only be attached to one system at a time, and must stop using it before the system is destroyed.
+	bool attach_current_thread();
+
+	// Runs the function as a job and counts it against the counter.
+	template<typename Function>
+	void run(JobCounter& counter, Function&& function) {
+		Job* job = create_job(counter, std::forward<Function>(function));
+		if (job != nullptr) {
+			submit(*job);
+		}
+	}
+
+	// As run, but the job only starts once dependency reaches zero.
+	template<typename Function>
+	void run_after(JobCounter& dependency, JobCounter& counter, Function&& function) {
+		Job* job = create_job(counter, std::forward<Function>(function));
+		if (job != nullptr) {
+			submit_after(dependency, *job);
+		}
+	}
+
+	// Runs jobs until the counter reaches zero.
+	void wait(JobCounter& counter);
+
+	// Splits [0, count) into at most one contiguous range per thread, each at least min_range_size long (except the last) and a multiple of range_alignment,
+	// runs them as jobs and returns once all have finished. Returns the number of ranges, range_index counts up from 0 in the order of the ranges.
+	std::size_t parallel_for(std::size_t count, std::size_t min_range_size, std::size_t range_alignment, const RangeFunction& function);
+
+private:
+	struct alignas(64) ThreadState {
+		JobDeque deque{};
+		std::unique_ptr<Job[]> jobs{ std::make_unique<Job[]>(JOB_CAPACITY_PER_THREAD) };
+		std::size_t next_job{ 0 };
+
+		// Where the next steal attempt starts, so thieves spread out over the other threads.
+		std::size_t next_victim{ 0 };
+	};
+
+	template<typename Function>
+	static void invoke_job(Job& job) {
+		Function& function = *std::launder(reinterpret_cast<Function*>(job.data));
+		function();
+		function.~Function();
+	}
+
+	// Returns nullptr, having already run the function, when called from a thread outside the system.
+	template<typename Function>
+	Job* create_job(JobCounter& counter, Function&& function) {
+		using StoredFunction = std::decay_t<Function>;
+		static_assert(sizeof(StoredFunction) <= JOB_DATA_SIZE, "Job captures too much, capture a pointer to the data instead.");
+		static_assert(alignof(StoredFunction) <= alignof(std::max_align_t));
+
+		ThreadState* state = get_thread_state();
+		if (state == nullptr) {
+			function();
+			return nullptr;
+		}
+
+		Job& job = allocate_job(*state);
+		new (job.data) StoredFunction(std::forward<Function>(function));
+		job.function = &invoke_job<StoredFunction>;
+		job.counter = &counter;
+		counter.pending.fetch_add(1, std::memory_order_relaxed);
+		return &job;
+	}
+
+	ThreadState* get_thread_state();
+	Job& allocate_job(ThreadState& state);
+	void submit(Job& job);
+	void submit_after(JobCounter& dependency, Job& job);
+	void execute(Job& job);
+	void finish(JobCounter& counter);
+	Job* find_job(ThreadState& state);
+	void run_worker(std::size_t thread_index);
+
+	// Index 0 belongs to the creating thread.
+	std::vector<std::unique_ptr<ThreadState>> threads{};
+	std::thread::id creating_thread{};
+	std::vector<std::jthread> workers{};
+	std::size_t first_attached_thread{ 0 };
+	std::atomic<std::size_t> attached_count{ 0 };
+
+	// Bumped for every submitted job, so a worker going to sleep can tell whether anything was submitted since it last looked.
+	std::atomic<uint64_t> submit_generation{ 0 };
+	std::atomic<uint32_t> sleeping_count{ 0 };
+	std::atomic<bool> stopping{ false };
+	std::mutex sleep_mutex{};
+	std::condition_variable work_ready{};
+};
@@ -0,0 +1,114 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "job_system_benchmark.h"
+#include "job_system.h"
+
+using BenchmarkClock = std::chrono::steady_clock;
+
+static constexpr std::size_t OVERHEAD_JOB_COUNT = 1 << 20;
+
+// Jobs are submitted and waited on in batches that fit the job ring, as a frame's worth of tasks would be.
+static constexpr std::size_t OVERHEAD_BATCH_SIZE = 1024;
+
+// The scaling workload is a two level tree of tasks, so submitting is spread over the threads the way nested work would be.
+static constexpr std::size_t SCALING_PARENT_COUNT = 256;
+static constexpr std::size_t SCALING_CHILD_COUNT = 256;
+static constexpr uint32_t SCALING_WORK_ITERATIONS = 500;
+
+static double get_elapsed_milliseconds(BenchmarkClock::time_point start) {
+	return std::chrono::duration<double, std::milli>(BenchmarkClock::now() - start).count();
+}
+
+// A few microseconds of arithmetic that the compiler can't remove or vectorise away.
+static float do_work(uint32_t seed) {
+	float value = static_cast<float>(seed);
+	for (uint32_t i = 0; i < SCALING_WORK_ITERATIONS; ++i) {
+		value = std::sqrt(value * 1.0001f + 1.0f);
+	}
+
+	return value;
+}
+
+// Nanoseconds per empty job, from submitting it to the counter it was run against reaching zero.
+static double measure_job_overhead(JobSystem& job_system) {
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	for (std::size_t batch = 0; batch < OVERHEAD_JOB_COUNT / OVERHEAD_BATCH_SIZE; ++batch) {
+		JobCounter counter{};
+		for (std::size_t i = 0; i < OVERHEAD_BATCH_SIZE; ++i) {
+			job_system.run(counter, []() {});
+		}
+
+		job_system.wait(counter);
+	}
+
+	return get_elapsed_milliseconds(start) * 1e6 / OVERHEAD_JOB_COUNT;
+}
+
+static double measure_workload(JobSystem& job_system, std::vector<float>& results) {
+	results.assign(SCALING_PARENT_COUNT * SCALING_CHILD_COUNT, 0.0f);
+	float* result_data = results.data();
+
+	BenchmarkClock::time_point start = BenchmarkClock::now();
+	JobCounter parents{};
+	for (std::size_t parent = 0; parent < SCALING_PARENT_COUNT; ++parent) {
+		job_system.run(parents, [&job_system, result_data, parent]() {
+			JobCounter children{};
+			for (std::size_t child = 0; child < SCALING_CHILD_COUNT; ++child) {
+				std::size_t index = parent * SCALING_CHILD_COUNT + child;
+				job_system.run(children, [result_data, index]() { result_data[index] = do_work(static_cast<uint32_t>(index)); });
+			}
+
+			job_system.wait(children);
+		});
+	}
+
+	job_system.wait(parents);
+	return get_elapsed_milliseconds(start);
+}
+
+void run_job_system_benchmark()
+{
+	std::size_t hardware_thread_count = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+	std::cout << std::fixed << std::setprecision(1) << "Job system benchmark, " << hardware_thread_count << " hardware threads\n";
+
+	{
+		JobSystem job_system(0);
+		std::cout << "Overhead per job, 1 thread: " << measure_job_overhead(job_system) << " ns\n";
+	}
+
+	{
+		JobSystem job_system{};
+		std::cout << "Overhead per job, " << job_system.get_thread_count() << " threads: " << measure_job_overhead(job_system) << " ns\n";
+	}
+
+	std::vector<std::size_t> thread_counts{};
+	for (std::size_t thread_count = 1; thread_count < hardware_thread_count; thread_count *= 2) {
+		thread_counts.push_back(thread_count);
+	}
+
+	thread_counts.push_back(hardware_thread_count);
+
+	std::cout << "Scaling, " << SCALING_PARENT_COUNT * SCALING_CHILD_COUNT << " jobs:\n";
+	std::vector<float> results{};
+	double single_thread_time = 0.0;
+	for (std::size_t thread_count : thread_counts) {
+		JobSystem job_system(thread_count - 1);
+
+		// The first run warms up the threads and caches, the best of the rest is kept.
+		double best_time = measure_workload(job_system, results);
+		for (int run = 0; run < 3; ++run) {
+			best_time = std::min(best_time, measure_workload(job_system, results));
+		}
+
+		if (thread_count == 1) {
+			single_thread_time = best_time;
+		}
+
+		std::cout << "  " << std::setw(3) << thread_count << " threads: " << std::setw(8) << best_time << " ms, speedup " << std::setprecision(2) << single_thread_time / best_time
+			<< std::setprecision(1) << '\n';
+	}
+}
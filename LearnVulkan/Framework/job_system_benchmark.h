@@ -0,0 +1,5 @@
+#pragma once
+
+// Measures what running a job costs beyond the work in it, and how well a job heavy workload scales from one thread up to every hardware thread.
+// Results are printed to stdout, run with --job-benchmark.
+void run_job_system_benchmark();
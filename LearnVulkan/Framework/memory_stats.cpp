@@ -0,0 +1,203 @@
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include "memory_stats.h"
+#include "error.h"
+
+static MemoryStats memory_stats{};
+
+const char* get_memory_tag_name(MemoryTag tag)
+{
+	switch (tag) {
+	case MemoryTag::Other: return "other";
+	case MemoryTag::Mesh: return "mesh";
+	case MemoryTag::Texture: return "texture";
+	case MemoryTag::Uniform: return "uniform";
+	case MemoryTag::Staging: return "staging";
+	case MemoryTag::Depth: return "depth";
+	case MemoryTag::AllocatorBlock: return "allocator_block";
+	case MemoryTag::Instance: return "instance";
+	case MemoryTag::RenderTarget: return "render_target";
+	default: return "unknown";
+	}
+}
+
+void init_memory_stats(VkPhysicalDevice physical_device)
+{
+	memory_stats = MemoryStats{};
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_stats.memory_properties);
+}
+
+const MemoryStats& get_memory_stats()
+{
+	return memory_stats;
+}
+
+static void add_usage(MemoryUsage& usage, VkDeviceSize size) {
+	usage.live_bytes += size;
+	usage.peak_bytes = std::max(usage.peak_bytes, usage.live_bytes);
+	++usage.live_allocations;
+	++usage.total_allocations;
+	usage.total_allocated_bytes += size;
+}
+
+static void remove_usage(MemoryUsage& usage, VkDeviceSize size) {
+	usage.live_bytes -= size;
+	--usage.live_allocations;
+}
+
+VkResult allocate_device_memory(VkDevice device, const VkMemoryAllocateInfo& alloc_info, VkDeviceMemory& out_memory)
+{
+	VkResult result = vkAllocateMemory(device, &alloc_info, nullptr, &out_memory);
+	if (result != VK_SUCCESS) {
+		return result;
+	}
+
+	TrackedAllocation allocation{};
+	allocation.size = alloc_info.allocationSize;
+	allocation.heap_index = memory_stats.memory_properties.memoryTypes[alloc_info.memoryTypeIndex].heapIndex;
+	allocation.tag = memory_stats.current_tag;
+	allocation.allocation_number = memory_stats.total.total_allocations;
+
+	add_usage(memory_stats.total, allocation.size);
+	add_usage(memory_stats.by_tag[static_cast<std::size_t>(allocation.tag)], allocation.size);
+	add_usage(memory_stats.by_heap[allocation.heap_index], allocation.size);
+	memory_stats.live_allocations[out_memory] = allocation;
+	return result;
+}
+
+void free_device_memory(VkDevice device, VkDeviceMemory memory)
+{
+	if (memory == VK_NULL_HANDLE) {
+		return;
+	}
+
+	auto tracked = memory_stats.live_allocations.find(memory);
+	if (tracked != memory_stats.live_allocations.end()) {
+		const TrackedAllocation& allocation = tracked->second;
+		remove_usage(memory_stats.total, allocation.size);
+		remove_usage(memory_stats.by_tag[static_cast<std::size_t>(allocation.tag)], allocation.size);
+		remove_usage(memory_stats.by_heap[allocation.heap_index], allocation.size);
+		memory_stats.live_allocations.erase(tracked);
+	}
+	else {
+		log_error("Freeing device memory that wasn't allocated through allocate_device_memory");
+	}
+
+	vkFreeMemory(device, memory, nullptr);
+}
+
+MemoryTagScope::MemoryTagScope(MemoryTag tag) : previous_tag(memory_stats.current_tag)
+{
+	memory_stats.current_tag = tag;
+}
+
+MemoryTagScope::~MemoryTagScope()
+{
+	memory_stats.current_tag = previous_tag;
+}
+
+static void write_usage(std::ostream& out, const MemoryUsage& usage) {
+	out << "{ \"live_bytes\": " << usage.live_bytes
+		<< ", \"peak_bytes\": " << usage.peak_bytes
+		<< ", \"live_allocations\": " << usage.live_allocations
+		<< ", \"total_allocations\": " << usage.total_allocations
+		<< ", \"total_allocated_bytes\": " << usage.total_allocated_bytes << " }";
+}
+
+std::string get_memory_report(const GpuAllocator* allocator)
+{
+	double elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - memory_stats.start_time).count();
+	double rate_divisor = std::max(elapsed_seconds, 1e-6);
+
+	std::ostringstream out;
+	out << "{\n";
+	out << "\t\"elapsed_seconds\": " << elapsed_seconds << ",\n";
+	out << "\t\"allocations_per_second\": " << memory_stats.total.total_allocations / rate_divisor << ",\n";
+	out << "\t\"allocated_bytes_per_second\": " << memory_stats.total.total_allocated_bytes / rate_divisor << ",\n";
+
+	if (allocator != nullptr) {
+		out << "\t\"fragmentation\": " << get_fragmentation(*allocator) << ",\n";
+		out << "\t\"allocator_blocks\": [\n";
+		bool first_block = true;
+		for (std::size_t i = 0; i < allocator->blocks.size(); ++i) {
+			const MemoryBlock& block = allocator->blocks[i];
+			if (block.memory == VK_NULL_HANDLE) {
+				continue;
+			}
+
+			out << (first_block ? "" : ",\n")
+				<< "\t\t{ \"block\": " << i
+				<< ", \"kind\": \"" << (block.kind == GpuResourceKind::Buffer ? "buffer" : "image")
+				<< "\", \"memory_type\": " << block.memory_type
+				<< ", \"size\": " << block.size
+				<< ", \"used\": " << block.used
+				<< ", \"free_ranges\": " << block.free_ranges.size()
+				<< ", \"fragmentation\": " << get_block_fragmentation(block) << " }";
+			first_block = false;
+		}
+		out << (first_block ? "" : "\n") << "\t],\n";
+	}
+
+	out << "\t\"total\": ";
+	write_usage(out, memory_stats.total);
+	out << ",\n";
+
+	out << "\t\"tags\": {\n";
+	for (std::size_t i = 0; i < memory_stats.by_tag.size(); ++i) {
+		out << "\t\t\"" << get_memory_tag_name(static_cast<MemoryTag>(i)) << "\": ";
+		write_usage(out, memory_stats.by_tag[i]);
+		out << (i + 1 < memory_stats.by_tag.size() ? ",\n" : "\n");
+	}
+	out << "\t},\n";
+
+	out << "\t\"heaps\": [\n";
+	const VkPhysicalDeviceMemoryProperties& memory_properties = memory_stats.memory_properties;
+	for (uint32_t i = 0; i < memory_properties.memoryHeapCount; ++i) {
+		const VkMemoryHeap& heap = memory_properties.memoryHeaps[i];
+		out << "\t\t{ \"index\": " << i
+			<< ", \"size\": " << heap.size
+			<< ", \"device_local\": " << ((heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? "true" : "false")
+			<< ", \"usage\": ";
+		write_usage(out, memory_stats.by_heap[i]);
+		out << (i + 1 < memory_properties.memoryHeapCount ? " },\n" : " }\n");
+	}
+	out << "\t],\n";
+
+	// Sorted by when they were allocated so the report is stable between runs.
+	std::vector<TrackedAllocation> live_allocations{};
+	live_allocations.reserve(memory_stats.live_allocations.size());
+	for (const auto& [memory, allocation] : memory_stats.live_allocations) {
+		live_allocations.push_back(allocation);
+	}
+
+	std::sort(live_allocations.begin(), live_allocations.end(), [](const TrackedAllocation& a, const TrackedAllocation& b) {
+		return a.allocation_number < b.allocation_number;
+	});
+
+	out << "\t\"live_allocations\": [\n";
+	for (std::size_t i = 0; i < live_allocations.size(); ++i) {
+		const TrackedAllocation& allocation = live_allocations[i];
+		out << "\t\t{ \"allocation\": " << allocation.allocation_number
+			<< ", \"tag\": \"" << get_memory_tag_name(allocation.tag)
+			<< "\", \"heap\": " << allocation.heap_index
+			<< ", \"size\": " << allocation.size
+			<< (i + 1 < live_allocations.size() ? " },\n" : " }\n");
+	}
+	out << "\t]\n";
+	out << "}\n";
+	return out.str();
+}
+
+bool write_memory_report(const char* file_path, const GpuAllocator* allocator)
+{
+	std::ofstream file(file_path, std::ios::trunc);
+	if (!file.is_open()) {
+		log_error("Failed to open memory report file ", file_path);
+		return false;
+	}
+
+	file << get_memory_report(allocator);
+	return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <array>
+#include <string>
+#include <chrono>
+#include <unordered_map>
+#include "allocator.h"
+
+// Every vkAllocateMemory/vkFreeMemory in the framework goes through allocate_device_memory/free_device_memory, so the totals here cover all device memory we own.
+// Allocations are tagged with whatever MemoryTagScope is active when they are made, so the functions creating buffers and images don't need an extra parameter.
+
+enum class MemoryTag : uint8_t {
+	Other,
+	Mesh,
+	Texture,
+	Uniform,
+	Staging,
+	Depth,
+	AllocatorBlock,
+	Instance,
+	RenderTarget,
+	Count,
+};
+
+const char* get_memory_tag_name(MemoryTag tag);
+
+struct MemoryUsage {
+	VkDeviceSize live_bytes{ 0 };
+	VkDeviceSize peak_bytes{ 0 };
+	uint64_t live_allocations{ 0 };
+	uint64_t total_allocations{ 0 };
+	VkDeviceSize total_allocated_bytes{ 0 };
+};
+
+struct TrackedAllocation {
+	VkDeviceSize size{ 0 };
+	uint32_t heap_index{ 0 };
+	MemoryTag tag{ MemoryTag::Other };
+	uint64_t allocation_number{ 0 };
+};
+
+struct MemoryStats {
+	VkPhysicalDeviceMemoryProperties memory_properties{};
+	std::chrono::steady_clock::time_point start_time{ std::chrono::steady_clock::now() };
+
+	MemoryUsage total{};
+	std::array<MemoryUsage, static_cast<std::size_t>(MemoryTag::Count)> by_tag{};
+	std::array<MemoryUsage, VK_MAX_MEMORY_HEAPS> by_heap{};
+	std::unordered_map<VkDeviceMemory, TrackedAllocation> live_allocations{};
+
+	MemoryTag current_tag{ MemoryTag::Other };
+};
+
+// Must be called before any device memory is allocated, so allocations can be attributed to heaps.
+void init_memory_stats(VkPhysicalDevice physical_device);
+const MemoryStats& get_memory_stats();
+
+VkResult allocate_device_memory(VkDevice device, const VkMemoryAllocateInfo& alloc_info, VkDeviceMemory& out_memory);
+void free_device_memory(VkDevice device, VkDeviceMemory memory);
+
+class MemoryTagScope {
+public:
+	explicit MemoryTagScope(MemoryTag tag);
+	~MemoryTagScope();
+
+	MemoryTagScope(const MemoryTagScope&) = delete;
+	MemoryTagScope& operator=(const MemoryTagScope&) = delete;
+
+private:
+	MemoryTag previous_tag;
+};
+
+// Live totals, peaks, allocation rate and every allocation still alive. Anything listed once the framework has torn down is a leak.
+// Fragmentation, overall and for each of the allocator's blocks, is taken from its free lists when one is given.
+std::string get_memory_report(const GpuAllocator* allocator = nullptr);
+bool write_memory_report(const char* file_path, const GpuAllocator* allocator = nullptr);
@@ -1,10 +1,17 @@
+#include <cmath>
+#include <algorithm>
+#include <fstream>
+#include <filesystem>
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "tiny_obj_loader.h"
 #include "error.h"
 #include "mesh.h"
+#include "cpu_profiler.h"
 
 std::optional<Mesh> load_mesh(const char* file_path)
 {
+	PROFILE_FUNCTION();
+
 	Mesh mesh;
 
     tinyobj::attrib_t attrib;
@@ -45,3 +52,97 @@ std::optional<Mesh> load_mesh(const char* file_path)
 
 	return mesh;
 }
+
+// A cooked mesh is only reused when it was written by this version of the cooker, is complete, and is newer than the obj it came from.
+static bool is_cooked_mesh_current(const char* source_path, const char* cooked_path)
+{
+	std::error_code error{};
+	auto cooked_time = std::filesystem::last_write_time(cooked_path, error);
+	if (error) {
+		return false;
+	}
+
+	auto source_time = std::filesystem::last_write_time(source_path, error);
+	if (!error && source_time > cooked_time) {
+		return false;
+	}
+
+	std::ifstream file(cooked_path, std::ios::binary);
+	CookedMeshHeader header{};
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != COOKED_MESH_MAGIC || header.version != COOKED_MESH_VERSION) {
+		return false;
+	}
+
+	uintmax_t expected_size = sizeof(CookedMeshHeader) + uintmax_t{ header.vertex_count } * sizeof(Vertex) + uintmax_t{ header.index_count } * sizeof(uint32_t);
+	return std::filesystem::file_size(cooked_path, error) == expected_size && !error;
+}
+
+bool cook_mesh(const char* source_path, const char* cooked_path)
+{
+	PROFILE_FUNCTION();
+
+	if (is_cooked_mesh_current(source_path, cooked_path)) {
+		return true;
+	}
+
+	std::optional<Mesh> mesh = load_mesh(source_path);
+	if (!mesh) {
+		return false;
+	}
+
+	CookedMeshHeader header{};
+	header.vertex_count = static_cast<uint32_t>(mesh->vertices.size());
+	header.index_count = static_cast<uint32_t>(mesh->indices.size());
+	header.bounding_sphere = get_bounding_sphere(*mesh);
+	header.bounding_box = get_bounding_box(*mesh);
+
+	// Write next to the final path and rename over it, so a cook that is cut short never leaves a truncated mesh behind.
+	std::string temporary_path = std::string(cooked_path) + ".tmp";
+	std::ofstream file(temporary_path, std::ios::binary);
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(mesh->vertices.data()), mesh->vertices.size() * sizeof(Vertex));
+	file.write(reinterpret_cast<const char*>(mesh->indices.data()), mesh->indices.size() * sizeof(uint32_t));
+	file.close();
+
+	std::error_code error{};
+	if (!file) {
+		log_error("Failed to write cooked mesh ", cooked_path);
+		std::filesystem::remove(temporary_path, error);
+		return false;
+	}
+
+	std::filesystem::rename(temporary_path, cooked_path, error);
+	if (error) {
+		log_error("Failed to replace cooked mesh ", cooked_path, ": ", error.message());
+		std::filesystem::remove(temporary_path, error);
+		return false;
+	}
+
+	return true;
+}
+
+Aabb get_bounding_box(const Mesh& mesh)
+{
+	Aabb bounding_box{};
+	for (const Vertex& vertex : mesh.vertices) {
+		grow_aabb(bounding_box, vertex.pos);
+	}
+
+	return bounding_box;
+}
+
+glm::vec4 get_bounding_sphere(const Mesh& mesh)
+{
+	if (mesh.vertices.empty()) {
+		return glm::vec4(0.0f);
+	}
+
+	glm::vec3 centre = get_aabb_centre(get_bounding_box(mesh));
+	float radius_squared = 0.0f;
+	for (const Vertex& vertex : mesh.vertices) {
+		glm::vec3 offset = vertex.pos - centre;
+		radius_squared = std::max(radius_squared, glm::dot(offset, offset));
+	}
+
+	return glm::vec4(centre, std::sqrt(radius_squared));
+}
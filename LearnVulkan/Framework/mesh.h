@@ -1,6 +1,7 @@
 #pragma once
 #include <glm/glm.hpp>
 #include <optional>
+#include "aabb.h"
 
 struct Vertex {
 	glm::vec3 pos;
@@ -13,4 +14,26 @@ struct Mesh {
 	std::vector<uint32_t> indices;
 };
 
-std::optional<Mesh> load_mesh(const char* file_path);
\ No newline at end of file
+std::optional<Mesh> load_mesh(const char* file_path);
+
+static constexpr uint32_t COOKED_MESH_MAGIC = 0x48534d43;
+static constexpr uint32_t COOKED_MESH_VERSION = 1;
+
+// A cooked mesh is stored exactly the way the mesh pool stores it, so loading one is a copy rather than a parse.
+// The header is followed by vertex_count vertices and then index_count indices. The bounds are precomputed so the vertices never have to be read on the CPU.
+struct CookedMeshHeader {
+	uint32_t magic{ COOKED_MESH_MAGIC };
+	uint32_t version{ COOKED_MESH_VERSION };
+	uint32_t vertex_count{ 0 };
+	uint32_t index_count{ 0 };
+	glm::vec4 bounding_sphere{ 0.0f };
+	Aabb bounding_box{};
+};
+
+// Parses the obj at source_path and writes it to cooked_path, unless cooked_path already holds a complete mesh of the current version that is newer than the obj.
+bool cook_mesh(const char* source_path, const char* cooked_path);
+
+Aabb get_bounding_box(const Mesh& mesh);
+
+// Centre in xyz and radius in w, in the mesh's local space. Centred on the bounding box rather than being the tightest sphere, which is good enough for culling.
+glm::vec4 get_bounding_sphere(const Mesh& mesh);
\ No newline at end of file
@@ -0,0 +1,184 @@
+#include <cstring>
+#include "mesh_pool.h"
+#include "cpu_profiler.h"
+#include "buffer.h"
+#include "host_memory.h"
+#include "error.h"
+
+MeshPool create_mesh_pool(GpuAllocator& allocator, std::size_t vertex_capacity, std::size_t index_capacity)
+{
+	MeshPool mesh_pool{};
+	bool upload_directly = should_upload_buffer_directly(allocator.physical_device);
+	VkMemoryPropertyFlags memory_flags = upload_directly ? DIRECT_UPLOAD_MEMORY_FLAGS : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	mesh_pool.vertex_allocation = create_allocated_buffer(allocator, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, memory_flags, vertex_capacity * sizeof(Vertex));
+	mesh_pool.index_allocation = create_allocated_buffer(allocator, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, memory_flags, index_capacity * sizeof(uint32_t));
+	if (mesh_pool.vertex_allocation == INVALID_GPU_RESOURCE || mesh_pool.index_allocation == INVALID_GPU_RESOURCE) {
+		log_error("Failed to allocate mesh pool buffers");
+		destroy_mesh_pool(allocator, mesh_pool);
+		return mesh_pool;
+	}
+
+	update_mesh_pool_buffers(allocator, mesh_pool);
+	if (upload_directly) {
+		mesh_pool.mapped_vertices = static_cast<uint8_t*>(map_allocated_resource(allocator, mesh_pool.vertex_allocation));
+		mesh_pool.mapped_indices = static_cast<uint8_t*>(map_allocated_resource(allocator, mesh_pool.index_allocation));
+	}
+
+	mesh_pool.free_vertex_ranges.push_back({ 0, vertex_capacity });
+	mesh_pool.free_index_ranges.push_back({ 0, index_capacity });
+	return mesh_pool;
+}
+
+void destroy_mesh_pool(GpuAllocator& allocator, MeshPool& mesh_pool)
+{
+	if (mesh_pool.vertex_allocation != INVALID_GPU_RESOURCE) {
+		destroy_allocated_resource(allocator, mesh_pool.vertex_allocation);
+	}
+
+	if (mesh_pool.index_allocation != INVALID_GPU_RESOURCE) {
+		destroy_allocated_resource(allocator, mesh_pool.index_allocation);
+	}
+
+	mesh_pool = MeshPool{};
+}
+
+void update_mesh_pool_buffers(const GpuAllocator& allocator, MeshPool& mesh_pool)
+{
+	mesh_pool.vertex_buffer = get_allocated_resource(allocator, mesh_pool.vertex_allocation).buffer;
+	mesh_pool.index_buffer = get_allocated_resource(allocator, mesh_pool.index_allocation).buffer;
+}
+
+template<typename T>
+static void upload_range(VkDevice device, VkPhysicalDevice physical_device, TransientCommandPool& transient_pool, VkBuffer destination, uint8_t* mapped_destination, VkDeviceSize first_element, std::span<const T> data) {
+	// The range was free, so nothing in flight can be reading it, and coherent host writes are visible to any later submission.
+	if (mapped_destination != nullptr) {
+		std::memcpy(mapped_destination + first_element * sizeof(T), data.data(), data.size_bytes());
+		return;
+	}
+
+	auto [staging_buffer, staging_memory] = create_staging_buffer<T>(device, physical_device, data);
+	submit_staged_buffer_copy(transient_pool, staging_buffer, staging_memory, destination, data.size_bytes(), first_element * sizeof(T));
+}
+
+static std::optional<MeshRange> allocate_mesh_range(MeshPool& mesh_pool, std::size_t vertex_count, std::size_t index_count) {
+	std::optional<VkDeviceSize> vertex_offset = allocate_range(mesh_pool.free_vertex_ranges, vertex_count, 1);
+	if (!vertex_offset) {
+		log_error("Mesh pool is out of vertex space, requested ", vertex_count, " vertices");
+		return std::nullopt;
+	}
+
+	std::optional<VkDeviceSize> first_index = allocate_range(mesh_pool.free_index_ranges, index_count, 1);
+	if (!first_index) {
+		log_error("Mesh pool is out of index space, requested ", index_count, " indices");
+		free_range(mesh_pool.free_vertex_ranges, *vertex_offset, vertex_count);
+		return std::nullopt;
+	}
+
+	MeshRange mesh_range{};
+	mesh_range.vertex_offset = static_cast<int32_t>(*vertex_offset);
+	mesh_range.vertex_count = static_cast<uint32_t>(vertex_count);
+	mesh_range.first_index = static_cast<uint32_t>(*first_index);
+	mesh_range.index_count = static_cast<uint32_t>(index_count);
+	return mesh_range;
+}
+
+MeshRange add_mesh(VkDevice device, VkPhysicalDevice physical_device, TransientCommandPool& transient_pool, MeshPool& mesh_pool, const Mesh& mesh)
+{
+	PROFILE_FUNCTION();
+
+	std::optional<MeshRange> mesh_range = allocate_mesh_range(mesh_pool, mesh.vertices.size(), mesh.indices.size());
+	if (!mesh_range) {
+		return {};
+	}
+
+	// Indices stay relative to the start of the mesh, the vertex offset is added by the draw call.
+	upload_range<Vertex>(device, physical_device, transient_pool, mesh_pool.vertex_buffer, mesh_pool.mapped_vertices, mesh_range->vertex_offset, mesh.vertices);
+	upload_range<uint32_t>(device, physical_device, transient_pool, mesh_pool.index_buffer, mesh_pool.mapped_indices, mesh_range->first_index, mesh.indices);
+	return *mesh_range;
+}
+
+MeshRange add_cooked_mesh(VkDevice device, VkPhysicalDevice physical_device, const DeviceDetails& device_details, TransientCommandPool& transient_pool, MeshPool& mesh_pool, const char* file_path, CookedMeshHeader& out_header)
+{
+	PROFILE_FUNCTION();
+
+	std::optional<MappedFile> mapped_file = map_file(file_path);
+	if (!mapped_file) {
+		return {};
+	}
+
+	const uint8_t* file_data = static_cast<const uint8_t*>(mapped_file->data);
+	if (mapped_file->size >= sizeof(CookedMeshHeader)) {
+		std::memcpy(&out_header, file_data, sizeof(CookedMeshHeader));
+	}
+
+	std::size_t vertices_size = static_cast<std::size_t>(out_header.vertex_count) * sizeof(Vertex);
+	std::size_t indices_size = static_cast<std::size_t>(out_header.index_count) * sizeof(uint32_t);
+	if (mapped_file->size < sizeof(CookedMeshHeader) || out_header.magic != COOKED_MESH_MAGIC || out_header.version != COOKED_MESH_VERSION
+		|| mapped_file->size != sizeof(CookedMeshHeader) + vertices_size + indices_size) {
+		log_error("Invalid cooked mesh ", file_path);
+		unmap_file(*mapped_file);
+		return {};
+	}
+
+	std::optional<MeshRange> mesh_range = allocate_mesh_range(mesh_pool, out_header.vertex_count, out_header.index_count);
+	if (!mesh_range) {
+		unmap_file(*mapped_file);
+		return {};
+	}
+
+	VkDeviceSize vertices_offset = sizeof(CookedMeshHeader);
+	VkDeviceSize indices_offset = vertices_offset + vertices_size;
+	VkDeviceSize vertex_destination = static_cast<VkDeviceSize>(mesh_range->vertex_offset) * sizeof(Vertex);
+	VkDeviceSize index_destination = static_cast<VkDeviceSize>(mesh_range->first_index) * sizeof(uint32_t);
+	if (mesh_pool.mapped_vertices != nullptr) {
+		std::memcpy(mesh_pool.mapped_vertices + vertex_destination, file_data + vertices_offset, vertices_size);
+		std::memcpy(mesh_pool.mapped_indices + index_destination, file_data + indices_offset, indices_size);
+	}
+	else {
+		ImportedFile imported_file = import_mapped_file(device, physical_device, device_details, *mapped_file);
+		TransientCommandBuffer& transient_commands = begin_transient_commands(transient_pool);
+		record_imported_file_copy(transient_commands.command_buffer, imported_file, vertices_offset, mesh_pool.vertex_buffer, vertex_destination, vertices_size);
+		record_imported_file_copy(transient_commands.command_buffer, imported_file, indices_offset, mesh_pool.index_buffer, index_destination, indices_size);
+
+		// The mapping has to outlive the copy, so this is the one upload that does wait.
+		submit_transient_commands(transient_pool, transient_commands, true);
+		destroy_imported_file(device, imported_file);
+	}
+
+	unmap_file(*mapped_file);
+	return *mesh_range;
+}
+
+void remove_mesh(MeshPool& mesh_pool, const MeshRange& mesh_range)
+{
+	if (mesh_range.vertex_count > 0) {
+		free_range(mesh_pool.free_vertex_ranges, static_cast<VkDeviceSize>(mesh_range.vertex_offset), mesh_range.vertex_count);
+	}
+
+	if (mesh_range.index_count > 0) {
+		free_range(mesh_pool.free_index_ranges, mesh_range.first_index, mesh_range.index_count);
+	}
+}
+
+void bind_mesh_pool(VkCommandBuffer command_buffer, const MeshPool& mesh_pool)
+{
+	VkDeviceSize offset = 0;
+	vkCmdBindVertexBuffers(command_buffer, 0, 1, &mesh_pool.vertex_buffer, &offset);
+	vkCmdBindIndexBuffer(command_buffer, mesh_pool.index_buffer, 0, VK_INDEX_TYPE_UINT32);
+}
+
+void draw_mesh(VkCommandBuffer command_buffer, const MeshRange& mesh_range, uint32_t instance_count, uint32_t first_instance)
+{
+	vkCmdDrawIndexed(command_buffer, mesh_range.index_count, instance_count, mesh_range.first_index, mesh_range.vertex_offset, first_instance);
+}
+
+VkDrawIndexedIndirectCommand get_indirect_draw_command(const MeshRange& mesh_range, uint32_t instance_count, uint32_t first_instance)
+{
+	VkDrawIndexedIndirectCommand command{};
+	command.indexCount = mesh_range.index_count;
+	command.instanceCount = instance_count;
+	command.firstIndex = mesh_range.first_index;
+	command.vertexOffset = mesh_range.vertex_offset;
+	command.firstInstance = first_instance;
+	return command;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <vector>
+#include "mesh.h"
+#include "allocator.h"
+#include "command.h"
+#include "physical_device.h"
+
+// All meshes share one large vertex buffer and one large index buffer. Each mesh occupies a range of both, so drawing any number of meshes only needs
+// the buffers to be bound once, and the ranges can be written straight into VkDrawIndexedIndirectCommand records for multi-draw indirect.
+
+static constexpr std::size_t DEFAULT_MESH_POOL_VERTEX_CAPACITY = 1 << 20;
+static constexpr std::size_t DEFAULT_MESH_POOL_INDEX_CAPACITY = 1 << 22;
+
+struct MeshRange {
+	int32_t vertex_offset{ 0 };
+	uint32_t vertex_count{ 0 };
+	uint32_t first_index{ 0 };
+	uint32_t index_count{ 0 };
+};
+
+struct MeshPool {
+	// Both buffers are sub-allocated and can be moved by the defragmenter, the handles below are refreshed by update_mesh_pool_buffers.
+	GpuResourceHandle vertex_allocation{ INVALID_GPU_RESOURCE };
+	GpuResourceHandle index_allocation{ INVALID_GPU_RESOURCE };
+	VkBuffer vertex_buffer{ VK_NULL_HANDLE };
+	VkBuffer index_buffer{ VK_NULL_HANDLE };
+
+	// Set when the pool lives in device local memory the host can write to, see should_upload_buffer_directly. Meshes are then copied straight into place.
+	uint8_t* mapped_vertices{ nullptr };
+	uint8_t* mapped_indices{ nullptr };
+
+	// Free ranges are measured in vertices and indices rather than bytes.
+	std::vector<MemoryRange> free_vertex_ranges{};
+	std::vector<MemoryRange> free_index_ranges{};
+};
+
+MeshPool create_mesh_pool(GpuAllocator& allocator, std::size_t vertex_capacity = DEFAULT_MESH_POOL_VERTEX_CAPACITY, std::size_t index_capacity = DEFAULT_MESH_POOL_INDEX_CAPACITY);
+void destroy_mesh_pool(GpuAllocator& allocator, MeshPool& mesh_pool);
+
+// Call once the defragmenter has moved either buffer. Commands recorded with the old buffers must be recorded again.
+void update_mesh_pool_buffers(const GpuAllocator& allocator, MeshPool& mesh_pool);
+
+// Copies the mesh into free ranges of the pool. Returns an empty range if the pool is full.
+MeshRange add_mesh(VkDevice device, VkPhysicalDevice physical_device, TransientCommandPool& transient_pool, MeshPool& mesh_pool, const Mesh& mesh);
+// As add_mesh, for a mesh written by cook_mesh. The file is memory mapped and the GPU copies out of it, see import_mapped_file,
+// or it is copied straight into the pool when the pool is host visible. out_header is filled in from the file.
+MeshRange add_cooked_mesh(VkDevice device, VkPhysicalDevice physical_device, const DeviceDetails& device_details, TransientCommandPool& transient_pool, MeshPool& mesh_pool, const char* file_path, CookedMeshHeader& out_header);
+void remove_mesh(MeshPool& mesh_pool, const MeshRange& mesh_range);
+
+void bind_mesh_pool(VkCommandBuffer command_buffer, const MeshPool& mesh_pool);
+void draw_mesh(VkCommandBuffer command_buffer, const MeshRange& mesh_range, uint32_t instance_count = 1, uint32_t first_instance = 0);
+VkDrawIndexedIndirectCommand get_indirect_draw_command(const MeshRange& mesh_range, uint32_t instance_count = 1, uint32_t first_instance = 0);
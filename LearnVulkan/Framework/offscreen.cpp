@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include "offscreen.h"
+#include "buffer.h"
+#include "error.h"
+#include "memory_stats.h"
+
+// The same format create_swapchain prefers, every implementation supports rendering to it.
+static constexpr VkFormat OFFSCREEN_FORMAT = VK_FORMAT_B8G8R8A8_SRGB;
+
+OffscreenImages create_offscreen_images(VkDevice device, VkPhysicalDevice physical_device, DeletionQueue& deletion_queue, VkExtent2D extent, uint32_t image_count, SwapchainImages& out_images)
+{
+	MemoryTagScope tag_scope{ MemoryTag::RenderTarget };
+	OffscreenImages offscreen_images{};
+	out_images.format = OFFSCREEN_FORMAT;
+	out_images.extent = extent;
+	out_images.images.clear();
+
+	for (uint32_t i = 0; i < std::max(image_count, 1u); ++i) {
+		auto [image, memory] = create_image(device, physical_device, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, OFFSCREEN_FORMAT, VK_IMAGE_TILING_OPTIMAL, extent.width, extent.height);
+		offscreen_images.images.emplace_back(deletion_queue, image, memory);
+		out_images.images.push_back(image);
+	}
+
+	return offscreen_images;
+}
+
+uint32_t acquire_offscreen_image(OffscreenImages& offscreen_images)
+{
+	uint32_t image_index = offscreen_images.next_image;
+	offscreen_images.next_image = (offscreen_images.next_image + 1) % static_cast<uint32_t>(offscreen_images.images.size());
+	return image_index;
+}
+
+bool write_offscreen_image(VkDevice device, VkPhysicalDevice physical_device, TransientCommandPool& transient_pool, const SwapchainImages& images, uint32_t image_index, const char* path)
+{
+	VkExtent2D extent = images.extent;
+	VkDeviceSize size = static_cast<VkDeviceSize>(extent.width) * extent.height * 4;
+
+	MemoryTagScope tag_scope{ MemoryTag::Staging };
+	auto [buffer, memory] = create_buffer(device, physical_device, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, static_cast<std::size_t>(size));
+	if (memory == VK_NULL_HANDLE) {
+		vkDestroyBuffer(device, buffer, nullptr);
+		return false;
+	}
+
+	TransientCommandBuffer& transient_commands = begin_transient_commands(transient_pool);
+	VkCommandBuffer command_buffer = transient_commands.command_buffer;
+
+	// The render pass has already moved the image to the transfer layout, but the color writes still have to be made visible to the copy.
+	std::array<ImageTransition, 1> transitions{ {
+		{ images.images[image_index], VK_IMAGE_ASPECT_COLOR_BIT, OFFSCREEN_FINAL_LAYOUT, OFFSCREEN_FINAL_LAYOUT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT },
+	} };
+	record_image_transitions(command_buffer, transitions, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = 0;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { extent.width, extent.height, 1 };
+	vkCmdCopyImageToBuffer(command_buffer, images.images[image_index], OFFSCREEN_FINAL_LAYOUT, buffer, 1, &region);
+
+	// Waiting on the fence doesn't make the copied data visible to the host by itself.
+	VkMemoryBarrier host_barrier{};
+	host_barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+	host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &host_barrier, 0, nullptr, 0, nullptr);
+
+	submit_transient_commands(transient_pool, transient_commands, true);
+
+	void* mapped_region = nullptr;
+	vkMapMemory(device, memory, 0, size, 0, &mapped_region);
+	const uint8_t* pixels = static_cast<const uint8_t*>(mapped_region);
+
+	// PPM is plain RGB, the alpha is dropped and BGRA swizzled.
+	bool bgra = images.format == VK_FORMAT_B8G8R8A8_SRGB || images.format == VK_FORMAT_B8G8R8A8_UNORM;
+	std::ofstream file(path, std::ios::binary);
+	if (file) {
+		file << "P6\n" << extent.width << ' ' << extent.height << "\n255\n";
+
+		std::vector<char> row(static_cast<std::size_t>(extent.width) * 3);
+		for (uint32_t y = 0; y < extent.height; ++y) {
+			const uint8_t* source = pixels + static_cast<std::size_t>(y) * extent.width * 4;
+			for (uint32_t x = 0; x < extent.width; ++x) {
+				row[x * 3 + 0] = static_cast<char>(source[x * 4 + (bgra ? 2 : 0)]);
+				row[x * 3 + 1] = static_cast<char>(source[x * 4 + 1]);
+				row[x * 3 + 2] = static_cast<char>(source[x * 4 + (bgra ? 0 : 2)]);
+			}
+
+			file.write(row.data(), static_cast<std::streamsize>(row.size()));
+		}
+	}
+	else {
+		log_error("Failed to open ", path, " to write the rendered image");
+	}
+
+	vkUnmapMemory(device, memory);
+	vkDestroyBuffer(device, buffer, nullptr);
+	free_device_memory(device, memory);
+	return static_cast<bool>(file);
+}
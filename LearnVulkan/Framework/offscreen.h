@@ -0,0 +1,32 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <vector>
+#include "swapchain.h"
+#include "command.h"
+#include "deletion_queue.h"
+
+// Stands in for the swapchain when rendering without a window. Frames render into a fixed ring of color images in turn and nothing is presented,
+// so no surface, present queue or VK_KHR_swapchain is needed and the frame rate is bound only by the device. This is what lets the renderer run on
+// machines without a display, against a software implementation like lavapipe.
+//
+// The render pass leaves the images ready to be copied from, see OFFSCREEN_FINAL_LAYOUT.
+
+static constexpr VkImageLayout OFFSCREEN_FINAL_LAYOUT = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+struct OffscreenImages {
+	std::vector<UniqueImage> images{};
+	uint32_t next_image{ 0 };
+};
+
+// Fills out_images the way create_swapchain does, so the render targets and everything else sized to the swapchain are created the same way.
+// image_count is raised to at least one.
+OffscreenImages create_offscreen_images(VkDevice device, VkPhysicalDevice physical_device, DeletionQueue& deletion_queue, VkExtent2D extent, uint32_t image_count, SwapchainImages& out_images);
+
+// Takes the place of acquiring a swapchain image, handing out the images in order. With at least as many images as frames in flight,
+// the image handed out was last rendered to by a frame whose fence has already been waited on.
+uint32_t acquire_offscreen_image(OffscreenImages& offscreen_images);
+
+// Copies the image back to host memory and writes it to path as a binary PPM. Waits for the copy, so it is meant for the end of a run, not every frame.
+// Every frame rendering to the image must have completed.
+bool write_offscreen_image(VkDevice device, VkPhysicalDevice physical_device, TransientCommandPool& transient_pool, const SwapchainImages& images, uint32_t image_index, const char* path);
@@ -0,0 +1,98 @@
+#include <thread>
+#include <algorithm>
+#include "parallel_recording.h"
+#include "cpu_profiler.h"
+#include "command.h"
+#include "error.h"
+
+ParallelRecorder create_parallel_recorder(VkDevice device, std::size_t queue_family_index, std::size_t worker_count)
+{
+	if (worker_count == 0) {
+		worker_count = std::max<std::size_t>(std::thread::hardware_concurrency(), 1);
+	}
+
+	ParallelRecorder recorder{};
+	recorder.device = device;
+	recorder.workers.resize(worker_count);
+	recorder.recorded_version_by_frame.fill(UINT64_MAX);
+
+	for (std::size_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame) {
+		recorder.command_buffers_by_frame[frame].resize(worker_count);
+	}
+
+	for (std::size_t i = 0; i < worker_count; ++i) {
+		RecordingWorker& worker = recorder.workers[i];
+		worker.pool = create_command_pool(device, queue_family_index, true, false);
+
+		std::array<VkCommandBuffer, MAX_FRAMES_IN_FLIGHT> command_buffers{};
+		create_command_buffers(device, worker.pool, false, command_buffers);
+		for (std::size_t frame = 0; frame < MAX_FRAMES_IN_FLIGHT; ++frame) {
+			recorder.command_buffers_by_frame[frame][i] = command_buffers[frame];
+		}
+	}
+
+	return recorder;
+}
+
+void destroy_parallel_recorder(ParallelRecorder& recorder)
+{
+	// Destroying a pool frees the buffers allocated from it.
+	for (RecordingWorker& worker : recorder.workers) {
+		vkDestroyCommandPool(recorder.device, worker.pool, nullptr);
+	}
+
+	recorder = ParallelRecorder{};
+}
+
+static void record_draw_range(VkCommandBuffer command_buffer, const VkCommandBufferInheritanceInfo& inheritance_info, std::size_t first_draw, std::size_t draw_count, const RecordDrawsFunction& record_draws) {
+	VkCommandBufferBeginInfo begin_info{};
+	begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	// Everything recorded is executed inside the primary buffer's render pass. Without simultaneous use, executing the buffer from the primary of
+	// another swapchain image would invalidate the primaries that already execute it.
+	begin_info.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+	begin_info.pInheritanceInfo = &inheritance_info;
+
+	if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+		log_error("Failed to start recording secondary command buffer.");
+	}
+
+	record_draws(command_buffer, first_draw, draw_count);
+
+	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+		log_error("Failed to record commands to secondary command buffer.");
+	}
+}
+
+std::span<const VkCommandBuffer> record_secondary_commands(ParallelRecorder& recorder, JobSystem& job_system, std::size_t frame_index, uint64_t version, VkRenderPass render_pass, uint32_t subpass, std::size_t draw_count, const RecordDrawsFunction& record_draws)
+{
+	PROFILE_FUNCTION();
+
+	const std::vector<VkCommandBuffer>& command_buffers = recorder.command_buffers_by_frame[frame_index];
+	if (recorder.recorded_version_by_frame[frame_index] == version) {
+		return std::span<const VkCommandBuffer>(command_buffers.data(), recorder.used_count_by_frame[frame_index]);
+	}
+
+	// Leaving the framebuffer out lets the same secondaries be executed in the render pass of any swapchain image, at the cost of some drivers not being able to optimise for it.
+	VkCommandBufferInheritanceInfo inheritance_info{};
+	inheritance_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+	inheritance_info.renderPass = render_pass;
+	inheritance_info.subpass = subpass;
+	inheritance_info.framebuffer = VK_NULL_HANDLE;
+
+	// Each range records into the buffer of the same index, so no two jobs ever use the same command pool, whichever threads they run on.
+	// Ranges are made long enough that there are never more of them than buffers.
+	std::size_t min_range_size = std::max(MIN_DRAWS_PER_WORKER, (draw_count + command_buffers.size() - 1) / command_buffers.size());
+	std::size_t range_count = job_system.parallel_for(draw_count, min_range_size, 1, [&](std::size_t begin, std::size_t end, std::size_t range_index) {
+		record_draw_range(command_buffers[range_index], inheritance_info, begin, end - begin, record_draws);
+	});
+
+	// An empty draw list still records one buffer, so the render pass has something to execute.
+	if (range_count == 0) {
+		record_draw_range(command_buffers[0], inheritance_info, 0, 0, record_draws);
+		range_count = 1;
+	}
+
+	recorder.used_count_by_frame[frame_index] = range_count;
+	recorder.recorded_version_by_frame[frame_index] = version;
+	return std::span<const VkCommandBuffer>(command_buffers.data(), range_count);
+}
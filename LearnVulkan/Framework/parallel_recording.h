@@ -0,0 +1,51 @@
+#pragma once
+#include <vulkan/vulkan.h>
+#include <cstddef>
+#include <cstdint>
+#include <array>
+#include <vector>
+#include <span>
+#include <functional>
+#include "constants.h"
+#include "job_system.h"
+
+// Recording a large draw list on one thread leaves the other cores idle. The draw list is instead split into contiguous ranges, each recorded on its own thread into a
+// secondary command buffer, and the primary buffer only begins the render pass and executes them in order.
+//
+// Command pools can't be used from more than one thread at a time, so each worker has its own pool, and a secondary buffer for every frame in flight so a frame
+// can be re-recorded while the others are pending. The secondaries don't reference a framebuffer, so one set per frame serves every swapchain image: they are
+// executed by the cached primary of each image (see CommandRecordingCache), which needs them to be begun for simultaneous use.
+
+// Ranges smaller than this are recorded on fewer threads, handing a range to another thread costs more than recording a few hundred draws.
+// Only large draw lists, like the one drawn with --separate-draws, are split at all.
+static constexpr std::size_t MIN_DRAWS_PER_WORKER = 256;
+
+struct RecordingWorker {
+	VkCommandPool pool{ VK_NULL_HANDLE };
+};
+
+struct ParallelRecorder {
+	VkDevice device{ VK_NULL_HANDLE };
+	std::vector<RecordingWorker> workers{};
+
+	// One secondary buffer per worker, in the order of the ranges they record.
+	std::array<std::vector<VkCommandBuffer>, MAX_FRAMES_IN_FLIGHT> command_buffers_by_frame{};
+
+	// How many of the frame's secondary buffers hold the current recording, and the CommandRecordingCache version it was recorded at.
+	std::array<std::size_t, MAX_FRAMES_IN_FLIGHT> used_count_by_frame{};
+	std::array<uint64_t, MAX_FRAMES_IN_FLIGHT> recorded_version_by_frame{};
+};
+
+// Called from a job with a secondary buffer that has already been begun. The secondary inherits nothing from the primary except the render pass,
+// so it must bind the pipeline, dynamic state, descriptor sets and buffers itself before drawing.
+using RecordDrawsFunction = std::function<void(VkCommandBuffer command_buffer, std::size_t first_draw, std::size_t draw_count)>;
+
+// worker_count defaults to the number of hardware threads, it should be the thread count of the job system the recording is split across.
+ParallelRecorder create_parallel_recorder(VkDevice device, std::size_t queue_family_index, std::size_t worker_count = 0);
+
+// The device must be idle.
+void destroy_parallel_recorder(ParallelRecorder& recorder);
+
+// Records draw_count draws into the frame's secondary buffers, one range per job, and returns the buffers to execute in order.
+// Nothing is recorded if the frame was already recorded at this version. The frame's fence must have been waited on, since its secondaries are reset.
+std::span<const VkCommandBuffer> record_secondary_commands(ParallelRecorder& recorder, JobSystem& job_system, std::size_t frame_index, uint64_t version, VkRenderPass render_pass, uint32_t subpass, std::size_t draw_count, const RecordDrawsFunction& record_draws);
@@ -1,9 +1,13 @@
 #include <span>
+#include <algorithm>
+#include <cstring>
 #include "physical_device.h"
 #include "Error.h"
 #include "Enum.h"
+#include "cpu_profiler.h"
 
 std::array<const char*, 1> required_device_extensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+std::array<const char*, 2> optional_device_extensions = { VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME };
 
 static [[nodiscard]] bool has_required_extensions(VkPhysicalDevice physical_device, std::span<const char*> required_extensions)
 {
@@ -98,7 +102,7 @@ static [[nodiscard]] bool try_get_queue_family_details(VkSurfaceKHR window_surfa
 		}
 
 
-		if (!found_features[FEATURE_PRESENT])
+		if (!found_features[FEATURE_PRESENT] && window_surface != VK_NULL_HANDLE)
 		{
 			//search for family (queue type) that specifically supports present commands.
 
@@ -117,9 +121,61 @@ static [[nodiscard]] bool try_get_queue_family_details(VkSurfaceKHR window_surfa
 		}
 	}
 
+	// Nothing is presented without a surface, the graphics queue stands in so the queue arrays stay fully populated.
+	if (window_surface == VK_NULL_HANDLE && found_features[FEATURE_GRAPHICS]) {
+		out_queue_family_index_by_feature[FEATURE_PRESENT] = out_queue_family_index_by_feature[FEATURE_GRAPHICS];
+		return true;
+	}
+
 	return found_feature_count == FEATURE_COUNT;
 }
 
+static void get_optional_extension_details(VkPhysicalDevice physical_device, bool presents, DeviceDetails& out_device_details) {
+	out_device_details.enabled_extensions.clear();
+	if (presents) {
+		out_device_details.enabled_extensions.assign(required_device_extensions.begin(), required_device_extensions.end());
+	}
+
+	// VK_EXT_external_memory_host builds on VK_KHR_external_memory and its properties are read with vkGetPhysicalDeviceProperties2, both only core
+	// from Vulkan 1.1. The instance asking for 1.1 doesn't make a 1.0 device support them.
+	bool supports_vulkan_1_1 = out_device_details.properties.apiVersion >= VK_API_VERSION_1_1;
+
+	for (const char* optional_extension : optional_device_extensions) {
+		if (!supports_vulkan_1_1 && std::strcmp(optional_extension, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) == 0) {
+			continue;
+		}
+
+		std::array<const char*, 1> extension{ optional_extension };
+		if (has_required_extensions(physical_device, extension)) {
+			out_device_details.enabled_extensions.push_back(optional_extension);
+		}
+	}
+
+	auto& extensions = out_device_details.enabled_extensions;
+	out_device_details.supports_draw_indirect_count = std::find_if(extensions.begin(), extensions.end(), [](const char* name) { return std::strcmp(name, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0; }) != extensions.end();
+
+	if (std::find_if(extensions.begin(), extensions.end(), [](const char* name) { return std::strcmp(name, VK_EXT_EXTERNAL_MEMORY_HOST_EXTENSION_NAME) == 0; }) != extensions.end()) {
+
+		// Host pointers imported as device memory must be aligned to (and sized in multiples of) this value.
+		VkPhysicalDeviceExternalMemoryHostPropertiesEXT host_properties{};
+		host_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_EXTERNAL_MEMORY_HOST_PROPERTIES_EXT;
+
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &host_properties;
+		vkGetPhysicalDeviceProperties2(physical_device, &properties);
+		out_device_details.min_imported_host_pointer_alignment = host_properties.minImportedHostPointerAlignment;
+	}
+}
+
+static void get_optional_feature_details(VkPhysicalDevice physical_device, DeviceDetails& out_device_details) {
+	VkPhysicalDeviceFeatures features;
+	vkGetPhysicalDeviceFeatures(physical_device, &features);
+
+	out_device_details.enabled_features = VkPhysicalDeviceFeatures{};
+	out_device_details.enabled_features.drawIndirectFirstInstance = features.drawIndirectFirstInstance;
+}
+
 static bool try_get_required_anistropy_details(VkPhysicalDevice physical_device, uint32_t& out_max_anistropy_samples) {
 	VkPhysicalDeviceFeatures features;
 	vkGetPhysicalDeviceFeatures(physical_device, &features);
@@ -135,11 +191,12 @@ static bool try_get_required_anistropy_details(VkPhysicalDevice physical_device,
 
 static [[nodiscard]] bool try_get_required_details(VkSurfaceKHR window_surface, VkPhysicalDevice physical_device, DeviceDetails& out_device_details) {
 
-	if (!has_required_extensions(physical_device, required_device_extensions)) {
+	bool presents = window_surface != VK_NULL_HANDLE;
+	if (presents && !has_required_extensions(physical_device, required_device_extensions)) {
 		return false;
 	}
 
-	if (!try_get_swap_chain_details(window_surface, physical_device, out_device_details.swapchain)) {
+	if (presents && !try_get_swap_chain_details(window_surface, physical_device, out_device_details.swapchain)) {
 		return false;
 	}
 
@@ -152,6 +209,8 @@ static [[nodiscard]] bool try_get_required_details(VkSurfaceKHR window_surface,
 	}
 
 	vkGetPhysicalDeviceProperties(physical_device, &out_device_details.properties);
+	get_optional_extension_details(physical_device, presents, out_device_details);
+	get_optional_feature_details(physical_device, out_device_details);
 	return true;
 }
 
@@ -181,6 +240,7 @@ static std::size_t rate_details(DeviceDetails& details) {
 }
 
 [[nodiscard]] VkPhysicalDevice pick_physical_device(VkInstance instance, VkSurfaceKHR window_surface, DeviceDetails& out_details) {
+	PROFILE_FUNCTION();
 
 	uint32_t device_count;
 	vkEnumeratePhysicalDevices(instance, &device_count, nullptr);
@@ -211,4 +271,9 @@ static std::size_t rate_details(DeviceDetails& details) {
 	}
 
 	return picked;
-}
\ No newline at end of file
+}
+
+void refresh_surface_capabilities(VkPhysicalDevice physical_device, VkSurfaceKHR window_surface, SwapchainDetails& swapchain_details)
+{
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device, window_surface, &swapchain_details.capabilities);
+}
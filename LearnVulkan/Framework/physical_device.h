@@ -9,7 +9,11 @@ enum {
 	FEATURE_COUNT,
 };
 
+// Only required when presenting to a window.
 extern std::array<const char*, 1> required_device_extensions;
+
+// Extensions that are enabled when the device supports them, features built on them must check the device details before use.
+extern std::array<const char*, 2> optional_device_extensions;
 using QueueFamilyIndexByFeature = std::array<std::size_t, FEATURE_COUNT>;
 
 struct SwapchainDetails {
@@ -23,6 +27,24 @@ struct DeviceDetails {
 	SwapchainDetails swapchain{};
 	QueueFamilyIndexByFeature queue_family_index_by_feature{};
 	uint32_t max_anistropy_samples { 0 };
+
+	// Required extensions followed by the optional extensions the device supports.
+	std::vector<const char*> enabled_extensions{};
+
+	// VK_EXT_external_memory_host, zero when the extension isn't supported.
+	VkDeviceSize min_imported_host_pointer_alignment{ 0 };
+
+	// VK_KHR_draw_indirect_count, needed for GPU culling.
+	bool supports_draw_indirect_count{ false };
+
+	// Optional features the device supports, the device is created with exactly these enabled. GPU culling also needs drawIndirectFirstInstance,
+	// every culled draw picks out its transform with its first instance.
+	VkPhysicalDeviceFeatures enabled_features{};
 };
 
+// Without a window surface (VK_NULL_HANDLE) the device only needs a graphics queue, the present queue is set to the graphics queue and the swapchain details are left empty.
+// Software implementations like lavapipe are picked only when nothing better is available, the Vulkan loader's VK_DRIVER_FILES can be used to limit the choice to one.
 [[nodiscard]] VkPhysicalDevice pick_physical_device(VkInstance instance, VkSurfaceKHR window_surface, DeviceDetails& out_details);
+
+// The surface capabilities (current extent in particular) change with the window, so they must be queried again before the swapchain is recreated.
+void refresh_surface_capabilities(VkPhysicalDevice physical_device, VkSurfaceKHR window_surface, SwapchainDetails& swapchain_details);
@@ -1,20 +1,27 @@
 #include <glm/glm.hpp>
 #include "render_pipeline.h"
+#include "cpu_profiler.h"
+#include "instance_buffer.h"
 #include "error.h"
 
 
 // Describes the whole vertex struct to vulkan, how big it is and which buffer to use it in (binding).
-static VkVertexInputBindingDescription get_vertex_binding_description() {
-	VkVertexInputBindingDescription binding_description{};
-	binding_description.binding = 0;
-	binding_description.stride = sizeof(Vertex);
-	binding_description.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
-	return binding_description;
+// The second binding holds the instance data, the input rate makes it advance once per instance instead of once per vertex.
+static std::array<VkVertexInputBindingDescription, 2> get_vertex_binding_descriptions() {
+	std::array<VkVertexInputBindingDescription, 2> binding_descriptions{};
+	binding_descriptions[0].binding = 0;
+	binding_descriptions[0].stride = sizeof(Vertex);
+	binding_descriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+	binding_descriptions[1].binding = INSTANCE_BINDING;
+	binding_descriptions[1].stride = sizeof(InstanceData);
+	binding_descriptions[1].inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
+	return binding_descriptions;
 }
 
 // Describes individual members of the struct to vulkan. The location specifies the id from which the value can be referemced oin a vertex shader.
-static std::array<VkVertexInputAttributeDescription, 3> get_vertex_attribute_descriptions() {
-	std::array<VkVertexInputAttributeDescription, 3> attribute_descriptions{};
+static std::array<VkVertexInputAttributeDescription, 7> get_vertex_attribute_descriptions() {
+	std::array<VkVertexInputAttributeDescription, 7> attribute_descriptions{};
 	attribute_descriptions[0].binding = 0;
 	attribute_descriptions[0].location = 0;
 	attribute_descriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
@@ -30,6 +37,15 @@ static std::array<VkVertexInputAttributeDescription, 3> get_vertex_attribute_des
 	attribute_descriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
 	attribute_descriptions[2].offset = offsetof(Vertex, uv);
 
+	// An attribute is at most four components, so the instance's model matrix takes up one location per column.
+	for (uint32_t column = 0; column < 4; ++column) {
+		VkVertexInputAttributeDescription& attribute_description = attribute_descriptions[3 + column];
+		attribute_description.binding = INSTANCE_BINDING;
+		attribute_description.location = 3 + column;
+		attribute_description.format = VK_FORMAT_R32G32B32A32_SFLOAT;
+		attribute_description.offset = static_cast<uint32_t>(offsetof(InstanceData, model) + column * sizeof(glm::vec4));
+	}
+
 	return attribute_descriptions;
 }
 
@@ -90,8 +106,16 @@ PipelineResources create_pipeline_resources(VkDevice device)
 	pipeline_layout_info.setLayoutCount = 1; // Optional
 
 	pipeline_layout_info.pSetLayouts = &pipeline_resources.descriptor_set_layout; // Optional 
-	pipeline_layout_info.pushConstantRangeCount = 0; // Optional
-	pipeline_layout_info.pPushConstantRanges = nullptr; // Optional
+
+	// Push constants are small values written straight into the command buffer, which makes them the cheapest way to change data between draws.
+	// A single range covers both stages so the vertex shader can read the model matrix and the fragment shader the material.
+	VkPushConstantRange object_constants_range{};
+	object_constants_range.stageFlags = OBJECT_PUSH_CONSTANT_STAGES;
+	object_constants_range.offset = 0;
+	object_constants_range.size = sizeof(ObjectPushConstants);
+
+	pipeline_layout_info.pushConstantRangeCount = 1;
+	pipeline_layout_info.pPushConstantRanges = &object_constants_range;
 
 	if (vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr, &pipeline_resources.pipeline_layout) != VK_SUCCESS) {
 		log_error("Failed to create pipeline layout!");
@@ -100,7 +124,7 @@ PipelineResources create_pipeline_resources(VkDevice device)
 	return pipeline_resources;
 }
 
-VkRenderPass create_render_pass(VkDevice device, VkFormat swapchain_format, VkFormat depth_buffer_format)
+VkRenderPass create_render_pass(VkDevice device, VkFormat swapchain_format, VkFormat depth_buffer_format, VkImageLayout final_color_layout)
 {
 	VkRenderPass render_pass;
 	// An attachment is a description of a resource used during rendering. 
@@ -119,8 +143,9 @@ VkRenderPass create_render_pass(VkDevice device, VkFormat swapchain_format, VkFo
 	color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 
 	//here we inform vulkan that the layout of the bimage  should be optimised for presenting to the screen after we are done with the render subpass. 
+	// Without a window the image is copied out instead, so the caller picks the final layout.
 	color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	color_attachment.finalLayout = final_color_layout;
 
 
 	// An attachment reference represents a reference to an attachment at a specific render sub-pass. 
@@ -208,8 +233,8 @@ static ShaderStageInfos create_shader_stage_infos(ShaderByStage& shaders_by_stag
 struct InputGeometryInfo {
 	VkPipelineInputAssemblyStateCreateInfo primitive_layout{};
 	VkPipelineVertexInputStateCreateInfo vertex_layout{};
-	VkVertexInputBindingDescription vertex_binding_description{};
-	std::array<VkVertexInputAttributeDescription, 3> vertex_attribute_descriptions{};
+	std::array<VkVertexInputBindingDescription, 2> vertex_binding_descriptions{};
+	std::array<VkVertexInputAttributeDescription, 7> vertex_attribute_descriptions{};
 };
 
 static InputGeometryInfo create_input_geometry_info() {
@@ -226,15 +251,15 @@ static InputGeometryInfo create_input_geometry_info() {
 	// Describes the format of the vertex data that will be passed to the vertex shader.
 	// Uses arrays of structs to describe the stride and format of the vertices. 
 
-	input_layout_info.vertex_binding_description = get_vertex_binding_description();
+	input_layout_info.vertex_binding_descriptions = get_vertex_binding_descriptions();
 	input_layout_info.vertex_attribute_descriptions = get_vertex_attribute_descriptions();
 
 	VkPipelineVertexInputStateCreateInfo& vertex_layout = input_layout_info.vertex_layout;
 	vertex_layout.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	vertex_layout.vertexAttributeDescriptionCount = static_cast<uint32_t>(input_layout_info.vertex_attribute_descriptions.size());
 	vertex_layout.pVertexAttributeDescriptions = input_layout_info.vertex_attribute_descriptions.data();
-	vertex_layout.vertexBindingDescriptionCount = 1;
-	vertex_layout.pVertexBindingDescriptions = &input_layout_info.vertex_binding_description;
+	vertex_layout.vertexBindingDescriptionCount = static_cast<uint32_t>(input_layout_info.vertex_binding_descriptions.size());
+	vertex_layout.pVertexBindingDescriptions = input_layout_info.vertex_binding_descriptions.data();
 
 	return input_layout_info;
 }
@@ -358,6 +383,8 @@ static ColorOutputInfo create_color_output_info() {
 
 VkPipeline create_render_pipeline(VkDevice device, VkRenderPass render_pass, VkPipelineLayout pipeline_resource_layout, ShaderByStage& shaders_by_stage, VkExtent2D viewport_extent)
 {
+	PROFILE_FUNCTION();
+
 	VkPipeline pipeline;
 	ShaderStageInfos shader_stage_infos = create_shader_stage_infos(shaders_by_stage);
 	InputGeometryInfo input_layout_info = create_input_geometry_info();
@@ -428,3 +455,8 @@ VkPipeline create_render_pipeline(VkDevice device, VkRenderPass render_pass, VkP
 
 	return pipeline;
 }
+
+void push_object_constants(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, const ObjectPushConstants& object_constants)
+{
+	vkCmdPushConstants(command_buffer, pipeline_layout, OBJECT_PUSH_CONSTANT_STAGES, 0, sizeof(ObjectPushConstants), &object_constants);
+}
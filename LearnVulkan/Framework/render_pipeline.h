@@ -8,6 +8,15 @@
 
 
 
+// Per-object data pushed with every draw, so drawing many objects doesn't need a uniform buffer slot or descriptor set per object.
+// 68 bytes, within the 128 bytes every implementation guarantees. Must match the push constant block in the shaders.
+struct ObjectPushConstants {
+	glm::mat4 model{ 1.0f };
+	uint32_t material_index{ 0 };
+};
+
+static constexpr VkShaderStageFlags OBJECT_PUSH_CONSTANT_STAGES = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+
 struct PipelineResources {
 	VkPipelineLayout pipeline_layout;
 	VkDescriptorSetLayout descriptor_set_layout;
@@ -15,5 +24,8 @@ struct PipelineResources {
 
 
 PipelineResources create_pipeline_resources(VkDevice device);
-VkRenderPass create_render_pass(VkDevice device, VkFormat swapchain_format, VkFormat depth_buffer_format);
+// final_color_layout is the layout the color image is left in, offscreen images are copied from rather than presented.
+VkRenderPass create_render_pass(VkDevice device, VkFormat swapchain_format, VkFormat depth_buffer_format, VkImageLayout final_color_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR);
 VkPipeline create_render_pipeline(VkDevice device, VkRenderPass render_pass, VkPipelineLayout pipeline_resource_layout, ShaderByStage& shaders_by_stage, VkExtent2D viewport_extent);
+
+void push_object_constants(VkCommandBuffer command_buffer, VkPipelineLayout pipeline_layout, const ObjectPushConstants& object_constants);
@@ -4,6 +4,7 @@
 
 #include <fstream>
 #include "shader.h"
+#include "cpu_profiler.h"
 #include "error.h"
 
 
@@ -41,5 +42,7 @@ VkShaderModule create_shader_module(VkDevice device, const char* file_path)
 
 ShaderByStage create_shaders(VkDevice device, const char* vertex_shader_path, const char* fragment_shader_path)
 {
+	PROFILE_FUNCTION();
+
 	return { create_shader_module(device, vertex_shader_path), create_shader_module(device, fragment_shader_path) };
 }
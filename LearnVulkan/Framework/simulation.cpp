@@ -0,0 +1,54 @@
+#include <cmath>
+#include "simulation.h"
+
+// A tick that runs long is caught up on by running the following ticks back to back. Past this many ticks behind, the missed ticks are skipped instead,
+// otherwise a simulation that can't keep up would spend all its time catching up and fall further behind.
+static constexpr uint64_t MAX_CATCH_UP_TICKS = 5;
+
+SimulationThread::SimulationThread(double ticks_per_second, TickFunction tick, std::function<void()> on_start)
+{
+	step = 1.0 / ticks_per_second;
+	start_time = SimulationClock::now();
+	thread = std::jthread([this, tick = std::move(tick), on_start = std::move(on_start)](std::stop_token stop_token) mutable {
+		run(stop_token, std::move(tick), std::move(on_start));
+	});
+}
+
+SimulationThread::~SimulationThread()
+{
+	// jthread asks the thread to stop and joins it.
+	thread = std::jthread{};
+}
+
+double SimulationThread::get_time() const
+{
+	return std::chrono::duration<double>(SimulationClock::now() - start_time).count();
+}
+
+void SimulationThread::run(std::stop_token stop_token, TickFunction tick, std::function<void()> on_start)
+{
+	if (on_start) {
+		on_start();
+	}
+
+	uint64_t tick_index = 0;
+	while (!stop_token.stop_requested()) {
+		// Ticks are scheduled from the start time rather than from the end of the last tick, so lateness doesn't accumulate.
+		auto due = start_time + std::chrono::duration_cast<SimulationClock::duration>(std::chrono::duration<double>(tick_index * step));
+		SimulationClock::time_point now = SimulationClock::now();
+
+		if (due > now) {
+			std::this_thread::sleep_until(due);
+			continue;
+		}
+
+		uint64_t current_tick = static_cast<uint64_t>(std::floor(get_time() / step));
+		if (current_tick > tick_index + MAX_CATCH_UP_TICKS) {
+			dropped_tick_count.fetch_add(current_tick - tick_index, std::memory_order_relaxed);
+			tick_index = current_tick;
+		}
+
+		tick(tick_index, tick_index * step, step);
+		++tick_index;
+	}
+}
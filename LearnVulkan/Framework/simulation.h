@@ -0,0 +1,85 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+// The simulation runs on its own thread at a fixed rate, independent of the frame rate. Each tick writes a complete snapshot of the state the renderer needs
+// and publishes it, and the render thread draws between the two newest snapshots it has. A frame stalled on the GPU doesn't hold up the simulation,
+// and a slow tick doesn't hold up the frame, which keeps drawing the snapshots it already has.
+//
+// Rendering runs one tick behind the simulation so there is always a newer snapshot to interpolate towards.
+
+using SimulationClock = std::chrono::steady_clock;
+
+// Hands the newest snapshot from one producer thread to one consumer thread without locking or copying. There are four slots: the one being written,
+// the newest published one, and the two the consumer is interpolating between. Publishing and acquiring swap slot indices, so neither side ever waits.
+// Snapshots are reused, so whatever they hold should be overwritten in place rather than reallocated.
+template<typename Snapshot>
+class SnapshotBuffer {
+public:
+	// Producer side. The snapshot to write the next tick into, and hands it over once written.
+	Snapshot& get_back() { return slots[back]; }
+
+	void publish() {
+		back = latest.exchange(back | FRESH_BIT, std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// Consumer side. Takes the newest snapshot if one was published since the last call, the current snapshot becoming the previous one.
+	// Returns true when both are valid.
+	bool acquire() {
+		if ((latest.load(std::memory_order_relaxed) & FRESH_BIT) != 0) {
+			uint32_t taken = latest.exchange(previous, std::memory_order_acq_rel) & INDEX_MASK;
+			previous = current;
+			current = taken;
+			acquired_count = acquired_count < 2 ? acquired_count + 1 : 2;
+		}
+
+		return acquired_count == 2;
+	}
+
+	const Snapshot& get_current() const { return slots[current]; }
+	const Snapshot& get_previous() const { return slots[previous]; }
+
+private:
+	static constexpr uint32_t FRESH_BIT = 1u << 31;
+	static constexpr uint32_t INDEX_MASK = FRESH_BIT - 1;
+
+	std::array<Snapshot, 4> slots{};
+	std::atomic<uint32_t> latest{ 0 };
+	uint32_t back{ 1 };
+	uint32_t current{ 2 };
+	uint32_t previous{ 3 };
+	uint32_t acquired_count{ 0 };
+};
+
+// Calls the tick function at a fixed rate on its own thread until destroyed. time is in seconds since the thread started and always a whole number of steps.
+class SimulationThread {
+public:
+	using TickFunction = std::function<void(uint64_t tick, double time, double step)>;
+
+	// on_start is called on the simulation thread before the first tick.
+	SimulationThread(double ticks_per_second, TickFunction tick, std::function<void()> on_start = {});
+	~SimulationThread();
+
+	SimulationThread(const SimulationThread&) = delete;
+	SimulationThread& operator=(const SimulationThread&) = delete;
+
+	double get_step() const { return step; }
+
+	// Seconds since the thread started, on the same scale as the time given to the ticks.
+	double get_time() const;
+
+	// Ticks dropped because the simulation fell too far behind, see MAX_CATCH_UP_TICKS.
+	uint64_t get_dropped_tick_count() const { return dropped_tick_count.load(std::memory_order_relaxed); }
+
+private:
+	void run(std::stop_token stop_token, TickFunction tick, std::function<void()> on_start);
+
+	double step{ 0.0 };
+	SimulationClock::time_point start_time{};
+	std::atomic<uint64_t> dropped_tick_count{ 0 };
+	std::jthread thread{};
+};
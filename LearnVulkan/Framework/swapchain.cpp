@@ -1,6 +1,7 @@
 #include <span>
 #include <algorithm>
 #include "swapchain.h"
+#include "cpu_profiler.h"
 #include "error.h"
 
 
@@ -14,12 +15,10 @@ static VkSurfaceFormatKHR pick_surface_format(std::span<const VkSurfaceFormatKHR
 	return surface_formats.back();
 }
 
-static VkPresentModeKHR pick_present_mode(std::span<const VkPresentModeKHR> present_modes) {
+static VkPresentModeKHR pick_present_mode(std::span<const VkPresentModeKHR> present_modes, VkPresentModeKHR preferred_present_mode) {
 	//If on mobile VK_PRESENT_MODE_FIFO is probably preffered if energy usage is a concern.
-	for (const auto& present_mode : present_modes) {
-		if (present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-			return present_mode;
-		}
+	if (std::find(present_modes.begin(), present_modes.end(), preferred_present_mode) != present_modes.end()) {
+		return preferred_present_mode;
 	}
 
 	// FIFO is guaranteed to be there when using Vulkan
@@ -47,13 +46,17 @@ static VkExtent2D pick_surface_extent(GLFWwindow* window, VkSurfaceCapabilitiesK
 	return capabilities.currentExtent;
 }
 
-VkSwapchainKHR create_swapchain(GLFWwindow* window, VkSurfaceKHR window_surface, VkDevice device, std::size_t graphics_family_index, std::size_t present_family_index, const SwapchainDetails& swapchain_details, SwapchainImages& out_swapchain_images)
+VkSwapchainKHR create_swapchain(GLFWwindow* window, VkSurfaceKHR window_surface, VkDevice device, std::size_t graphics_family_index, std::size_t present_family_index, const SwapchainDetails& swapchain_details, SwapchainImages& out_swapchain_images, VkPresentModeKHR preferred_present_mode, uint32_t requested_image_count, VkSwapchainKHR old_swapchain)
 {
+	PROFILE_FUNCTION();
+
 	VkSurfaceFormatKHR surface_format = pick_surface_format(swapchain_details.surface_formats);
-	VkPresentModeKHR present_mode = pick_present_mode(swapchain_details.surface_present_modes);
+	VkPresentModeKHR present_mode = pick_present_mode(swapchain_details.surface_present_modes, preferred_present_mode);
 	VkExtent2D extent = pick_surface_extent(window, swapchain_details.capabilities);
 
-	uint32_t image_count = swapchain_details.capabilities.minImageCount + 1;
+	// More images let the CPU and GPU run further ahead of the display, fewer reduce latency.
+	uint32_t image_count = requested_image_count > 0 ? requested_image_count : swapchain_details.capabilities.minImageCount + 1;
+	image_count = std::max(image_count, swapchain_details.capabilities.minImageCount);
 	if (swapchain_details.capabilities.maxImageCount > 0 && image_count > swapchain_details.capabilities.maxImageCount) {
 		image_count = swapchain_details.capabilities.maxImageCount;
 	}
@@ -91,9 +94,8 @@ VkSwapchainKHR create_swapchain(GLFWwindow* window, VkSurfaceKHR window_surface,
 	create_info.clipped = VK_TRUE; // If the window is partly obscured, don't paint that region.
 
 	// When the screen is resized, the swap chain will need to be remade from scratch. 
-	// Here you would need to provide a reference to the old swap chain when the resize occurs. 
-	// Since this is the first swap chaim, no previous swap chain is provided here.
-	create_info.oldSwapchain = VK_NULL_HANDLE;
+	// Providing the old swap chain lets the implementation reuse its resources, and images already acquired from it can still be presented.
+	create_info.oldSwapchain = old_swapchain;
 
 	VkSwapchainKHR swapchain;
 	if (vkCreateSwapchainKHR(device, &create_info, nullptr, &swapchain) != VK_SUCCESS) {
@@ -107,6 +109,7 @@ VkSwapchainKHR create_swapchain(GLFWwindow* window, VkSurfaceKHR window_surface,
 
 	out_swapchain_images.format = surface_format.format;
 	out_swapchain_images.extent = extent;
+	out_swapchain_images.present_mode = present_mode;
 
 	return swapchain;
 }
@@ -186,11 +189,20 @@ static std::vector<VkFramebuffer> create_framebuffers(VkDevice device, VkRenderP
 	return framebuffers;
 }
 
-RenderTargets create_render_targets(VkDevice device, VkRenderPass render_pass, VkSwapchainKHR swapchain, const SwapchainImages& swapchain_images, VkImageView depth_buffer_view)
+RenderTargets create_render_targets(VkDevice device, DeletionQueue& deletion_queue, VkRenderPass render_pass, const SwapchainImages& swapchain_images, VkImageView depth_buffer_view)
 {
+	std::vector<VkImageView> image_views = create_swapchain_image_views(device, swapchain_images.images, swapchain_images.format);
+	std::vector<VkFramebuffer> framebuffers = create_framebuffers(device, render_pass, swapchain_images.extent, image_views, depth_buffer_view);
+
 	RenderTargets render_targets;
-	render_targets.image_views = create_swapchain_image_views(device, swapchain_images.images, swapchain_images.format);
-	render_targets.framebuffers = create_framebuffers(device, render_pass, swapchain_images.extent, render_targets.image_views, depth_buffer_view);
+	for (VkImageView image_view : image_views) {
+		render_targets.image_views.emplace_back(deletion_queue, image_view);
+	}
+
+	for (VkFramebuffer framebuffer : framebuffers) {
+		render_targets.framebuffers.emplace_back(deletion_queue, framebuffer);
+	}
+
 	return render_targets;
 }
 
@@ -3,18 +3,26 @@
 //#define GLFW_INCLUDE_VULKAN
 #include <glfw/glfw3.h>
 #include "physical_device.h"
+#include "deletion_queue.h"
 
 struct SwapchainImages {
 	VkFormat format{};
 	VkExtent2D extent{};
+
+	// The present mode actually in use, which is FIFO when the preferred mode isn't supported.
+	VkPresentModeKHR present_mode{ VK_PRESENT_MODE_FIFO_KHR };
 	std::vector<VkImage> images{};
 };
 
+// Replacing the render targets queues the old views and framebuffers for destruction, so they stay valid for the frames still using them.
 struct RenderTargets {
-	std::vector<VkImageView> image_views{};
-	std::vector<VkFramebuffer> framebuffers{};
+	std::vector<UniqueImageView> image_views{};
+	std::vector<UniqueFramebuffer> framebuffers{};
 };
 
-VkSwapchainKHR create_swapchain(GLFWwindow* window, VkSurfaceKHR window_surface, VkDevice device, std::size_t graphics_family_index, std::size_t present_family_index, const SwapchainDetails& swapchain_details, SwapchainImages& out_swapchain_images);
-RenderTargets create_render_targets(VkDevice device, VkRenderPass render_pass, VkSwapchainKHR swapchain, const SwapchainImages& swapchain_images, VkImageView depth_buffer_view);
+// preferred_present_mode falls back to FIFO when the surface doesn't support it.
+// requested_image_count is clamped to what the surface supports, 0 asks for one more than the minimum.
+// When recreating, old_swapchain lets the presentation engine hand resources over to the new swapchain. The old swapchain is retired but must still be destroyed by the caller.
+VkSwapchainKHR create_swapchain(GLFWwindow* window, VkSurfaceKHR window_surface, VkDevice device, std::size_t graphics_family_index, std::size_t present_family_index, const SwapchainDetails& swapchain_details, SwapchainImages& out_swapchain_images, VkPresentModeKHR preferred_present_mode = VK_PRESENT_MODE_MAILBOX_KHR, uint32_t requested_image_count = 0, VkSwapchainKHR old_swapchain = VK_NULL_HANDLE);
+RenderTargets create_render_targets(VkDevice device, DeletionQueue& deletion_queue, VkRenderPass render_pass, const SwapchainImages& swapchain_images, VkImageView depth_buffer_view);
 
@@ -1,39 +1,82 @@
 #include "texture.h"
+#include "cpu_profiler.h"
 #include "buffer.h"
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
 #include "error.h"
+#include "memory_stats.h"
 
-Texture create_texture(VkDevice device, VkPhysicalDevice physical_device, VkCommandPool command_pool, VkQueue queue, const char* file_path)
-{
-	Texture texture{};
-
-	int image_width, image_height, image_channels;
-	stbi_uc* pixels = stbi_load(file_path, &image_width, &image_height, &image_channels, STBI_rgb_alpha);
-	VkDeviceSize image_size = (VkDeviceSize)(image_width * image_height * 4);
-	auto [gpu_image, gpu_image_memory] = create_gpu_image(device, physical_device, command_pool, queue, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, image_width, image_height, { pixels, image_size });
+static constexpr VkFormat TEXTURE_FORMAT = VK_FORMAT_R8G8B8A8_SRGB;
 
+static VkImageView create_texture_view(VkDevice device, VkImage image) {
 	VkImageViewCreateInfo view_info{};
 	view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	view_info.image = gpu_image;
+	view_info.image = image;
 	view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	view_info.format = VK_FORMAT_R8G8B8A8_SRGB;
+	view_info.format = TEXTURE_FORMAT;
 	view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
 	view_info.subresourceRange.baseMipLevel = 0;
 	view_info.subresourceRange.levelCount = 1;
 	view_info.subresourceRange.baseArrayLayer = 0;
 	view_info.subresourceRange.layerCount = 1;
 
-	texture.image = gpu_image;
-	texture.memory = gpu_image_memory;
+	VkImageView view{ VK_NULL_HANDLE };
+	if (vkCreateImageView(device, &view_info, nullptr, &view) != VK_SUCCESS) {
+		log_error("Failed to create texture image view");
+	}
+
+	return view;
+}
+
+Texture create_texture(VkDevice device, VkPhysicalDevice physical_device, DeletionQueue& deletion_queue, TransientCommandPool& transient_pool, GpuAllocator& allocator, const char* file_path)
+{
+	PROFILE_FUNCTION();
+
+	Texture texture{};
+	MemoryTagScope tag_scope{ MemoryTag::Texture };
+
+	int image_width, image_height, image_channels;
+	stbi_uc* pixels = stbi_load(file_path, &image_width, &image_height, &image_channels, STBI_rgb_alpha);
+	VkDeviceSize image_size = (VkDeviceSize)(image_width * image_height * 4);
+	VkImage image{ VK_NULL_HANDLE };
 
-	if (vkCreateImageView(device, &view_info, nullptr, &texture.view) != VK_SUCCESS) {
-		log_error("Failed to create image view ", file_path);
+	// A linear image written by the host has to stay where it is, so only the staged path goes through the allocator.
+	if (should_upload_image_directly(physical_device, TEXTURE_FORMAT)) {
+		auto [gpu_image, gpu_image_memory] = create_gpu_image(device, physical_device, transient_pool, TEXTURE_FORMAT, VK_IMAGE_TILING_OPTIMAL, image_width, image_height, { pixels, image_size });
+		texture.image = UniqueImage{ deletion_queue, gpu_image, gpu_image_memory };
+		image = gpu_image;
 	}
-	
+	else {
+		texture.allocation = create_allocated_image(allocator, VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, TEXTURE_FORMAT, VK_IMAGE_ASPECT_COLOR_BIT, image_width, image_height);
+		if (texture.allocation == INVALID_GPU_RESOURCE) {
+			log_error("Failed to allocate texture ", file_path);
+			return texture;
+		}
+
+		image = get_allocated_resource(allocator, texture.allocation).image;
+		submit_staged_image_copy(device, physical_device, transient_pool, image, image_width, image_height, { pixels, image_size });
+		set_allocated_image_layout(allocator, texture.allocation, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	}
+
+	texture.view = UniqueImageView{ deletion_queue, create_texture_view(device, image) };
 	return texture;
 }
 
+void update_texture_view(VkDevice device, DeletionQueue& deletion_queue, Texture& texture, VkImage image)
+{
+	texture.view = UniqueImageView{ deletion_queue, create_texture_view(device, image) };
+}
+
+void destroy_texture(GpuAllocator& allocator, Texture& texture)
+{
+	texture.view.reset();
+	texture.image.reset();
+	if (texture.allocation != INVALID_GPU_RESOURCE) {
+		destroy_allocated_resource(allocator, texture.allocation);
+		texture.allocation = INVALID_GPU_RESOURCE;
+	}
+}
+
 VkSampler create_sampler(VkDevice device, uint32_t max_anisotropy)
 {
 	VkSampler sampler{ VK_NULL_HANDLE };
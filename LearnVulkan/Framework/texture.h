@@ -2,12 +2,20 @@
 #include <vulkan/vulkan.h>
 #include <tuple>
 #include "constants.h"
+#include "command.h"
+#include "deletion_queue.h"
+#include "allocator.h"
 
 struct Texture {
-	VkImage image;
-	VkImageView view;
-	VkDeviceMemory memory;
+	// Staged textures are sub-allocated and can be moved by the defragmenter. Textures written directly into a linear image have their own memory in image instead.
+	GpuResourceHandle allocation{ INVALID_GPU_RESOURCE };
+	UniqueImage image;
+	UniqueImageView view;
 };
 
 VkSampler create_sampler(VkDevice device, uint32_t max_anisotropy);
-Texture create_texture(VkDevice device, VkPhysicalDevice physical_device, VkCommandPool command_pool, VkQueue queue, const char* file_path);
\ No newline at end of file
+Texture create_texture(VkDevice device, VkPhysicalDevice physical_device, DeletionQueue& deletion_queue, TransientCommandPool& transient_pool, GpuAllocator& allocator, const char* file_path);
+
+// Call once the defragmenter has moved the texture to image. The old view is queued for destruction, so descriptors still referencing it must be rewritten.
+void update_texture_view(VkDevice device, DeletionQueue& deletion_queue, Texture& texture, VkImage image);
+void destroy_texture(GpuAllocator& allocator, Texture& texture);
\ No newline at end of file
@@ -0,0 +1,122 @@
+#include <algorithm>
+#include "transform_hierarchy.h"
+#include "cpu_profiler.h"
+#include "error.h"
+
+// Levels smaller than this are updated on the calling thread, most levels near the root only have a handful of nodes.
+static constexpr std::size_t MIN_TRANSFORM_RANGE_SIZE = 4 * 1024;
+
+// Ranges start on a multiple of a cache line of dirty flags in absolute node index, so neighbouring ranges never write to the same line.
+static constexpr std::size_t TRANSFORM_RANGE_ALIGNMENT = 64;
+
+static constexpr uint32_t UNKNOWN_DEPTH = UINT32_MAX;
+
+// The depth of every node, found by walking up to the nearest ancestor whose depth is already known.
+static std::vector<uint32_t> get_node_depths(std::span<const uint32_t> parents) {
+	std::vector<uint32_t> depths(parents.size(), UNKNOWN_DEPTH);
+	std::vector<uint32_t> path{};
+
+	for (uint32_t node = 0; node < parents.size(); ++node) {
+		uint32_t current = node;
+		while (depths[current] == UNKNOWN_DEPTH && parents[current] != NO_PARENT && path.size() <= parents.size()) {
+			path.push_back(current);
+			current = parents[current];
+		}
+
+		if (path.size() > parents.size()) {
+			log_error("Transform hierarchy has a cycle through node ", node, ", treating it as a root.");
+			path.clear();
+			current = node;
+		}
+
+		uint32_t depth = depths[current] == UNKNOWN_DEPTH ? 0 : depths[current];
+		depths[current] = depth;
+		while (!path.empty()) {
+			depths[path.back()] = ++depth;
+			path.pop_back();
+		}
+	}
+
+	return depths;
+}
+
+TransformHierarchy build_transform_hierarchy(std::span<const uint32_t> parents, std::span<const glm::mat4> local_matrices)
+{
+	TransformHierarchy hierarchy{};
+	std::size_t node_count = std::min(parents.size(), local_matrices.size());
+	if (parents.size() != local_matrices.size()) {
+		log_error("Transform hierarchy given ", parents.size(), " parents but ", local_matrices.size(), " local matrices.");
+	}
+
+	std::vector<uint32_t> depths = get_node_depths(parents.first(node_count));
+	uint32_t level_count = depths.empty() ? 0 : *std::max_element(depths.begin(), depths.end()) + 1;
+
+	// Counting sort by depth, which keeps the given order within a level.
+	hierarchy.level_offsets.assign(level_count + 1, 0);
+	for (uint32_t depth : depths) {
+		++hierarchy.level_offsets[depth + 1];
+	}
+
+	for (uint32_t level = 0; level < level_count; ++level) {
+		hierarchy.level_offsets[level + 1] += hierarchy.level_offsets[level];
+	}
+
+	std::vector<uint32_t> next_node_by_level(hierarchy.level_offsets.begin(), hierarchy.level_offsets.end() - 1);
+	hierarchy.node_by_source_index.resize(node_count);
+	for (std::size_t i = 0; i < node_count; ++i) {
+		hierarchy.node_by_source_index[i] = next_node_by_level[depths[i]]++;
+	}
+
+	hierarchy.parents.resize(node_count);
+	hierarchy.local_matrices.resize(node_count);
+	hierarchy.world_matrices.resize(node_count, glm::mat4(1.0f));
+	for (std::size_t i = 0; i < node_count; ++i) {
+		uint32_t node = hierarchy.node_by_source_index[i];
+		bool is_root = parents[i] == NO_PARENT || depths[i] == 0;
+		hierarchy.parents[node] = is_root ? NO_PARENT : hierarchy.node_by_source_index[parents[i]];
+		hierarchy.local_matrices[node] = local_matrices[i];
+	}
+
+	hierarchy.dirty.assign(node_count, 1);
+	hierarchy.first_dirty_node = 0;
+	return hierarchy;
+}
+
+void update_world_transforms(TransformHierarchy& hierarchy, JobSystem& job_system)
+{
+	PROFILE_FUNCTION();
+
+	uint32_t node_count = static_cast<uint32_t>(hierarchy.parents.size());
+	if (hierarchy.first_dirty_node >= node_count) {
+		return;
+	}
+
+	// Every level before the one holding the first dirty node is unchanged.
+	auto first_level = std::upper_bound(hierarchy.level_offsets.begin(), hierarchy.level_offsets.end(), hierarchy.first_dirty_node) - 1;
+	for (auto level = first_level; level + 1 != hierarchy.level_offsets.end(); ++level) {
+		uint32_t level_begin = std::max(*level, hierarchy.first_dirty_node);
+		uint32_t level_end = *(level + 1);
+
+		// Levels rarely start on an aligned node, so the ranges are laid out from the aligned node before it and the first range skips what isn't in the level.
+		uint32_t aligned_begin = level_begin / TRANSFORM_RANGE_ALIGNMENT * TRANSFORM_RANGE_ALIGNMENT;
+		job_system.parallel_for(level_end - aligned_begin, MIN_TRANSFORM_RANGE_SIZE, TRANSFORM_RANGE_ALIGNMENT, [&](std::size_t begin, std::size_t end, std::size_t range_index) {
+			for (std::size_t node = std::max<std::size_t>(aligned_begin + begin, level_begin); node < aligned_begin + end; ++node) {
+				uint32_t parent = hierarchy.parents[node];
+
+				// A parent's flag is still set here if it changed, so the change reaches every descendant one level at a time.
+				if (parent == NO_PARENT) {
+					if (hierarchy.dirty[node]) {
+						hierarchy.world_matrices[node] = hierarchy.local_matrices[node];
+					}
+				}
+				else if (hierarchy.dirty[node] || hierarchy.dirty[parent]) {
+					hierarchy.dirty[node] = 1;
+					hierarchy.world_matrices[node] = hierarchy.world_matrices[parent] * hierarchy.local_matrices[node];
+				}
+			}
+		});
+	}
+
+	std::fill(hierarchy.dirty.begin() + hierarchy.first_dirty_node, hierarchy.dirty.end(), uint8_t{ 0 });
+	hierarchy.first_dirty_node = node_count;
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <span>
+#include <new>
+#include <glm/glm.hpp>
+#include "job_system.h"
+
+// Parent relative (local) and scene relative (world) transforms of every node in a scene, stored as a structure of arrays sorted by depth.
+// Every parent comes before its children and the nodes at each depth are contiguous, so the world matrices can be updated one level at a time
+// with the nodes of a level split across threads, each reading only world matrices finished in the previous level.
+//
+// Only nodes whose local transform was set since the last update, and their descendants, are recomputed. Levels above the first changed node are skipped entirely.
+
+static constexpr uint32_t NO_PARENT = UINT32_MAX;
+
+// Allocates on a cache line boundary, so that a node index aligned to a cache line's worth of elements is also aligned in memory.
+template<typename T>
+struct CacheLineAllocator {
+	using value_type = T;
+
+	CacheLineAllocator() = default;
+
+	template<typename U>
+	CacheLineAllocator(const CacheLineAllocator<U>&) {}
+
+	T* allocate(std::size_t count) {
+		return static_cast<T*>(::operator new(count * sizeof(T), std::align_val_t{ 64 }));
+	}
+
+	void deallocate(T* data, std::size_t count) {
+		::operator delete(data, count * sizeof(T), std::align_val_t{ 64 });
+	}
+
+	template<typename U>
+	bool operator==(const CacheLineAllocator<U>&) const { return true; }
+};
+
+struct TransformHierarchy {
+	std::vector<uint32_t> parents{};
+	std::vector<glm::mat4> local_matrices{};
+	std::vector<glm::mat4> world_matrices{};
+
+	// A byte per node rather than a bit, so threads updating neighbouring nodes never write the same byte. update_world_transforms splits each level
+	// on multiples of 64 nodes, which with the cache line aligned storage means no two threads write the same line either.
+	std::vector<uint8_t, CacheLineAllocator<uint8_t>> dirty{};
+
+	// Level i holds the nodes [level_offsets[i], level_offsets[i + 1]).
+	std::vector<uint32_t> level_offsets{};
+
+	// Where each node given to build_transform_hierarchy ended up after sorting.
+	std::vector<uint32_t> node_by_source_index{};
+
+	// Lowest dirty node, or the node count when nothing has changed.
+	uint32_t first_dirty_node{ 0 };
+};
+
+// parents[i] is the index of node i's parent among the given nodes, or NO_PARENT for a root. Nodes may be given in any order but must not form a cycle.
+// Every node starts dirty.
+TransformHierarchy build_transform_hierarchy(std::span<const uint32_t> parents, std::span<const glm::mat4> local_matrices);
+
+// Takes a sorted node index, see node_by_source_index.
+inline void set_local_transform(TransformHierarchy& hierarchy, uint32_t node, const glm::mat4& local_matrix)
+{
+	hierarchy.local_matrices[node] = local_matrix;
+	hierarchy.dirty[node] = 1;
+	if (node < hierarchy.first_dirty_node) {
+		hierarchy.first_dirty_node = node;
+	}
+}
+
+// Recomputes the world matrix of every dirty node and its descendants, then clears the dirty flags.
+void update_world_transforms(TransformHierarchy& hierarchy, JobSystem& job_system);
@@ -5,6 +5,11 @@
 #include <glfw/glfw3.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <cmath>
+#include <algorithm>
+#include <iostream>
 
 #include <vulkan/vulkan.h>
 
@@ -23,6 +28,26 @@
 #include "descriptor_sets.h"
 #include "texture.h"
 #include "depth.h"
+#include "allocator.h"
+#include "mesh_pool.h"
+#include "deletion_queue.h"
+#include "memory_stats.h"
+#include "frame_settings.h"
+#include "frame_latency.h"
+#include "parallel_recording.h"
+#include "instance_buffer.h"
+#include "gpu_culling.h"
+#include "cpu_culling.h"
+#include "job_system.h"
+#include "job_system_benchmark.h"
+#include "simulation.h"
+#include "bvh.h"
+#include "transform_hierarchy.h"
+#include "draw_list.h"
+#include "offscreen.h"
+#include "frame_benchmark.h"
+#include "gpu_profiler.h"
+#include "cpu_profiler.h"
 
 /*
 static const std::vector<Vertex> vertices = {
@@ -52,25 +77,279 @@ static const std::vector<uint16_t> indices = {
 */
 
 const char* model_path = "meshes/viking_room.obj";
+const char* cooked_model_path = "meshes/viking_room.mesh";
 const char* texture_path = "textures/viking_room.png";
+const char* memory_report_path = "memory_report.json";
+const char* exit_memory_report_path = "memory_report_exit.json";
+
+// Parts of the frame timed on the GPU, see GpuProfiler.
+enum : uint32_t {
+	GPU_REGION_FRAME,
+	GPU_REGION_CULLING,
+	GPU_REGION_SCENE,
+	GPU_REGION_COUNT,
+};
+
+static constexpr std::array<const char*, GPU_REGION_COUNT> gpu_region_names{ "frame", "culling", "scene" };
+
+// Distance between neighbouring instances, a little more than the model is wide.
+static constexpr float INSTANCE_SPACING = 2.5f;
+
+// Everything the render thread needs from one simulation tick.
+struct SceneSnapshot {
+	double time{ 0.0 };
+	float camera_angle{ 0.0f };
+	std::vector<InstanceData> instances{};
+};
+
+static std::size_t get_instance_grid_width(std::size_t instance_count) {
+	return static_cast<std::size_t>(std::ceil(std::sqrt(static_cast<double>(instance_count))));
+}
+
+// How far the camera has to be pulled back, relative to a single model, to keep every instance in view.
+static float get_instance_grid_scale(std::size_t instance_count) {
+	float half_width = (get_instance_grid_width(instance_count) - 1) * INSTANCE_SPACING * 0.5f;
+	return std::max(1.0f, half_width);
+}
+
+// The instances form a small scene: a root, a node for each row of the grid, and each instance under its row.
+// Only the instances are animated, the root and rows are placed once.
+static TransformHierarchy build_instance_hierarchy(std::size_t instance_count) {
+	std::size_t grid_width = get_instance_grid_width(instance_count);
+	std::size_t row_count = grid_width == 0 ? 0 : (instance_count + grid_width - 1) / grid_width;
+	float grid_origin = -(grid_width - 1) * INSTANCE_SPACING * 0.5f;
+
+	std::vector<uint32_t> parents{ NO_PARENT };
+	std::vector<glm::mat4> local_matrices{ glm::mat4(1.0f) };
+	for (std::size_t row = 0; row < row_count; ++row) {
+		parents.push_back(0);
+		local_matrices.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(grid_origin, grid_origin + row * INSTANCE_SPACING, 0.0f)));
+	}
+
+	for (std::size_t i = 0; i < instance_count; ++i) {
+		parents.push_back(static_cast<uint32_t>(1 + i / grid_width));
+		local_matrices.push_back(glm::mat4(1.0f));
+	}
+
+	return build_transform_hierarchy(parents, local_matrices);
+}
+
+// Lays the instances out in a square grid, each spinning at its own offset so it is visible that they are transformed independently.
+static void layout_instances(TransformHierarchy& hierarchy, JobSystem& job_system, std::span<InstanceData> instances, float time) {
+	PROFILE_FUNCTION();
+
+	std::size_t grid_width = get_instance_grid_width(instances.size());
+	std::size_t first_instance_node = hierarchy.node_by_source_index.size() - instances.size();
+
+	for (std::size_t i = 0; i < instances.size(); ++i) {
+		glm::vec3 position((i % grid_width) * INSTANCE_SPACING, 0.0f, 0.0f);
+		float angle = (instances.size() > 1 ? time * glm::radians(45.0f) : 0.0f) + i * 0.5f;
+		uint32_t node = hierarchy.node_by_source_index[first_instance_node + i];
+		set_local_transform(hierarchy, node, glm::rotate(glm::translate(glm::mat4(1.0f), position), angle, glm::vec3(0.0f, 0.0f, 1.0f)));
+	}
+
+	update_world_transforms(hierarchy, job_system);
+
+	for (std::size_t i = 0; i < instances.size(); ++i) {
+		instances[i].model = hierarchy.world_matrices[hierarchy.node_by_source_index[first_instance_node + i]];
+	}
+}
+
+static void gather_instances(std::span<const InstanceData> instances, std::span<const uint32_t> indices, std::vector<InstanceData>& out_instances) {
+	out_instances.clear();
+	for (uint32_t index : indices) {
+		out_instances.push_back(instances[index]);
+	}
+}
+
+// Moves the bounding sphere of every instance into world space, then gathers the instances that are in view.
+static void cull_instances(std::span<const InstanceData> instances, const glm::vec4& bounding_sphere, const FrustumPlanes& frustum_planes, JobSystem& job_system, CullBoundsTable& bounds_table, CullResults& cull_results, std::vector<InstanceData>& out_visible_instances) {
+	PROFILE_FUNCTION();
+
+	job_system.parallel_for(instances.size(), 16 * 1024, 1, [&](std::size_t begin, std::size_t end, std::size_t range_index) {
+		for (std::size_t i = begin; i < end; ++i) {
+			const glm::mat4& model = instances[i].model;
+
+			// The sphere grows with the largest scale on any axis so it still bounds the mesh after a non-uniform scale.
+			float scale = std::max({ glm::length(glm::vec3(model[0])), glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2])) });
+			set_cull_bounds(bounds_table, i, glm::vec3(model * glm::vec4(glm::vec3(bounding_sphere), 1.0f)), bounding_sphere.w * scale);
+		}
+	});
+
+	cull_bounds(bounds_table, frustum_planes, job_system, cull_results);
+	gather_instances(instances, cull_results.visible, out_visible_instances);
+}
+
+static void update_instance_bounds(std::span<const InstanceData> instances, const Aabb& mesh_bounds, JobSystem& job_system, std::vector<Aabb>& out_bounds) {
+	PROFILE_FUNCTION();
+
+	out_bounds.resize(instances.size());
+	job_system.parallel_for(instances.size(), 16 * 1024, 1, [&](std::size_t begin, std::size_t end, std::size_t range_index) {
+		for (std::size_t i = begin; i < end; ++i) {
+			out_bounds[i] = transform_aabb(mesh_bounds, instances[i].model);
+		}
+	});
+}
+
+// Casts a ray from the camera through the cursor and returns the nearest instance it hits.
+static std::optional<uint32_t> pick_instance(GLFWwindow* window, const glm::mat4& view_projection, const Bvh& bvh, std::span<const Aabb> instance_bounds) {
+	double cursor_x = 0.0;
+	double cursor_y = 0.0;
+	int width = 0;
+	int height = 0;
+	glfwGetCursorPos(window, &cursor_x, &cursor_y);
+	glfwGetWindowSize(window, &width, &height);
+	if (width == 0 || height == 0) {
+		return std::nullopt;
+	}
+
+	// Vulkan's normalised device coordinates have y pointing down, the same as window coordinates.
+	glm::vec2 ndc(2.0f * static_cast<float>(cursor_x) / width - 1.0f, 2.0f * static_cast<float>(cursor_y) / height - 1.0f);
 
-static void update(UniformBuffer& uniform_buffer, VkExtent2D swapchain_extent) {
+	// Any two depths inside the clip volume give two points on the ray.
+	glm::mat4 inverse_view_projection = glm::inverse(view_projection);
+	glm::vec4 near_point = inverse_view_projection * glm::vec4(ndc, 0.0f, 1.0f);
+	glm::vec4 far_point = inverse_view_projection * glm::vec4(ndc, 1.0f, 1.0f);
+	glm::vec3 origin = glm::vec3(near_point) / near_point.w;
+	glm::vec3 direction = glm::vec3(far_point) / far_point.w - origin;
+
+	std::optional<BvhHit> hit = raycast_bvh(bvh, instance_bounds, origin, direction);
+	if (!hit) {
+		return std::nullopt;
+	}
+
+	return hit->object_index;
+}
+
+static float get_far_plane(float scene_scale) {
+	return 10.0f * scene_scale;
+}
+
+// Opaque draws are keyed by their state and then by the depth of their origin, an instanced draw by the centre of the grid.
+static void update_draw_sort_keys(std::span<DrawItem> draws, const glm::mat4& view_projection, float scene_scale) {
+	PROFILE_FUNCTION();
+
+	for (DrawItem& draw : draws) {
+		// For a perspective projection w is the distance along the view direction.
+		glm::vec4 clip_position = view_projection * draw.object_constants.model[3];
+
+		// A mesh is identified by where its indices start in the mesh pool.
+		draw.sort_key = make_draw_sort_key(DrawPass::Opaque, draw.pipeline_index, draw.object_constants.material_index, draw.mesh.first_index, clip_position.w / get_far_plane(scene_scale));
+	}
+}
+
+static float get_camera_angle(double time) {
+	return static_cast<float>(time) * glm::radians(90.0f);
+}
+
+// Blends the instances of two consecutive snapshots. Matrices are blended component by component, which is close enough to the true rotation
+// for the few degrees an instance turns in one tick.
+static void interpolate_instances(std::span<const InstanceData> previous, std::span<const InstanceData> current, float alpha, JobSystem& job_system, std::vector<InstanceData>& out_instances) {
+	PROFILE_FUNCTION();
+
+	out_instances.resize(current.size());
+	if (previous.size() != current.size()) {
+		std::copy(current.begin(), current.end(), out_instances.begin());
+		return;
+	}
+
+	job_system.parallel_for(current.size(), 16 * 1024, 1, [&](std::size_t begin, std::size_t end, std::size_t range_index) {
+		for (std::size_t i = begin; i < end; ++i) {
+			out_instances[i].model = previous[i].model + (current[i].model - previous[i].model) * alpha;
+		}
+	});
+}
+
+static glm::mat4 update(UniformBuffer& uniform_buffer, VkExtent2D swapchain_extent, float scene_scale, float camera_angle) {
 
 	UniformBufferContent uniform_buffer_content{};
-	static auto startTime = std::chrono::high_resolution_clock::now();
-	auto currentTime = std::chrono::high_resolution_clock::now();
-	float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
-	uniform_buffer_content.transform =
-		glm::perspective(glm::radians(45.0f), swapchain_extent.width / (float)swapchain_extent.height, 0.1f, 10.0f) *
-		glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)) *
-		glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+
+	// The camera orbits the scene rather than the model spinning, the model matrices are recorded into the cached command buffers and only change with the draw list.
+	uniform_buffer_content.view_projection =
+		glm::perspective(glm::radians(45.0f), swapchain_extent.width / (float)swapchain_extent.height, 0.1f, get_far_plane(scene_scale)) *
+		glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f) * scene_scale, glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, -1.0f)) *
+		glm::rotate(glm::mat4(1.0f), camera_angle, glm::vec3(0.0f, 0.0f, 1.0f));
 
 	memcpy(uniform_buffer.mapped_region, &uniform_buffer_content, sizeof(UniformBufferContent));
+	return uniform_buffer_content.view_projection;
 }
 
 
 
-void record_render_commands(VkPipeline render_pipeline, VkRenderPass render_pass, VkFramebuffer frame_buffer, VkExtent2D swapchain_extent, VkDescriptorSet descriptor_set, VkPipelineLayout pipeline_layout, VkBuffer vertex_buffer, VkBuffer index_buffer, std::size_t index_count, VkCommandBuffer command_buffer) {
+// Records a range of the draw list into a secondary command buffer, called from the recording workers.
+// Secondary buffers don't inherit any state from the primary buffer, so everything the draws need is bound again here.
+// The draws are sorted so that state is shared between neighbours, anything already bound by an earlier draw isn't bound again.
+static void record_scene_draws(std::span<const VkPipeline> render_pipelines, VkExtent2D swapchain_extent, VkDescriptorSet descriptor_set, VkPipelineLayout pipeline_layout, const MeshPool& mesh_pool, const InstanceRingBuffer& instance_buffer, const GpuCulling* gpu_culling, std::size_t frame_index, std::span<const DrawItem> draws, VkCommandBuffer command_buffer) {
+	PROFILE_FUNCTION();
+
+	// We specified that the following values must be provided at run-time during draw calls to support resizing the window, so these are provided here.
+	VkViewport viewport{};
+	viewport.x = 0.0f;
+	viewport.y = 0.0f;
+	viewport.width = static_cast<float>(swapchain_extent.width);
+	viewport.height = static_cast<float>(swapchain_extent.height);
+	viewport.minDepth = 0.0f;
+	viewport.maxDepth = 1.0f;
+	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+	VkRect2D scissor{};
+	scissor.offset = { 0, 0 };
+	scissor.extent = swapchain_extent;
+	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+	// Every mesh lives in the same vertex and index buffers, so they are bound once no matter how many meshes are drawn.
+	bind_mesh_pool(command_buffer, mesh_pool);
+
+	// Descriptor sets are bound to the layout rather than a pipeline, and every pipeline shares the layout, so the set stays bound when the pipeline changes.
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
+
+	// The culling shader has already written the draws and their transforms, so the whole scene is one command.
+	if (gpu_culling != nullptr) {
+		vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, render_pipelines[0]);
+		push_object_constants(command_buffer, pipeline_layout, ObjectPushConstants{});
+		draw_culled_objects(*gpu_culling, command_buffer, frame_index);
+		return;
+	}
+
+	// Instanced draws read the frame's instances, the others a single identity instance.
+	VkPipeline bound_pipeline = VK_NULL_HANDLE;
+	std::optional<bool> instanced_binding{};
+	const ObjectPushConstants* pushed_constants = nullptr;
+	for (const DrawItem& draw : draws) {
+		VkPipeline render_pipeline = render_pipelines[draw.pipeline_index];
+		if (render_pipeline != bound_pipeline) {
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, render_pipeline);
+			bound_pipeline = render_pipeline;
+		}
+
+		if (pushed_constants == nullptr || pushed_constants->model != draw.object_constants.model || pushed_constants->material_index != draw.object_constants.material_index) {
+			push_object_constants(command_buffer, pipeline_layout, draw.object_constants);
+			pushed_constants = &draw.object_constants;
+		}
+
+		if (instanced_binding != draw.instanced) {
+			if (draw.instanced) {
+				bind_instance_buffer(command_buffer, instance_buffer, frame_index);
+			}
+			else {
+				bind_identity_instance(command_buffer, instance_buffer);
+			}
+
+			instanced_binding = draw.instanced;
+		}
+
+		if (draw.instanced) {
+			draw_instances(command_buffer, instance_buffer, frame_index);
+		}
+		else {
+			draw_mesh(command_buffer, draw.mesh);
+		}
+	}
+}
+
+void record_render_commands(VkRenderPass render_pass, VkFramebuffer frame_buffer, VkExtent2D swapchain_extent, const GpuCulling* gpu_culling, const GpuProfiler& gpu_profiler, std::size_t frame_index, std::span<const VkCommandBuffer> secondary_command_buffers, VkCommandBuffer command_buffer) {
+	PROFILE_FUNCTION();
+
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 	beginInfo.flags = 0; // Optional <- possible flags include: VK_COMMAND_BUFFER_USAGE_ONETIME_SUBMIT_BIT <- if the buffer only needs to be submitted once (maybe for some initial GPU set up). VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT <- this buffer is a secondary buffer that will be used within a single render pass. VK_COMMAND_BUFFER_USAGE_SIMULATANEOUS_USE_BIT <- can be submitted again while still pending execution.
@@ -81,6 +360,16 @@ void record_render_commands(VkPipeline render_pipeline, VkRenderPass render_pass
 		log_error("Failed to start recording command buffer.");
 	}
 
+	record_gpu_profiler_reset(gpu_profiler, command_buffer, frame_index);
+	record_gpu_region_begin(gpu_profiler, command_buffer, frame_index, GPU_REGION_FRAME);
+
+	// Dispatches aren't allowed inside a render pass, so culling is recorded first.
+	if (gpu_culling != nullptr) {
+		record_gpu_region_begin(gpu_profiler, command_buffer, frame_index, GPU_REGION_CULLING);
+		record_gpu_culling(*gpu_culling, command_buffer, frame_index);
+		record_gpu_region_end(gpu_profiler, command_buffer, frame_index, GPU_REGION_CULLING);
+	}
+
 	// Drawing commands:
 
 	VkRenderPassBeginInfo render_pass_info{};
@@ -100,191 +389,578 @@ void record_render_commands(VkPipeline render_pipeline, VkRenderPass render_pass
 
 	// Begin render pass with framebuffer data specified in render pass info, along with the specified load and store OPs. 
 	// The third parameter is to notify if we are executing all of the rendering commands from the primary command buffer or if we are using secondary command buffers too.
-	vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
+	// The draws are recorded in parallel into secondary buffers, so the subpass can only contain vkCmdExecuteCommands.
+	// The subpass can only execute secondary buffers, so the scene is timed around the whole render pass.
+	record_gpu_region_begin(gpu_profiler, command_buffer, frame_index, GPU_REGION_SCENE);
+	vkCmdBeginRenderPass(command_buffer, &render_pass_info, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+	vkCmdExecuteCommands(command_buffer, static_cast<uint32_t>(secondary_command_buffers.size()), secondary_command_buffers.data());
+	vkCmdEndRenderPass(command_buffer);
+	record_gpu_region_end(gpu_profiler, command_buffer, frame_index, GPU_REGION_SCENE);
+	record_gpu_region_end(gpu_profiler, command_buffer, frame_index, GPU_REGION_FRAME);
 
-	// Bind the render pipeline info we provided (shaders, configuration for fixed functions).
-	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, render_pipeline);
+	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+		log_error("Failed to record commands to command buffer.");
+	}
+}
 
-	// We specified that the following values must be provided at run-time during draw calls to support resizing the window, so these are provided here.
-	VkViewport viewport{};
-	viewport.x = 0.0f;
-	viewport.y = 0.0f;
-	viewport.width = static_cast<float>(swapchain_extent.width);
-	viewport.height = static_cast<float>(swapchain_extent.height);
-	viewport.minDepth = 0.0f;
-	viewport.maxDepth = 1.0f;
-	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+// Only the swapchain and the targets sized to it are rebuilt. The pipeline uses a dynamic viewport and scissor so it is kept,
+// and everything replaced is queued for destruction once the frames using it have retired, rather than idling the device.
+static void recreate_swapchain(GLFWwindow* window, VkSurfaceKHR window_surface, VkPhysicalDevice physical_device, VkDevice device, DeviceDetails& device_details, DeletionQueue& deletion_queue, VkRenderPass render_pass, const FrameSettings& frame_settings, UniqueSwapchain& swapchain, SwapchainImages& swapchain_images, DepthBuffer& depth_buffer, RenderTargets& render_targets, CommandRecordingCache& recording_cache) {
+	PROFILE_FUNCTION();
+
+	// A minimised window has a zero sized framebuffer which can't back a swapchain, so wait until it is restored.
+	int width = 0, height = 0;
+	glfwGetFramebufferSize(window, &width, &height);
+	while ((width == 0 || height == 0) && !glfwWindowShouldClose(window)) {
+		glfwWaitEvents();
+		glfwGetFramebufferSize(window, &width, &height);
+	}
 
-	VkRect2D scissor{};
-	scissor.offset = { 0, 0 };
-	scissor.extent = swapchain_extent;
-	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+	if (width == 0 || height == 0) {
+		return;
+	}
 
-	VkBuffer vertexBuffers[] = { vertex_buffer };
-	VkDeviceSize offsets[] = { 0 };
-	vkCmdBindVertexBuffers(command_buffer, 0, 1, vertexBuffers, offsets);
+	refresh_surface_capabilities(physical_device, window_surface, device_details.swapchain);
+	swapchain = UniqueSwapchain{ deletion_queue, create_swapchain(window, window_surface, device, device_details.queue_family_index_by_feature[FEATURE_GRAPHICS], device_details.queue_family_index_by_feature[FEATURE_PRESENT], device_details.swapchain, swapchain_images, frame_settings.present_mode, frame_settings.swapchain_image_count, swapchain.get()) };
+	depth_buffer = create_depth_buffer(device, physical_device, deletion_queue, swapchain_images.extent.width, swapchain_images.extent.height);
+	render_targets = create_render_targets(device, deletion_queue, render_pass, swapchain_images, depth_buffer.view.get());
 
+	// Every recording references the old framebuffers.
+	resize_command_recording_cache(recording_cache, swapchain_images.images.size());
+}
 
-	vkCmdBindIndexBuffer(command_buffer, index_buffer, 0, VK_INDEX_TYPE_UINT32);
-	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout, 0, 1, &descriptor_set, 0, nullptr);
-	vkCmdDrawIndexed(command_buffer, static_cast<uint32_t>(index_count), 1, 0, 0, 0);
+// Frame slots past the new count will no longer be waited on, so everything must have finished with them before switching.
+static void set_frames_in_flight(VkDevice device, DeletionQueue& deletion_queue, const FrameExecutions& frame_executions, FrameSettings& frame_settings, std::size_t frames_in_flight, std::size_t& current_executing_frame) {
+	std::array<VkFence, MAX_FRAMES_IN_FLIGHT> fences{};
+	for (std::size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+		fences[i] = frame_executions[i].sync.in_flight_fence;
+	}
 
-	//vkCmdDraw(command_buffer, vertices.size(), 1, 0, 0);
+	vkWaitForFences(device, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX);
+	flush_deletion_queue(deletion_queue);
 
-	vkCmdEndRenderPass(command_buffer);
+	frame_settings.frames_in_flight = clamp_frames_in_flight(frames_in_flight);
+	current_executing_frame = 0;
+}
 
-	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
-		log_error("Failed to record commands to command buffer.");
+static bool should_keep_running(GLFWwindow* window, const FrameSettings& frame_settings, uint64_t rendered_frame_count) {
+	if (frame_settings.frame_count != 0 && rendered_frame_count >= frame_settings.frame_count) {
+		return false;
 	}
+
+	return window == nullptr || !glfwWindowShouldClose(window);
 }
 
-int main() {
+int main(int argc, char** argv) {
 
-	Mesh mesh = load_mesh(model_path).value();
+	FrameSettings frame_settings = parse_frame_settings(argc, argv);
+	set_upload_path(frame_settings.upload_path);
+
+	// Started before anything else so the trace covers start-up as well.
+	if (frame_settings.profile_trace_path != nullptr) {
+		enable_cpu_profiler();
+		set_profiler_thread_name("main");
+	}
+	if (frame_settings.job_benchmark) {
+		run_job_system_benchmark();
+		return 0;
+	}
+
+	// Culling, transform updates and command recording are split into jobs. The first run parses and cooks the model on a worker while the window and device
+	// are created, later runs map the cooked mesh straight into the mesh pool. The simulation thread is given a place too, so its transform updates are split into jobs as well.
+	JobSystem job_system(SIZE_MAX, 1);
+	JobCounter mesh_cooked{};
+	job_system.run(mesh_cooked, []() { cook_mesh(model_path, cooked_model_path); });
 
 	DeviceDetails device_details{};
 	QueueByFeature queue_by_feature{};
 	SwapchainImages swapchain_images{};
 
-	GLFWwindow* window = create_window(1200, 800, "Hello mesh");
-	VkInstance instance = create_vulkan_instance();
-	VkSurfaceKHR window_surface = create_window_surface(instance, window);
+	// Headless runs have no window or surface at all, window stays null and frames render into offscreen images instead of the swapchain.
+	GLFWwindow* window = nullptr;
+	bool framebuffer_resized = false;
+	if (!frame_settings.headless) {
+		window = create_window(static_cast<int>(frame_settings.width), static_cast<int>(frame_settings.height), "Hello mesh");
+		track_framebuffer_resize(window, framebuffer_resized);
+	}
+
+	VkInstance instance = create_vulkan_instance(frame_settings.headless);
+	VkSurfaceKHR window_surface = window != nullptr ? create_window_surface(instance, window) : VK_NULL_HANDLE;
 	VkPhysicalDevice physical_device = pick_physical_device(instance, window_surface, device_details);
-	VkDevice device = create_device(physical_device, device_details.queue_family_index_by_feature, queue_by_feature);
-	VkSwapchainKHR swapchain = create_swapchain(window, window_surface, device, device_details.queue_family_index_by_feature[FEATURE_GRAPHICS], device_details.queue_family_index_by_feature[FEATURE_PRESENT], device_details.swapchain, swapchain_images);
-	DepthBuffer depth_buffer = create_depth_buffer(device, physical_device, swapchain_images.extent.width, swapchain_images.extent.height);
-	VkRenderPass render_pass = create_render_pass(device, swapchain_images.format, depth_buffer.format);
-	RenderTargets render_targets = create_render_targets(device, render_pass, swapchain, swapchain_images, depth_buffer.view);
-	ShaderByStage shader_by_stage = create_shaders(device, "vert.spv", "frag.spv");
-	PipelineResources pipeline_resources = create_pipeline_resources(device);
-	VkPipeline pipeline = create_render_pipeline(device, render_pass, pipeline_resources.pipeline_layout, shader_by_stage, swapchain_images.extent);
-	VkCommandPool command_pool = create_command_pool(device, device_details.queue_family_index_by_feature[FEATURE_GRAPHICS], true, false);
+	init_memory_stats(physical_device);
+	VkDevice device = create_device(physical_device, device_details.queue_family_index_by_feature, device_details.enabled_extensions, device_details.enabled_features, queue_by_feature);
+
+	// Resources owned by handles are queued for destruction when they go out of scope at the end of this block, and destroyed once the device is idle.
+	DeletionQueue deletion_queue = create_deletion_queue(device);
+	{
+		UniqueSwapchain swapchain{};
+		OffscreenImages offscreen_images{};
+		if (window != nullptr) {
+			swapchain = UniqueSwapchain{ deletion_queue, create_swapchain(window, window_surface, device, device_details.queue_family_index_by_feature[FEATURE_GRAPHICS], device_details.queue_family_index_by_feature[FEATURE_PRESENT], device_details.swapchain, swapchain_images, frame_settings.present_mode, frame_settings.swapchain_image_count) };
+		}
+		else {
+			uint32_t offscreen_image_count = std::max(frame_settings.swapchain_image_count, static_cast<uint32_t>(frame_settings.frames_in_flight));
+			offscreen_images = create_offscreen_images(device, physical_device, deletion_queue, VkExtent2D{ frame_settings.width, frame_settings.height }, offscreen_image_count, swapchain_images);
+		}
 
-	Texture texture = create_texture(device, physical_device, command_pool, queue_by_feature[FEATURE_GRAPHICS], texture_path);
-	VkSampler sampler = create_sampler(device, device_details.max_anistropy_samples);
+		DepthBuffer depth_buffer = create_depth_buffer(device, physical_device, deletion_queue, swapchain_images.extent.width, swapchain_images.extent.height);
+		VkRenderPass render_pass = create_render_pass(device, swapchain_images.format, depth_buffer.format, window != nullptr ? VK_IMAGE_LAYOUT_PRESENT_SRC_KHR : OFFSCREEN_FINAL_LAYOUT);
+		RenderTargets render_targets = create_render_targets(device, deletion_queue, render_pass, swapchain_images, depth_buffer.view.get());
+		ShaderByStage shader_by_stage = create_shaders(device, "vert.spv", "frag.spv");
+		PipelineResources pipeline_resources = create_pipeline_resources(device);
+		UniquePipeline pipeline{ deletion_queue, create_render_pipeline(device, render_pass, pipeline_resources.pipeline_layout, shader_by_stage, swapchain_images.extent) };
+		VkCommandPool command_pool = create_command_pool(device, device_details.queue_family_index_by_feature[FEATURE_GRAPHICS], true, false);
 
-	VkDescriptorPool descriptor_pool = create_descriptor_pool(device, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, false, MAX_FRAMES_IN_FLIGHT, MAX_FRAMES_IN_FLIGHT);
+		CommandRecordingCache recording_cache = create_command_recording_cache(device, command_pool, swapchain_images.images.size());
 
-	//Multiple frames can be queued up while we wait asynchronously for the GPU to do the render commands. 
-	FrameExecutions frame_executions = create_frame_executions(device, command_pool);
-	FrameUniformBuffers frame_uniform_buffers = create_frame_uniform_buffers(device, physical_device);
-	FrameDescriptorSets frame_descriptor_sets = create_frame_descriptor_sets(device, descriptor_pool, pipeline_resources.descriptor_set_layout, frame_uniform_buffers, texture.view, sampler);
+		// Times the passes of every frame on the GPU, the results are read back once each frame's fence has signalled.
+		GpuProfiler gpu_profiler = create_gpu_profiler(device, physical_device, device_details.queue_family_index_by_feature[FEATURE_GRAPHICS], gpu_region_names);
 
-	// Create buffers:
+		// The draw list is split across worker threads, each recording into secondary buffers from its own command pool.
+		ParallelRecorder parallel_recorder = create_parallel_recorder(device, device_details.queue_family_index_by_feature[FEATURE_GRAPHICS], job_system.get_thread_count());
 
-	auto [gpu_vertex_buffer, gpu_vertex_memory] = create_gpu_buffer<Vertex>(device, physical_device, command_pool, queue_by_feature[FEATURE_GRAPHICS], VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 0, mesh.vertices);
-	auto [gpu_index_buffer, gpu_index_memory] = create_gpu_buffer<uint32_t>(device, physical_device, command_pool, queue_by_feature[FEATURE_GRAPHICS], VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 0, mesh.indices);
+		// Sub-allocates the texture and the mesh pool out of large memory blocks, and compacts them a little each frame.
+		GpuAllocator gpu_allocator = create_gpu_allocator(device, physical_device, command_pool);
+		DefragmentBudget defragment_budget{};
 
-	// game loop:
+		// Uploads and layout transitions are recorded into recycled command buffers from their own transient pool.
+		TransientCommandPool transient_pool = create_transient_command_pool(device, device_details.queue_family_index_by_feature[FEATURE_GRAPHICS], queue_by_feature[FEATURE_GRAPHICS]);
 
-	std::size_t current_executing_frame = 0;
-	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
+		Texture texture = create_texture(device, physical_device, deletion_queue, transient_pool, gpu_allocator, texture_path);
+		UniqueSampler sampler{ deletion_queue, create_sampler(device, device_details.max_anistropy_samples) };
 
-		update(frame_uniform_buffers[current_executing_frame], swapchain_images.extent);
+		VkDescriptorPool descriptor_pool = create_descriptor_pool(device, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, false, MAX_FRAMES_IN_FLIGHT, MAX_FRAMES_IN_FLIGHT);
 
-		SyncObjects& sync_objects = frame_executions[current_executing_frame].sync;
-		VkCommandBuffer command_buffer = frame_executions[current_executing_frame].command_buffer;
+		//Multiple frames can be queued up while we wait asynchronously for the GPU to do the render commands. 
+		FrameExecutions frame_executions = create_frame_executions(device);
+		FrameUniformBuffers frame_uniform_buffers = create_frame_uniform_buffers(device, physical_device);
+		FrameDescriptorSets frame_descriptor_sets = create_frame_descriptor_sets(device, descriptor_pool, pipeline_resources.descriptor_set_layout, frame_uniform_buffers, texture.view.get(), sampler.get());
 
-		vkWaitForFences(device, 1, &sync_objects.in_flight_fence, VK_TRUE, UINT64_MAX);
-		vkResetFences(device, 1, &sync_objects.in_flight_fence);
+		// Create buffers:
 
-		uint32_t image_index;
-		vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, sync_objects.image_available_semaphore, VK_NULL_HANDLE, &image_index);
+		job_system.wait(mesh_cooked);
+		MeshPool mesh_pool = create_mesh_pool(gpu_allocator);
+		CookedMeshHeader mesh_header{};
+		MeshRange mesh_range = add_cooked_mesh(device, physical_device, device_details, transient_pool, mesh_pool, cooked_model_path, mesh_header);
+		if (mesh_range.index_count == 0) {
+			// The mesh couldn't be cooked or the cooked file couldn't be read, so parse the obj the slow way.
+			Mesh mesh = load_mesh(model_path).value();
+			mesh_range = add_mesh(device, physical_device, transient_pool, mesh_pool, mesh);
+			mesh_header.bounding_sphere = get_bounding_sphere(mesh);
+			mesh_header.bounding_box = get_bounding_box(mesh);
+		}
 
-		vkResetCommandBuffer(command_buffer, 0);
-		record_render_commands(pipeline, render_pass, render_targets.framebuffers[static_cast<std::size_t>(image_index)], swapchain_images.extent, frame_descriptor_sets[current_executing_frame], pipeline_resources.pipeline_layout, gpu_vertex_buffer, gpu_index_buffer, mesh.indices.size(), command_buffer);
+		// Once the defragmenter has moved the texture or the mesh pool, every recording references the old copy. A descriptor set can only be rewritten
+		// once its frame has retired, so each set is rewritten as its frame comes round.
+		std::array<bool, MAX_FRAMES_IN_FLIGHT> stale_texture_descriptors{};
+		if (texture.allocation != INVALID_GPU_RESOURCE) {
+			set_allocated_resource_moved_callback(gpu_allocator, texture.allocation, [&](const GpuResource& resource) {
+				update_texture_view(device, deletion_queue, texture, resource.image);
+				stale_texture_descriptors.fill(true);
+				invalidate_recorded_commands(recording_cache);
+			});
+		}
 
-		VkSubmitInfo submit_info{};
-		submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		auto on_mesh_pool_moved = [&](const GpuResource&) {
+			update_mesh_pool_buffers(gpu_allocator, mesh_pool);
+			invalidate_recorded_commands(recording_cache);
+		};
+		set_allocated_resource_moved_callback(gpu_allocator, mesh_pool.vertex_allocation, on_mesh_pool_moved);
+		set_allocated_resource_moved_callback(gpu_allocator, mesh_pool.index_allocation, on_mesh_pool_moved);
+		// Every copy of the model is drawn with one instanced draw, their transforms are rewritten into the frame's slice of the instance buffer each frame.
+		InstanceRingBuffer instance_buffer = create_instance_ring_buffer(device, physical_device, frame_settings.instance_count);
+		std::vector<InstanceData> instances(frame_settings.instance_count);
+		TransformHierarchy instance_transforms = build_instance_hierarchy(instances.size());
+		float scene_scale = get_instance_grid_scale(instances.size());
+
+		// Changing the draw list must invalidate the recorded commands, the per-object constants are recorded into them.
+		std::vector<DrawItem> draw_list{ DrawItem{ mesh_range, ObjectPushConstants{}, true } };
+		std::array<VkPipeline, 1> render_pipelines{ pipeline.get() };
+		DrawListSorter draw_list_sorter{};
+
+		// With CPU culling only the instances in view are written to the instance buffer.
+		CullBoundsTable cull_bounds_table{};
+		CullResults cull_results{};
+		std::vector<InstanceData> visible_instances{};
+		glm::vec4 mesh_bounding_sphere = mesh_header.bounding_sphere;
+		resize_cull_bounds_table(cull_bounds_table, instances.size());
+
+		// The hierarchy over the instances is used for picking, and for culling with --bvh-culling. Instances only spin in place,
+		// so it is built once and refit as they move rather than rebuilt.
+		Aabb mesh_bounding_box = mesh_header.bounding_box;
+		std::vector<Aabb> instance_bounds{};
+		layout_instances(instance_transforms, job_system, instances, 0.0f);
+		update_instance_bounds(instances, mesh_bounding_box, job_system, instance_bounds);
+		Bvh instance_bvh = build_bvh(instance_bounds);
+		std::vector<uint32_t> bvh_visible{};
+		std::optional<uint32_t> picked_instance{};
+
+		// The instances are animated at a fixed rate on the simulation thread, which owns the transform hierarchy from here on.
+		// Each frame draws between the two newest snapshots it has, so the frame rate and the tick rate don't have to match.
+		SnapshotBuffer<SceneSnapshot> scene_snapshots{};
+		float camera_angle = 0.0f;
+		std::size_t instance_count = instances.size();
+		SimulationThread simulation(frame_settings.tick_rate,
+			[&, instance_count](uint64_t tick, double time, double step) {
+				PROFILE_ZONE("simulation tick");
+				SceneSnapshot& snapshot = scene_snapshots.get_back();
+				snapshot.time = time;
+				snapshot.camera_angle = get_camera_angle(time);
+				snapshot.instances.resize(instance_count);
+				layout_instances(instance_transforms, job_system, snapshot.instances, static_cast<float>(time));
+				scene_snapshots.publish();
+			},
+			[&]() {
+				set_profiler_thread_name("simulation");
+				job_system.attach_current_thread();
+			});
+
+		// With GPU culling every instance becomes an object in the culling table instead, and only the ones in view are drawn.
+		bool use_gpu_culling = frame_settings.gpu_culling && device_details.supports_draw_indirect_count && device_details.enabled_features.drawIndirectFirstInstance;
+		if (frame_settings.gpu_culling && !use_gpu_culling) {
+			log_error("GPU culling needs VK_KHR_draw_indirect_count and drawIndirectFirstInstance, which the device doesn't support. Drawing every instance instead.");
+		}
 
-		// Wait until the image is available before submitting rendering commands. 
+		// Replaces the instanced draw with a draw per instance, refilled every frame from the instances that are drawn.
+		bool use_separate_draws = frame_settings.separate_draws && !use_gpu_culling;
 
-		VkSemaphore wait_semaphores[] = { sync_objects.image_available_semaphore };
-		VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-		submit_info.waitSemaphoreCount = 1;
-		submit_info.pWaitSemaphores = wait_semaphores;
-		submit_info.pWaitDstStageMask = wait_stages;
-		submit_info.commandBufferCount = 1;
-		submit_info.pCommandBuffers = &command_buffer;
+		GpuCulling gpu_culling{};
+		std::vector<GpuCullObject> cull_objects{};
+		if (use_gpu_culling) {
+			gpu_culling = create_gpu_culling(device, physical_device, "cull.spv", static_cast<uint32_t>(instances.size()));
 
-		VkSemaphore signal_semaphores[] = { sync_objects.render_finished_semaphore };
-		submit_info.signalSemaphoreCount = 1;
-		submit_info.pSignalSemaphores = signal_semaphores;
+			GpuCullObject cull_object{};
+			cull_object.bounding_sphere = mesh_bounding_sphere;
+			cull_object.index_count = mesh_range.index_count;
+			cull_object.first_index = mesh_range.first_index;
+			cull_object.vertex_offset = mesh_range.vertex_offset;
+			cull_objects.assign(instances.size(), cull_object);
+		}
 
-		if (vkQueueSubmit(queue_by_feature[FEATURE_GRAPHICS], 1, &submit_info, sync_objects.in_flight_fence) != VK_SUCCESS) {
-			log_error("Failed to submit queue for rendering");
+		// game loop:
+
+		std::size_t current_executing_frame = 0;
+		bool memory_report_key_down = false;
+		std::array<bool, MAX_FRAMES_IN_FLIGHT> frames_in_flight_keys_down{};
+		bool pick_button_down = false;
+		bool fewer_images_key_down = false;
+		bool more_images_key_down = false;
+		// Paces frames to the target rate and, with --low-latency, delays each frame so input is sampled as late as possible.
+		FrameLatencyController latency_controller = create_frame_latency_controller(frame_settings.reduce_latency, frame_settings.target_frames_per_second);
+		FrameClock::time_point last_title_update = FrameClock::now();
+		FrameClock::time_point run_start = FrameClock::now();
+		uint64_t rendered_frame_count = 0;
+		uint32_t last_image_index = 0;
+
+		// With --benchmark the CPU time of every frame is split into the stages marked below.
+		FrameBenchmark frame_benchmark = create_frame_benchmark(frame_settings.benchmark_warmup_frame_count, frame_settings.benchmark_frame_count);
+
+		while (should_keep_running(window, frame_settings, rendered_frame_count)) {
+			PROFILE_ZONE("frame");
+			begin_benchmark_frame(frame_benchmark);
+			wait_for_frame_start(latency_controller);
+			if (window != nullptr) {
+				glfwPollEvents();
+			}
+
+			record_input_sampled(latency_controller);
+
+			// Without a window there is no input, and the results are printed once the run is over.
+			if (window != nullptr) {
+				if (FrameClock::now() - last_title_update > std::chrono::seconds(1)) {
+					last_title_update = FrameClock::now();
+					std::stringstream title;
+					title << std::fixed << std::setprecision(1) << "Hello mesh - " << get_present_mode_name(swapchain_images.present_mode) << " - " << frame_settings.frames_in_flight << " frames in flight"
+						<< " - latency " << latency_controller.average_latency << " ms - fence wait " << latency_controller.average_fence_wait << " ms"
+						<< " - gpu " << get_gpu_region_average(gpu_profiler.regions[GPU_REGION_FRAME]) << " ms";
+					if (picked_instance) {
+						title << " - picked instance " << *picked_instance;
+					}
+					glfwSetWindowTitle(window, title.str().c_str());
+				}
+
+				// F12 dumps the current memory usage, so it can be compared over a long session.
+				if (was_key_pressed(window, GLFW_KEY_F12, memory_report_key_down)) {
+					write_memory_report(memory_report_path, &gpu_allocator);
+				}
+
+				// 1 to 3 set the number of frames in flight, [ and ] change the number of swapchain images.
+				for (std::size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+					if (was_key_pressed(window, GLFW_KEY_1 + static_cast<int>(i), frames_in_flight_keys_down[i])) {
+						set_frames_in_flight(device, deletion_queue, frame_executions, frame_settings, i + 1, current_executing_frame);
+					}
+				}
+
+				bool fewer_images = was_key_pressed(window, GLFW_KEY_LEFT_BRACKET, fewer_images_key_down);
+				bool more_images = was_key_pressed(window, GLFW_KEY_RIGHT_BRACKET, more_images_key_down);
+				if (fewer_images || more_images) {
+					uint32_t image_count = static_cast<uint32_t>(swapchain_images.images.size());
+					frame_settings.swapchain_image_count = more_images ? image_count + 1 : std::max(image_count, 2u) - 1;
+					recreate_swapchain(window, window_surface, physical_device, device, device_details, deletion_queue, render_pass, frame_settings, swapchain, swapchain_images, depth_buffer, render_targets, recording_cache);
+				}
+			}
+
+			// Clicking picks the instance under the cursor.
+			bool pick_requested = window != nullptr && was_mouse_button_pressed(window, GLFW_MOUSE_BUTTON_LEFT, pick_button_down);
+			mark_frame_stage(frame_benchmark, FrameStage::Poll);
+
+			// Drawn a tick behind the simulation, so the newest snapshot is usually still ahead of the time being drawn.
+			if (scene_snapshots.acquire()) {
+				const SceneSnapshot& previous = scene_snapshots.get_previous();
+				const SceneSnapshot& current = scene_snapshots.get_current();
+				double render_time = simulation.get_time() - simulation.get_step();
+				float alpha = static_cast<float>(std::clamp((render_time - previous.time) / std::max(current.time - previous.time, 1e-6), 0.0, 1.0));
+				camera_angle = previous.camera_angle + (current.camera_angle - previous.camera_angle) * alpha;
+				interpolate_instances(previous.instances, current.instances, alpha, job_system, instances);
+			}
+
+			glm::mat4 view_projection = update(frame_uniform_buffers[current_executing_frame], swapchain_images.extent, scene_scale, camera_angle);
+
+			SyncObjects& sync_objects = frame_executions[current_executing_frame].sync;
+			mark_frame_stage(frame_benchmark, FrameStage::Update);
+
+			wait_for_frame_fence(latency_controller, device, sync_objects.in_flight_fence, current_executing_frame);
+			mark_frame_stage(frame_benchmark, FrameStage::FenceWait);
+
+			read_gpu_profiler_results(gpu_profiler, current_executing_frame);
+
+			// Everything released while this frame was last recorded is no longer in use.
+			begin_deletion_frame(deletion_queue, current_executing_frame);
+
+			defragment_step(gpu_allocator, queue_by_feature[FEATURE_GRAPHICS], defragment_budget);
+			if (stale_texture_descriptors[current_executing_frame]) {
+				write_texture_descriptor(device, frame_descriptor_sets[current_executing_frame], texture.view.get(), sampler.get());
+				stale_texture_descriptors[current_executing_frame] = false;
+			}
+
+			// The GPU has finished with this frame's slice of the instance buffer.
+			bool use_bvh_culling = frame_settings.bvh_culling && !use_gpu_culling;
+			if (use_bvh_culling || pick_requested) {
+				update_instance_bounds(instances, mesh_bounding_box, job_system, instance_bounds);
+				refit_bvh(instance_bvh, instance_bounds);
+			}
+
+			if (pick_requested) {
+				picked_instance = pick_instance(window, view_projection, instance_bvh, instance_bounds);
+			}
+
+			if (use_gpu_culling) {
+				for (std::size_t i = 0; i < instances.size(); ++i) {
+					cull_objects[i].model = instances[i].model;
+				}
+
+				write_cull_objects(gpu_culling, current_executing_frame, extract_frustum_planes(view_projection), cull_objects);
+			}
+			else if (use_bvh_culling) {
+				bvh_visible.clear();
+				cull_bvh(instance_bvh, instance_bounds, extract_frustum_planes(view_projection), bvh_visible);
+				gather_instances(instances, bvh_visible, visible_instances);
+				write_instances(instance_buffer, current_executing_frame, mesh_range, visible_instances);
+			}
+			else if (frame_settings.cpu_culling) {
+				cull_instances(instances, mesh_bounding_sphere, extract_frustum_planes(view_projection), job_system, cull_bounds_table, cull_results, visible_instances);
+				write_instances(instance_buffer, current_executing_frame, mesh_range, visible_instances);
+			}
+			else {
+				write_instances(instance_buffer, current_executing_frame, mesh_range, instances);
+			}
+
+			// Every draw is the same mesh, so which draw takes which transform doesn't matter, they are put in order by the sort below.
+			// The transforms change every frame, so the recordings are always out of date.
+			if (use_separate_draws) {
+				std::span<const InstanceData> drawn_instances = use_bvh_culling || frame_settings.cpu_culling ? std::span<const InstanceData>(visible_instances) : std::span<const InstanceData>(instances);
+				draw_list.assign(drawn_instances.size(), DrawItem{ mesh_range, ObjectPushConstants{}, false });
+				for (std::size_t i = 0; i < drawn_instances.size(); ++i) {
+					draw_list[i].object_constants.model = drawn_instances[i].model;
+				}
+
+				invalidate_recorded_commands(recording_cache);
+			}
+
+			// The draws are recorded in sorted order, so the recordings are only out of date when the order actually changes.
+			update_draw_sort_keys(draw_list, view_projection, scene_scale);
+			if (sort_draw_list(draw_list_sorter, draw_list)) {
+				invalidate_recorded_commands(recording_cache);
+			}
+
+			mark_frame_stage(frame_benchmark, FrameStage::Update);
+
+			// An out of date swapchain can't be presented to at all, so it is replaced and the acquire retried within the same frame.
+			// The semaphore isn't signalled when the acquire fails, so it can be reused straight away.
+			uint32_t image_index;
+			if (window != nullptr) {
+				PROFILE_ZONE("acquire");
+				VkResult acquire_result = vkAcquireNextImageKHR(device, swapchain.get(), UINT64_MAX, sync_objects.image_available_semaphore, VK_NULL_HANDLE, &image_index);
+				while (acquire_result == VK_ERROR_OUT_OF_DATE_KHR && !glfwWindowShouldClose(window)) {
+					recreate_swapchain(window, window_surface, physical_device, device, device_details, deletion_queue, render_pass, frame_settings, swapchain, swapchain_images, depth_buffer, render_targets, recording_cache);
+					acquire_result = vkAcquireNextImageKHR(device, swapchain.get(), UINT64_MAX, sync_objects.image_available_semaphore, VK_NULL_HANDLE, &image_index);
+				}
+
+				if (acquire_result != VK_SUCCESS && acquire_result != VK_SUBOPTIMAL_KHR) {
+					continue;
+				}
+			}
+			else {
+				image_index = acquire_offscreen_image(offscreen_images);
+			}
+
+			mark_frame_stage(frame_benchmark, FrameStage::Acquire);
+
+			// The fence is only reset once work is certain to be submitted, otherwise the next wait on it would never return.
+			vkResetFences(device, 1, &sync_objects.in_flight_fence);
+
+			// Only the uniform buffer changes from frame to frame, so the commands are re-recorded only when something they reference has changed.
+			bool needs_recording = false;
+			VkCommandBuffer command_buffer = get_recorded_commands(recording_cache, current_executing_frame, image_index, needs_recording);
+			if (needs_recording) {
+				VkDescriptorSet descriptor_set = frame_descriptor_sets[current_executing_frame];
+				std::span<const VkCommandBuffer> secondary_command_buffers = record_secondary_commands(parallel_recorder, job_system, current_executing_frame, recording_cache.version, render_pass, 0, draw_list.size(),
+					[&](VkCommandBuffer secondary_command_buffer, std::size_t first_draw, std::size_t draw_count) {
+						record_scene_draws(render_pipelines, swapchain_images.extent, descriptor_set, pipeline_resources.pipeline_layout, mesh_pool, instance_buffer, use_gpu_culling ? &gpu_culling : nullptr, current_executing_frame, std::span<const DrawItem>(draw_list).subspan(first_draw, draw_count), secondary_command_buffer);
+					});
+				record_render_commands(render_pass, render_targets.framebuffers[static_cast<std::size_t>(image_index)].get(), swapchain_images.extent, use_gpu_culling ? &gpu_culling : nullptr, gpu_profiler, current_executing_frame, secondary_command_buffers, command_buffer);
+			}
+
+			mark_frame_stage(frame_benchmark, FrameStage::Record);
+
+			VkSubmitInfo submit_info{};
+			submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+
+			// Wait until the image is available before submitting rendering commands. 
+			// Offscreen images are always available and never presented, so headless frames only signal the fence.
+
+			uint32_t semaphore_count = window != nullptr ? 1 : 0;
+			VkSemaphore wait_semaphores[] = { sync_objects.image_available_semaphore };
+			VkPipelineStageFlags wait_stages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+			submit_info.waitSemaphoreCount = semaphore_count;
+			submit_info.pWaitSemaphores = wait_semaphores;
+			submit_info.pWaitDstStageMask = wait_stages;
+			submit_info.commandBufferCount = 1;
+			submit_info.pCommandBuffers = &command_buffer;
+
+			VkSemaphore signal_semaphores[] = { sync_objects.render_finished_semaphore };
+			submit_info.signalSemaphoreCount = semaphore_count;
+			submit_info.pSignalSemaphores = signal_semaphores;
+
+			{
+				PROFILE_ZONE("submit");
+				if (vkQueueSubmit(queue_by_feature[FEATURE_GRAPHICS], 1, &submit_info, sync_objects.in_flight_fence) != VK_SUCCESS) {
+					log_error("Failed to submit queue for rendering");
+				}
+			}
+
+			mark_gpu_profiler_submitted(gpu_profiler, current_executing_frame);
+
+			mark_frame_stage(frame_benchmark, FrameStage::Submit);
+
+			if (window != nullptr) {
+				PROFILE_ZONE("present");
+
+				// Wait for rendering to finish before submitting present command.
+				VkPresentInfoKHR present_info{};
+				present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+				present_info.waitSemaphoreCount = 1;
+				present_info.pWaitSemaphores = signal_semaphores;
+
+				VkSwapchainKHR swapChains[] = { swapchain.get() };
+				present_info.swapchainCount = 1;
+				present_info.pSwapchains = swapChains;
+				present_info.pImageIndices = &image_index;
+				present_info.pResults = nullptr; // Optional array of result values if using an array of swap chains.
+
+				// A suboptimal swapchain can still be presented to, so it is only replaced after this frame has been handed over.
+				VkResult present_result = vkQueuePresentKHR(queue_by_feature[FEATURE_PRESENT], &present_info);
+				if (present_result == VK_ERROR_OUT_OF_DATE_KHR || present_result == VK_SUBOPTIMAL_KHR || framebuffer_resized) {
+					framebuffer_resized = false;
+					recreate_swapchain(window, window_surface, physical_device, device, device_details, deletion_queue, render_pass, frame_settings, swapchain, swapchain_images, depth_buffer, render_targets, recording_cache);
+				}
+			}
+
+			mark_frame_stage(frame_benchmark, FrameStage::Present);
+			end_benchmark_frame(frame_benchmark);
+
+			last_image_index = image_index;
+			++rendered_frame_count;
+			++current_executing_frame;
+			if (current_executing_frame >= frame_settings.frames_in_flight) {
+				current_executing_frame = 0;
+			}
 		}
 
-		// Wait for rendering to finish before submitting present command.
-		VkPresentInfoKHR present_info{};
-		present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-		present_info.waitSemaphoreCount = 1;
-		present_info.pWaitSemaphores = signal_semaphores;
-
-		VkSwapchainKHR swapChains[] = { swapchain };
-		present_info.swapchainCount = 1;
-		present_info.pSwapchains = swapChains;
-		present_info.pImageIndices = &image_index;
-		present_info.pResults = nullptr; // Optional array of result values if using an array of swap chains.
-
-		vkQueuePresentKHR(queue_by_feature[FEATURE_PRESENT], &present_info);
-		++current_executing_frame;
-		if (current_executing_frame >= MAX_FRAMES_IN_FLIGHT) {
-			current_executing_frame = 0;
+		vkDeviceWaitIdle(device);
+
+		// Runs of a fixed length are benchmarks, so they report how fast they went.
+		if (frame_settings.frame_count != 0 && rendered_frame_count > 0) {
+			double run_seconds = std::chrono::duration<double>(FrameClock::now() - run_start).count();
+			std::cout << std::fixed << std::setprecision(3) << "Rendered " << rendered_frame_count << " frames at " << swapchain_images.extent.width << "x" << swapchain_images.extent.height
+				<< " in " << run_seconds << " s - " << run_seconds * 1000.0 / rendered_frame_count << " ms per frame, " << rendered_frame_count / run_seconds << " frames per second"
+				<< " - " << simulation.get_dropped_tick_count() << " dropped ticks\n";
+
+			// Averaged over the last GPU_PROFILER_HISTORY_LENGTH frames.
+			for (const GpuProfilerRegion& region : gpu_profiler.regions) {
+				std::cout << "GPU " << region.name << ": " << get_gpu_region_average(region) << " ms\n";
+			}
 		}
-	}
 
-	vkDeviceWaitIdle(device);
-	vkDestroySampler(device, sampler, nullptr);
-	vkDestroyImageView(device, texture.view, nullptr);
-	vkFreeMemory(device, texture.memory, nullptr);
-	vkDestroyImage(device, texture.image, nullptr);
+		if (is_frame_benchmark_done(frame_benchmark)) {
+			std::cout << get_frame_benchmark_report(frame_benchmark, frame_settings, device_details.properties.deviceName);
+			write_frame_benchmark_report(frame_settings.benchmark_report_path, frame_benchmark, frame_settings, device_details.properties.deviceName);
+		}
 
-	vkFreeMemory(device, depth_buffer.memory, nullptr);
-	vkDestroyImageView(device, depth_buffer.view, nullptr);
-	vkDestroyImage(device, depth_buffer.image, nullptr);
+		if (window == nullptr && frame_settings.capture_path != nullptr && rendered_frame_count > 0) {
+			write_offscreen_image(device, physical_device, transient_pool, swapchain_images, last_image_index, frame_settings.capture_path);
+		}
 
-	vkFreeMemory(device, gpu_index_memory, nullptr);
-	vkDestroyBuffer(device, gpu_index_buffer, nullptr);
-	vkFreeMemory(device, gpu_vertex_memory, nullptr);
-	vkDestroyBuffer(device,gpu_vertex_buffer, nullptr);
+		destroy_texture(gpu_allocator, texture);
+		destroy_mesh_pool(gpu_allocator, mesh_pool);
+		destroy_gpu_allocator(gpu_allocator);
+		destroy_instance_ring_buffer(device, instance_buffer);
+		if (use_gpu_culling) {
+			destroy_gpu_culling(gpu_culling);
+		}
 
-	vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+		vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
 
-	for (auto& frame_uniform_buffer : frame_uniform_buffers) {
-		vkDestroyBuffer(device, frame_uniform_buffer.buffer, nullptr);
-		vkFreeMemory(device, frame_uniform_buffer.memory, nullptr);
-	}
+		for (auto& frame_uniform_buffer : frame_uniform_buffers) {
+			vkDestroyBuffer(device, frame_uniform_buffer.buffer, nullptr);
+			free_device_memory(device, frame_uniform_buffer.memory);
+		}
 
-	for (auto& frame_execution : frame_executions) {
-		auto& sync_objects = frame_execution.sync;
-		vkDestroySemaphore(device, sync_objects.image_available_semaphore, nullptr);
-		vkDestroySemaphore(device, sync_objects.render_finished_semaphore, nullptr);
-		vkDestroyFence(device, sync_objects.in_flight_fence, nullptr);
-	}
+		for (auto& frame_execution : frame_executions) {
+			auto& sync_objects = frame_execution.sync;
+			vkDestroySemaphore(device, sync_objects.image_available_semaphore, nullptr);
+			vkDestroySemaphore(device, sync_objects.render_finished_semaphore, nullptr);
+			vkDestroyFence(device, sync_objects.in_flight_fence, nullptr);
+		}
 	
-	vkDestroyCommandPool(device, command_pool, nullptr);
-
-	for (const auto& image_view: render_targets.image_views) {
-		vkDestroyImageView(device, image_view, nullptr);
+		destroy_gpu_profiler(gpu_profiler);
+		destroy_transient_command_pool(transient_pool);
+		destroy_command_recording_cache(recording_cache);
+		destroy_parallel_recorder(parallel_recorder);
+		vkDestroyCommandPool(device, command_pool, nullptr);
+
+		vkDestroyRenderPass(device, render_pass, nullptr);
+		vkDestroyPipelineLayout(device, pipeline_resources.pipeline_layout, nullptr);
+		vkDestroyDescriptorSetLayout(device, pipeline_resources.descriptor_set_layout, nullptr);
 	}
 
-	for (const auto& framebuffer : render_targets.framebuffers) {
-		vkDestroyFramebuffer(device, framebuffer, nullptr);
-	}
+	destroy_deletion_queue(deletion_queue);
 
-	vkDestroySwapchainKHR(device, swapchain, nullptr);
-	vkDestroyRenderPass(device, render_pass, nullptr);
-	vkDestroyPipelineLayout(device, pipeline_resources.pipeline_layout, nullptr);
-	vkDestroyDescriptorSetLayout(device, pipeline_resources.descriptor_set_layout, nullptr);
-	vkDestroyPipeline(device, pipeline, nullptr);
+	// Everything has been freed by now, so any allocation left in the report has leaked.
+	write_memory_report(exit_memory_report_path);
 	vkDestroyDevice(device, nullptr);
 
-	vkDestroySurfaceKHR(instance, window_surface, nullptr);
-	glfwDestroyWindow(window);
-	glfwTerminate();
+	if (window != nullptr) {
+		vkDestroySurfaceKHR(instance, window_surface, nullptr);
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
 
 	vkDestroyInstance(instance, nullptr);
+
+	if (frame_settings.profile_trace_path != nullptr) {
+		write_chrome_trace(frame_settings.profile_trace_path);
+	}
+
 	return 0;
 }
\ No newline at end of file
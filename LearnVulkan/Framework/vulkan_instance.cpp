@@ -1,4 +1,5 @@
 #include "vulkan_instance.h"
+#include "cpu_profiler.h"
 #include <iostream>
 #include <array>
 #include <vector>
@@ -39,8 +40,10 @@ static bool has_required_validation_layers() {
 	return true;
 }
 
-VkInstance create_vulkan_instance()
+VkInstance create_vulkan_instance(bool headless)
 {
+	PROFILE_FUNCTION();
+
 	VkInstance vulkan_instance;
 	{ //If we wanted to see the extensions that vulkan supports beforehand we can do that here. 
 		uint32_t supported_extension_count;
@@ -66,7 +69,8 @@ VkInstance create_vulkan_instance()
 	app_info.applicationVersion = VK_MAKE_API_VERSION(0, 1, 0, 0);
 	app_info.pEngineName = "No Engine";
 	app_info.engineVersion = VK_MAKE_API_VERSION(0, 1, 0, 0);
-	app_info.apiVersion = VK_API_VERSION_1_0;
+	// 1.1 is needed for the external memory and properties2 functionality that optional extensions build on.
+	app_info.apiVersion = VK_API_VERSION_1_1;
 
 	// Device create info used to describe the Vulkan instance we want to create, note how each struct uses an sType parameter for when the struct is accessed by void*. 
 
@@ -77,10 +81,14 @@ VkInstance create_vulkan_instance()
 
 	// Get the Vulkan extensions needed by GLFW to interface the window with the Vulkan API.
 
-	uint32_t glfw_extension_count = 0;
-	const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
-	create_info.enabledExtensionCount = glfw_extension_count;
-	create_info.ppEnabledExtensionNames = glfw_extensions;
+	// Rendering offscreen needs no instance extensions at all.
+
+	if (!headless) {
+		uint32_t glfw_extension_count = 0;
+		const char** glfw_extensions = glfwGetRequiredInstanceExtensions(&glfw_extension_count);
+		create_info.enabledExtensionCount = glfw_extension_count;
+		create_info.ppEnabledExtensionNames = glfw_extensions;
+	}
 
 	// Vulkan "layers" are functions that sit between your application and the Vulkan drivers to report errors.
 
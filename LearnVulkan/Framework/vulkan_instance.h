@@ -3,4 +3,5 @@
 #include <glfw/glfw3.h>
 #include <vulkan/vulkan.h>
 
-VkInstance create_vulkan_instance();
\ No newline at end of file
+// Without a window, GLFW isn't initialised and the surface extensions it needs aren't requested.
+VkInstance create_vulkan_instance(bool headless = false);
\ No newline at end of file
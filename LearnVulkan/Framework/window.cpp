@@ -7,12 +7,23 @@ GLFWwindow* create_window(int width, int height, const char* title)
 	// Disable OpenGL context (using Vulkan)
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
-	// Disable window resizing (will handle later).
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+	// Resizing is handled by recreating the swapchain.
+	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
 
 	return glfwCreateWindow(width, height, title, nullptr, nullptr);
 }
 
+static void on_framebuffer_resized(GLFWwindow* window, int, int) {
+	bool* out_resized = static_cast<bool*>(glfwGetWindowUserPointer(window));
+	*out_resized = true;
+}
+
+void track_framebuffer_resize(GLFWwindow* window, bool& out_resized)
+{
+	glfwSetWindowUserPointer(window, &out_resized);
+	glfwSetFramebufferSizeCallback(window, on_framebuffer_resized);
+}
+
 VkSurfaceKHR create_window_surface(VkInstance vulkan_instance, GLFWwindow* window)
 {
 	VkSurfaceKHR window_surface;
@@ -36,3 +47,19 @@ VkSurfaceKHR create_window_surface(VkInstance vulkan_instance, GLFWwindow* windo
 
 	return window_surface;
 }
+
+bool was_key_pressed(GLFWwindow* window, int key, bool& key_down)
+{
+	bool is_down = glfwGetKey(window, key) == GLFW_PRESS;
+	bool pressed = is_down && !key_down;
+	key_down = is_down;
+	return pressed;
+}
+
+bool was_mouse_button_pressed(GLFWwindow* window, int button, bool& button_down)
+{
+	bool is_down = glfwGetMouseButton(window, button) == GLFW_PRESS;
+	bool pressed = is_down && !button_down;
+	button_down = is_down;
+	return pressed;
+}
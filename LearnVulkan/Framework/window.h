@@ -4,4 +4,12 @@
 #include <vulkan/vulkan.h>
 
 GLFWwindow* create_window(int width, int height, const char* title);
-VkSurfaceKHR create_window_surface(VkInstance vulkan_instance, GLFWwindow* window);
\ No newline at end of file
+VkSurfaceKHR create_window_surface(VkInstance vulkan_instance, GLFWwindow* window);
+
+// Not every platform reports VK_ERROR_OUT_OF_DATE_KHR when the window is resized, so the resize is also flagged from GLFW.
+// out_resized is set when the framebuffer size changes and must outlive the window.
+void track_framebuffer_resize(GLFWwindow* window, bool& out_resized);
+
+// True only on the frame the key goes down. key_down holds the state between calls.
+bool was_key_pressed(GLFWwindow* window, int key, bool& key_down);
+bool was_mouse_button_pressed(GLFWwindow* window, int button, bool& button_down);
\ No newline at end of file
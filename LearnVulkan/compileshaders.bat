@@ -1,4 +1,5 @@
 set p=%cd%
 %p%\glslc.exe shaders\shader.vert -o vert.spv
 %p%\glslc.exe shaders\shader.frag -o frag.spv
+%p%\glslc.exe shaders\cull.comp -o cull.spv
 pause
\ No newline at end of file
@@ -1,6 +1,11 @@
 #version 450
 
 layout(binding = 1) uniform sampler2D texSampler;
+
+layout(push_constant) uniform ObjectConstants {
+    mat4 model;
+    uint material_index;
+} object;
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
 
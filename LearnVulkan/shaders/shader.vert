@@ -1,18 +1,26 @@
 #version 450
 
 layout(binding = 0) uniform UniformBufferObject {
-    mat4 transform;
+    mat4 view_projection;
 } ubo;
 
+layout(push_constant) uniform ObjectConstants {
+    mat4 model;
+    uint material_index;
+} object;
+
 layout(location = 0) in vec3 inPosition;
 layout(location = 1) in vec3 inColor;
 layout(location = 2) in vec2 inTexCoord;
 
+// Per-instance, takes up locations 3 to 6.
+layout(location = 3) in mat4 inInstanceModel;
+
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
 
 void main() {
-    gl_Position = ubo.transform * vec4(inPosition, 1.0);
+    gl_Position = ubo.view_projection * object.model * inInstanceModel * vec4(inPosition, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
 }
\ No newline at end of file